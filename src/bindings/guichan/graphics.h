@@ -180,6 +180,12 @@ class Graphics : public gcn::Graphics
          */
         virtual void updateScreen() = 0;
 
+        /**
+         * Tells the graphics that the whole screen changed. Graphics which
+         * only draw the changed areas of a frame draw the next one in full.
+         */
+        virtual void invalidate() {}
+
         /**
          * Returns the width of the screen.
          */
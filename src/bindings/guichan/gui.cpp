@@ -53,6 +53,7 @@
 
 #include "../../core/utils/dtor.h"
 #include "../../core/utils/gettext.h"
+#include "../../core/utils/profiler.h"
 
 #include "../../eathena/gui/viewport.h"
 
@@ -73,7 +74,7 @@ gcn::Font *mBoldFont = NULL;
 volatile int tick_time;
 volatile int fps = 0, frame = 0;
 
-FPSmanager fpsm;
+FrameClock frameClock;
 
 const int MAX_TIME = 10000;
 
@@ -104,18 +105,6 @@ class GuiConfigListener : public ConfigListener
         Gui *mGui;
 };
 
-/**
- * Advances game logic counter.
- */
-uint32_t nextTick(uint32_t interval, void *param)
-{
-    tick_time++;
-    if (tick_time == MAX_TIME)
-        tick_time = 0;
-
-    return interval;
-}
-
 /**
  * Updates fps.
  */
@@ -134,6 +123,12 @@ int get_elapsed_time(int start_time)
         return (tick_time + (MAX_TIME - start_time)) * 10;
 }
 
+float get_interpolated_time(int start_time)
+{
+    return get_elapsed_time(start_time) +
+           frameClock.getStepFraction() * FrameClock::STEP_TIME;
+}
+
 Gui::Gui(Graphics *graphics):
     mCustomCursor(false),
     mMouseCursors(NULL),
@@ -147,8 +142,6 @@ Gui::Gui(Graphics *graphics):
 {
     logger->log("Initializing GUI...");
 
-    SDL_initFramerate(&fpsm);
-
     // Set graphics
     setGraphics(graphics);
 
@@ -167,7 +160,7 @@ Gui::Gui(Graphics *graphics):
     // Initialize timers
     fps = 0;
     tick_time = 0;
-    SDL_AddTimer(10, nextTick, NULL);                     // Logic counter
+    frameClock.reset();
     SDL_AddTimer(1000, nextSecond, NULL);                 // Seconds counter
 
     // Initialize top GUI widget
@@ -306,13 +299,20 @@ void Gui::resize(const int width, const int height)
 
 void Gui::logic()
 {
-    gcn::Gui::logic();
+    {
+        ProfileScope scope("Gui::logic");
+        gcn::Gui::logic();
+    }
 
     // Update the screen when application is active, delay otherwise.
     if (SDL_GetAppState() & SDL_APPACTIVE)
     {
         draw();
-        graphics->updateScreen();
+
+        {
+            ProfileScope scope("Graphics::updateScreen");
+            graphics->updateScreen();
+        }
 
         // Fade out mouse cursor after extended inactivity
         if (get_elapsed_time(mMouseInactivityTimer) < 15000)
@@ -331,7 +331,14 @@ void Gui::logic()
     }
 
     frame++;
-    SDL_framerateDelay(&fpsm);
+
+    {
+        ProfileScope scope("FrameClock::waitForFrame");
+        frameClock.waitForFrame();
+    }
+
+    // The logic of the next frame sees the time at which it starts
+    tick_time = (tick_time + frameClock.advance()) % MAX_TIME;
 
     guiPalette->advanceGradient();
 }
@@ -340,11 +347,13 @@ void Gui::framerateChanged()
 {
     const int fpsLimit = config.getValue("fpslimit", 0);
 
-    SDL_setFramerate(&fpsm, fpsLimit > 0 ? fpsLimit : 60);
+    frameClock.setFrameRate(fpsLimit > 0 ? fpsLimit : 60);
 }
 
 void Gui::draw()
 {
+    ProfileScope scope("Gui::draw");
+
     mGraphics->pushClipArea(getTop()->getDimension());
     getTop()->draw(mGraphics);
 
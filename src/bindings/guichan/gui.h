@@ -26,12 +26,12 @@
 
 #include <stdint.h>
 
-#include <SDL_framerate.h>
-
 #include <guichan/gui.hpp>
 
 #include "guichanfwd.h"
 
+#include "../../core/utils/frameclock.h"
+
 class Game;
 class Graphics;
 class GuiConfigListener;
@@ -39,7 +39,7 @@ class ImageSet;
 class SDLInput;
 class TrueTypeFont;
 
-extern FPSmanager fpsm;
+extern FrameClock frameClock;
 
 extern volatile int fps;
 extern volatile int tick_time;
@@ -212,6 +212,12 @@ class Gui : public gcn::Gui
  */
 int get_elapsed_time(int start_time);
 
+/**
+ * Returns elapsed time, including the part of the current logic step which
+ * passed already. Used to draw moving things between two logic steps.
+ */
+float get_interpolated_time(int start_time);
+
 extern Gui *gui;                              /**< The GUI system */
 extern SDLInput *guiInput;                    /**< GUI input */
 
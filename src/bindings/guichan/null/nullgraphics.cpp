@@ -0,0 +1,202 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <SDL.h>
+
+#include "nullgraphics.h"
+
+#include "../../../core/log.h"
+
+#include "../../../core/image/image.h"
+
+NullGraphics::NullGraphics():
+    mLastSource(NULL)
+{
+    resetCounters();
+}
+
+NullGraphics::~NullGraphics()
+{
+    _endDraw();
+}
+
+void NullGraphics::_beginDraw()
+{
+    pushClipArea(gcn::Rectangle(0, 0, mWidth, mHeight));
+}
+
+void NullGraphics::_endDraw()
+{
+    if (!mClipStack.empty())
+        popClipArea();
+}
+
+bool NullGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
+{
+    // Fullscreen and hardware surfaces are of no use when nothing is shown
+    Graphics::setVideoMode(w, h, bpp, false, false);
+
+    SDL_Surface *target = SDL_SetVideoMode(w, h, bpp,
+                                           SDL_ANYFORMAT | SDL_SWSURFACE);
+
+    if (!target)
+        return false;
+
+    setTarget(target);
+
+    return true;
+}
+
+bool NullGraphics::pushClipArea(gcn::Rectangle area)
+{
+    mCounters.clipPushes++;
+    return Graphics::pushClipArea(area);
+}
+
+void NullGraphics::drawPoint(int x, int y)
+{
+    count(gcn::Rectangle(x, y, 1, 1));
+}
+
+void NullGraphics::drawLine(int x1, int y1, int x2, int y2)
+{
+    // Lines are only counted by their length, not their bounding box
+    const int dx = abs(x2 - x1);
+    const int dy = abs(y2 - y1);
+
+    if (dx > dy)
+        count(gcn::Rectangle(std::min(x1, x2), y1, dx + 1, 1));
+    else
+        count(gcn::Rectangle(x1, std::min(y1, y2), 1, dy + 1));
+}
+
+void NullGraphics::drawRectangle(const gcn::Rectangle& rectangle)
+{
+    count(rectangle);
+
+    // Only the outline is touched
+    mCounters.pixels -= getClippedArea(gcn::Rectangle(rectangle.x + 1,
+                                                      rectangle.y + 1,
+                                                      rectangle.width - 2,
+                                                      rectangle.height - 2));
+}
+
+void NullGraphics::fillRectangle(const gcn::Rectangle& rectangle)
+{
+    count(rectangle);
+}
+
+bool NullGraphics::drawImage(Image *image, int srcX, int srcY, int dstX,
+                             int dstY, int width, int height, bool)
+{
+    if (!image)
+        return false;
+
+    bind(image);
+    mCounters.images++;
+    count(gcn::Rectangle(dstX, dstY, width, height));
+
+    return true;
+}
+
+void NullGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
+{
+    if (!image)
+        return;
+
+    bind(image);
+    mCounters.images++;
+    count(gcn::Rectangle(x, y, w, h));
+}
+
+SDL_Surface* NullGraphics::getScreenshot()
+{
+    return SDL_CreateRGBSurface(SDL_SWSURFACE, mWidth, mHeight, 24,
+                                0x000000ff, 0x0000ff00, 0x00ff0000, 0);
+}
+
+void NullGraphics::resetCounters()
+{
+    mCounters.frames = 0;
+    mCounters.drawCalls = 0;
+    mCounters.images = 0;
+    mCounters.textureBinds = 0;
+    mCounters.clipPushes = 0;
+    mCounters.pixels = 0;
+    mLastSource = NULL;
+}
+
+void NullGraphics::logCounters() const
+{
+    const int frames = std::max(mCounters.frames, 1);
+
+    logger->log("Headless graphics: %d frames", mCounters.frames);
+    logger->log("Per frame: %d draw calls, %d images, %d texture binds, "
+                "%d clip pushes, %lld pixels",
+                mCounters.drawCalls / frames, mCounters.images / frames,
+                mCounters.textureBinds / frames, mCounters.clipPushes / frames,
+                mCounters.pixels / frames);
+}
+
+void NullGraphics::count(const gcn::Rectangle &area)
+{
+    mCounters.drawCalls++;
+    mCounters.pixels += getClippedArea(area);
+}
+
+long long NullGraphics::getClippedArea(const gcn::Rectangle &area) const
+{
+    if (mClipStack.empty() || area.width <= 0 || area.height <= 0)
+        return 0;
+
+    const gcn::ClipRectangle &top = mClipStack.top();
+    gcn::Rectangle clipped(area.x + top.xOffset, area.y + top.yOffset,
+                           area.width, area.height);
+
+    if (!clipped.isIntersecting(top))
+        return 0;
+
+    const int x1 = std::max(clipped.x, top.x);
+    const int y1 = std::max(clipped.y, top.y);
+    const int x2 = std::min(clipped.x + clipped.width, top.x + top.width);
+    const int y2 = std::min(clipped.y + clipped.height, top.y + top.height);
+
+    return (long long) (x2 - x1) * (y2 - y1);
+}
+
+void NullGraphics::bind(Image *image)
+{
+#ifdef USE_OPENGL
+    const void *source = Image::getLoadAsOpenGL() ?
+        (const void*) (size_t) image->mGLImage : (const void*) image->mImage;
+#else
+    const void *source = image->mImage;
+#endif
+
+    if (source != mLastSource)
+    {
+        mCounters.textureBinds++;
+        mLastSource = source;
+    }
+}
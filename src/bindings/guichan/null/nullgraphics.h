@@ -0,0 +1,137 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NULL_GRAPHICS_H
+#define _NULL_GRAPHICS_H
+
+#include "../graphics.h"
+
+class Image;
+
+/**
+ * A graphics context which draws nothing. It only counts what it is asked to
+ * draw, for measuring the rest of the client without the cost of rendering
+ * or a display. Images are still loaded, so the video mode is set on a
+ * software surface, which doesn't need a window with SDL's dummy video
+ * driver.
+ */
+class NullGraphics : public Graphics
+{
+    public:
+        /**
+         * Constructor.
+         */
+        NullGraphics();
+
+        /**
+         * Destructor.
+         */
+        virtual ~NullGraphics();
+
+        /**
+         * What was drawn since the counters were last reset.
+         */
+        struct Counters
+        {
+            int frames;              /**< Screen updates */
+            int drawCalls;           /**< Images and primitives drawn */
+            int images;              /**< Images drawn, patterns count once */
+            int textureBinds;        /**< Switches between image sources */
+            int clipPushes;          /**< Clip areas pushed */
+            long long pixels;        /**< Pixels touched, after clipping */
+        };
+
+        virtual bool pushClipArea(gcn::Rectangle area);
+
+        virtual void drawPoint(int x, int y);
+
+        virtual void drawLine(int x1, int y1, int x2, int y2);
+
+        virtual void drawRectangle(const gcn::Rectangle& rectangle);
+
+        virtual void fillRectangle(const gcn::Rectangle& rectangle);
+
+        virtual void setColor(const gcn::Color& color) { mColor = color; }
+
+        /**
+         * Sets up a software surface of the given size.
+         */
+        virtual bool setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel);
+
+        /**
+         * Counts the image without drawing it.
+         */
+        virtual bool drawImage(Image *image, int srcX, int srcY,
+                               int dstX, int dstY, int width, int height,
+                               bool useColor = false);
+
+        virtual void drawImagePattern(Image *image, int x, int y, int w, int h);
+
+        virtual void updateScreen() { mCounters.frames++; }
+
+        /**
+         * Returns a blank surface the size of the screen.
+         */
+        virtual SDL_Surface* getScreenshot();
+
+        virtual void _beginDraw();
+
+        virtual void _endDraw();
+
+        /**
+         * Returns what was drawn since the last reset.
+         */
+        const Counters &getCounters() const { return mCounters; }
+
+        /**
+         * Starts counting from 0 again.
+         */
+        void resetCounters();
+
+        /**
+         * Logs the counters, per frame when frames were drawn.
+         */
+        void logCounters() const;
+
+    private:
+        /**
+         * Counts a draw call covering the given area, relative to the current
+         * clip area.
+         */
+        void count(const gcn::Rectangle &area);
+
+        /**
+         * Returns the number of pixels of the area inside the current clip
+         * area.
+         */
+        long long getClippedArea(const gcn::Rectangle &area) const;
+
+        /**
+         * Counts a switch to another image source, the way OpenGL binds a
+         * texture when the image drawn from changes.
+         */
+        void bind(Image *image);
+
+        Counters mCounters;
+        const void *mLastSource;     /**< The image source drawn from last */
+};
+
+#endif
@@ -44,26 +44,41 @@
 #define GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB 0x84F8
 #endif
 
-const unsigned int vertexBufSize = 500;
+/**
+ * Number of quads the batch holds before it is drawn.
+ */
+static const int BATCH_SIZE = 1024;
 
+OpenGLGraphics *OpenGLGraphics::mInstance = NULL;
 GLuint OpenGLGraphics::mLastImage = NULL;
+int OpenGLGraphics::mBindCount = 0;
+int OpenGLGraphics::mFrameBindCount = 0;
+int OpenGLGraphics::mDrawCallCount = 0;
+int OpenGLGraphics::mFrameDrawCallCount = 0;
 
 OpenGLGraphics::OpenGLGraphics():
     mAlpha(false),
     mTexture(false),
     mColorAlpha(false),
-    mSync(false)
+    mSync(false),
+    mQuadCount(0),
+    mBatchTexture(0)
 {
-    mFloatTexArray = new GLfloat[vertexBufSize * 4];
-    mIntTexArray = new GLint[vertexBufSize * 4];
-    mIntVertArray = new GLint[vertexBufSize * 4];
+    mVertArray = new GLint[BATCH_SIZE * 8];
+    mTexArray = new GLfloat[BATCH_SIZE * 8];
+    mColorArray = new GLubyte[BATCH_SIZE * 16];
+
+    mInstance = this;
 }
 
 OpenGLGraphics::~OpenGLGraphics()
 {
-    delete[] mFloatTexArray;
-    delete[] mIntTexArray;
-    delete[] mIntVertArray;
+    if (mInstance == this)
+        mInstance = NULL;
+
+    delete[] mVertArray;
+    delete[] mTexArray;
+    delete[] mColorArray;
 }
 
 void OpenGLGraphics::setSync(bool sync)
@@ -130,43 +145,6 @@ bool OpenGLGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
     return true;
 }
 
-static inline void drawQuad(Image *image, int srcX, int srcY, int dstX,
-                            int dstY, int width, int height)
-{
-    if (image->getTextureType() == GL_TEXTURE_2D)
-    {
-        // Find OpenGL normalized texture coordinates.
-        const float texX1 = static_cast<float>(srcX) /
-                            static_cast<float>(image->getTextureWidth());
-        const float texY1 = static_cast<float>(srcY) /
-                            static_cast<float>(image->getTextureHeight());
-        const float texX2 = static_cast<float>(srcX + width) /
-                            static_cast<float>(image->getTextureWidth());
-        const float texY2 = static_cast<float>(srcY + height) /
-                            static_cast<float>(image->getTextureHeight());
-
-        GLfloat tex[] = { texX1, texY1, texX2, texY1, 
-                          texX2, texY2, texX1, texY2 };
-        GLint vert[] = { dstX, dstY, dstX + width, dstY,
-                         dstX + width, dstY + height, dstX, dstY + height };
-
-        glVertexPointer(2, GL_INT, 0, &vert);
-        glTexCoordPointer(2, GL_FLOAT, 0, &tex);
-        glDrawArrays(GL_QUADS, 0, 4);
-    }
-    else
-    {
-        GLint tex[] = { srcX, srcY, srcX + width, srcY,
-                        srcX + width, srcY + height, srcX, srcY + height };
-        GLint vert[] = { dstX, dstY, dstX + width, dstY,
-                         dstX + width, dstY + height, dstX, dstY + height };
-
-        glVertexPointer(2, GL_INT, 0, &vert);
-        glTexCoordPointer(2, GL_INT, 0, &tex);
-        glDrawArrays(GL_QUADS, 0, 4);
-    }
-}
-
 bool OpenGLGraphics::drawImage(Image *image, int srcX, int srcY, int dstX,
                                int dstY, int width, int height, bool useColor)
 {
@@ -176,18 +154,21 @@ bool OpenGLGraphics::drawImage(Image *image, int srcX, int srcY, int dstX,
     srcX += image->mBounds.x;
     srcY += image->mBounds.y;
 
-    if (!useColor)
-        glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
+    GLubyte color[4] = { 255, 255, 255,
+                         static_cast<GLubyte>(image->mAlpha * 255) };
 
-    bindTexture(Image::mTextureType, image->mGLImage);
+    if (useColor)
+    {
+        color[0] = static_cast<GLubyte>(mColor.r);
+        color[1] = static_cast<GLubyte>(mColor.g);
+        color[2] = static_cast<GLubyte>(mColor.b);
+        color[3] = static_cast<GLubyte>(mColor.a);
+    }
 
     setTexturingAndBlending(true);
+    setBatchTexture(image->mGLImage);
 
-    drawQuad(image, srcX, srcY, dstX, dstY, width, height);
-
-    if (!useColor)
-        glColor4ub(static_cast<GLubyte>(mColor.r), static_cast<GLubyte>(mColor.g),
-                   static_cast<GLubyte>(mColor.b), static_cast<GLubyte>(mColor.a));
+    addQuad(image, srcX, srcY, dstX, dstY, width, height, color);
 
     return true;
 }
@@ -206,17 +187,11 @@ void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
     const int srcX = image->mBounds.x;
     const int srcY = image->mBounds.y;
 
-    const float tw = static_cast<float>(image->getTextureWidth());
-    const float th = static_cast<float>(image->getTextureHeight());
-
-    unsigned int vp = 0;
-    const unsigned int vLimit = vertexBufSize * 4;
-
-    glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    bindTexture(Image::mTextureType, image->mGLImage);
+    const GLubyte color[4] = { 255, 255, 255,
+                               static_cast<GLubyte>(image->mAlpha * 255) };
 
     setTexturingAndBlending(true);
+    setBatchTexture(image->mGLImage);
 
     // Draw a set of textured rectangles
     for (int py = 0; py < h; py += ih)
@@ -225,61 +200,103 @@ void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
         const int dstY = y + py;
         for (int px = 0; px < w; px += iw)
         {
-            int width = (px + iw >= w) ? w - px : iw;
-            int dstX = x + px;
-
-            for (int i = 0; i < 4; i++)
-            {
-                const int offsetX = ((((i + 1) % 4) < 2) ? 0 : width);
-                const int offsetY = ((i < 2) ? 0 : height);
-                const int index = vp + (2 * i);
-
-                if (image->getTextureType() == GL_TEXTURE_2D)
-                {
-                    const float tx = static_cast<float>(srcX + offsetX) / tw;
-                    const float ty = static_cast<float>(srcY + offsetY) / th;
-
-                    mFloatTexArray[index] = tx;
-                    mFloatTexArray[index + 1] = ty;
-                }
-                else
-                {
-                    mIntTexArray[index] = srcX + offsetX;
-                    mIntTexArray[index + 1] = srcY + offsetY;
-                }
-
-                mIntVertArray[index] = dstX + offsetX;
-                mIntVertArray[index + 1] = dstY + offsetY;
-            }
-
-            vp += 8;
-            if (vp >= vLimit)
-            {
-                if (image->getTextureType() == GL_TEXTURE_2D)
-                    drawQuadArrayfi(vp);
-                else
-                    drawQuadArrayii(vp);
-
-                vp = 0;
-            }
+            const int width = (px + iw >= w) ? w - px : iw;
+            const int dstX = x + px;
+
+            addQuad(image, srcX, srcY, dstX, dstY, width, height, color);
         }
     }
+}
+
+void OpenGLGraphics::addQuad(Image *image, int srcX, int srcY, int dstX,
+                             int dstY, int width, int height,
+                             const GLubyte *color)
+{
+    if (mQuadCount == BATCH_SIZE)
+        flush();
+
+    float texX1 = static_cast<float>(srcX);
+    float texY1 = static_cast<float>(srcY);
+    float texX2 = static_cast<float>(srcX + width);
+    float texY2 = static_cast<float>(srcY + height);
+
+    // Rectangle textures are addressed in pixels, others need OpenGL
+    // normalized texture coordinates
+    if (Image::mTextureType == GL_TEXTURE_2D)
+    {
+        const float texWidth = static_cast<float>(image->getTextureWidth());
+        const float texHeight = static_cast<float>(image->getTextureHeight());
+
+        texX1 /= texWidth;
+        texY1 /= texHeight;
+        texX2 /= texWidth;
+        texY2 /= texHeight;
+    }
+
+    GLint *vert = mVertArray + mQuadCount * 8;
+    GLfloat *tex = mTexArray + mQuadCount * 8;
+    GLubyte *colors = mColorArray + mQuadCount * 16;
+
+    vert[0] = dstX;          vert[1] = dstY;
+    vert[2] = dstX + width;  vert[3] = dstY;
+    vert[4] = dstX + width;  vert[5] = dstY + height;
+    vert[6] = dstX;          vert[7] = dstY + height;
 
-    if (vp > 0)
+    tex[0] = texX1;  tex[1] = texY1;
+    tex[2] = texX2;  tex[3] = texY1;
+    tex[4] = texX2;  tex[5] = texY2;
+    tex[6] = texX1;  tex[7] = texY2;
+
+    for (int i = 0; i < 16; i++)
+        colors[i] = color[i % 4];
+
+    mQuadCount++;
+}
+
+void OpenGLGraphics::setBatchTexture(GLuint texture)
+{
+    if (mBatchTexture != texture)
     {
-        if (image->getTextureType() == GL_TEXTURE_2D)
-            drawQuadArrayfi(vp);
-        else
-            drawQuadArrayii(vp);
+        flush();
+        mBatchTexture = texture;
     }
+}
+
+void OpenGLGraphics::flush()
+{
+    if (mQuadCount == 0)
+        return;
+
+    bindTexture(Image::mTextureType, mBatchTexture);
+
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    glVertexPointer(2, GL_INT, 0, mVertArray);
+    glTexCoordPointer(2, GL_FLOAT, 0, mTexArray);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, mColorArray);
+
+    glDrawArrays(GL_QUADS, 0, mQuadCount * 4);
+    mDrawCallCount++;
+
+    glDisableClientState(GL_COLOR_ARRAY);
 
-     glColor4ub(static_cast<GLubyte>(mColor.r),	static_cast<GLubyte>(mColor.g),
-                static_cast<GLubyte>(mColor.b), static_cast<GLubyte>(mColor.a));
+    // The color array leaves the current color undefined
+    glColor4ub(static_cast<GLubyte>(mColor.r), static_cast<GLubyte>(mColor.g),
+               static_cast<GLubyte>(mColor.b), static_cast<GLubyte>(mColor.a));
+
+    mQuadCount = 0;
 }
 
 void OpenGLGraphics::updateScreen()
 {
+    flush();
+
     SDL_GL_SwapBuffers();
+
+    mFrameBindCount = mBindCount;
+    mBindCount = 0;
+    mFrameDrawCallCount = mDrawCallCount;
+    mDrawCallCount = 0;
 }
 
 void OpenGLGraphics::_beginDraw()
@@ -308,6 +325,7 @@ void OpenGLGraphics::_beginDraw()
 
 void OpenGLGraphics::_endDraw()
 {
+    flush();
 }
 
 SDL_Surface* OpenGLGraphics::getScreenshot()
@@ -316,6 +334,8 @@ SDL_Surface* OpenGLGraphics::getScreenshot()
     int w = mTarget->w;
     GLint pack = 1;
 
+    flush();
+
     SDL_Surface *screenshot = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 24,
                                                    0xff0000, 0x00ff00, 0x0000ff,
                                                    0x000000);
@@ -357,6 +377,8 @@ bool OpenGLGraphics::pushClipArea(gcn::Rectangle area)
     int transX = 0;
     int transY = 0;
 
+    flush();
+
     if (!mClipStack.empty())
     {
         transX = -mClipStack.top().xOffset;
@@ -379,6 +401,8 @@ bool OpenGLGraphics::pushClipArea(gcn::Rectangle area)
 
 void OpenGLGraphics::popClipArea()
 {
+    flush();
+
     gcn::Graphics::popClipArea();
 
     if (mClipStack.empty())
@@ -392,6 +416,7 @@ void OpenGLGraphics::popClipArea()
 
 void OpenGLGraphics::setColor(const gcn::Color& color)
 {
+    // Batched quads carry their own color, so the batch can stay
     mColor = color;
     glColor4ub(color.r, color.g, color.b, color.a);
 
@@ -405,6 +430,7 @@ void OpenGLGraphics::drawPoint(int x, int y)
     glBegin(GL_POINTS);
     glVertex2i(x, y);
     glEnd();
+    mDrawCallCount++;
 }
 
 void OpenGLGraphics::drawLine(int x1, int y1, int x2, int y2)
@@ -419,6 +445,7 @@ void OpenGLGraphics::drawLine(int x1, int y1, int x2, int y2)
     glBegin(GL_POINTS);
     glVertex2f(x2 + 0.5f, y2 + 0.5f);
     glEnd();
+    mDrawCallCount += 2;
 }
 
 void OpenGLGraphics::drawRectangle(const gcn::Rectangle& rect)
@@ -453,7 +480,9 @@ void OpenGLGraphics::setTexturingAndBlending(bool enable)
     }
     else
     {
-        mLastImage = NULL;
+        // The batch is drawn with texturing and blending
+        flush();
+
         if (mAlpha && !mColorAlpha)
         {
             glDisable(GL_BLEND);
@@ -491,6 +520,7 @@ void OpenGLGraphics::drawRectangle(const gcn::Rectangle& rect, bool filled)
 
     glVertexPointer(2, GL_FLOAT, 0, &vert);
     glDrawArrays(filled ? GL_QUADS : GL_LINE_LOOP, 0, 4);
+    mDrawCallCount++;
 
     glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 }
@@ -501,24 +531,20 @@ void OpenGLGraphics::bindTexture(GLenum target, GLuint texture)
     {
         mLastImage = texture;
         glBindTexture(target, texture);
+        mBindCount++;
     }
 }
 
-inline void OpenGLGraphics::drawQuadArrayfi(int size)
+void OpenGLGraphics::forgetTexture(GLuint texture)
 {
-    glVertexPointer(2, GL_INT, 0, mIntVertArray);
-    glTexCoordPointer(2, GL_FLOAT, 0, mFloatTexArray);
-
-    glDrawArrays(GL_QUADS, 0, size / 2);
-}
-
-inline void OpenGLGraphics::drawQuadArrayii(int size)
-{
-    glVertexPointer(2, GL_INT, 0, mIntVertArray);
-    glTexCoordPointer(2, GL_INT, 0, mIntTexArray);
+    if (mInstance && mInstance->mBatchTexture == texture)
+    {
+        mInstance->flush();
+        mInstance->mBatchTexture = 0;
+    }
 
-    glDrawArrays(GL_QUADS, 0, size / 2);
+    if (mLastImage == texture)
+        mLastImage = 0;
 }
 
-
 #endif // USE_OPENGL
@@ -25,6 +25,11 @@
 
 #include "../graphics.h"
 
+/**
+ * Draws through OpenGL. Images aren't drawn right away, but collected into a
+ * batch of quads that is drawn with a single call once another texture is
+ * needed, something else is drawn, the clip area changes or the frame ends.
+ */
 class OpenGLGraphics : public Graphics
 {
     public:
@@ -81,22 +86,63 @@ class OpenGLGraphics : public Graphics
 
         static void bindTexture(GLenum target, GLuint texture);
 
+        /**
+         * Called when the texture is deleted. Draws the quads still waiting
+         * to use it, and makes sure its next bind isn't skipped, as OpenGL may
+         * hand out its name again.
+         */
+        static void forgetTexture(GLuint texture);
+
+        /**
+         * Returns the number of times a texture was bound to draw the last
+         * frame.
+         */
+        static int getBindCount() { return mFrameBindCount; }
+
+        /**
+         * Returns the number of draw calls it took to draw the last frame.
+         */
+        static int getDrawCallCount() { return mFrameDrawCallCount; }
+
     protected:
         void setTexturingAndBlending(bool enable);
 
-        void drawQuadArrayfi(int size);
+        /**
+         * Adds a textured quad to the batch, drawn with the given color. The
+         * texture of the image has to be the one of the batch.
+         */
+        void addQuad(Image *image, int srcX, int srcY, int dstX, int dstY,
+                     int width, int height, const GLubyte *color);
 
-        void drawQuadArrayii(int size);
+        /**
+         * Makes sure the next quads are drawn with the given texture, drawing
+         * the batch first when it uses another one.
+         */
+        void setBatchTexture(GLuint texture);
+
+        /**
+         * Draws the quads collected so far. Called whenever something else
+         * is about to be drawn, the clip area changes, or the frame ends.
+         */
+        void flush();
 
     private:
         bool mAlpha, mTexture;
         bool mColorAlpha;
         bool mSync;
 
-        GLfloat *mFloatTexArray;
-        GLint *mIntTexArray;
-        GLint *mIntVertArray;
+        GLint *mVertArray;
+        GLfloat *mTexArray;
+        GLubyte *mColorArray;
+        int mQuadCount;             /**< Number of quads in the batch. */
+        GLuint mBatchTexture;       /**< Texture the batch is drawn with. */
+
+        static OpenGLGraphics *mInstance;
         static GLuint mLastImage;
+        static int mBindCount;
+        static int mFrameBindCount;
+        static int mDrawCallCount;
+        static int mFrameDrawCallCount;
 };
 
 #endif
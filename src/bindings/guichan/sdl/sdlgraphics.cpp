@@ -20,6 +20,7 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
 #include <cassert>
 #include <SDL_gfxPrimitives.h>
 
@@ -27,11 +28,60 @@
 
 #include "sdlgraphics.h"
 
+#include "../../../core/configuration.h"
 #include "../../../core/log.h"
 
 #include "../../../core/image/image.h"
 
-SDLGraphics::SDLGraphics()
+/**
+ * Size of the screen cells which are compared between frames in dirty
+ * rectangle mode.
+ */
+#define CELL_SIZE 32
+
+/**
+ * Above this many changed areas, the whole frame is drawn instead.
+ */
+#define MAX_DIRTY_RECTS 32
+
+static SDL_Rect makeRect(int x, int y, int w, int h)
+{
+    SDL_Rect rect;
+    rect.x = x;
+    rect.y = y;
+    rect.w = w;
+    rect.h = h;
+    return rect;
+}
+
+static bool intersect(const SDL_Rect &a, const SDL_Rect &b, SDL_Rect &result)
+{
+    const int x1 = std::max<int>(a.x, b.x);
+    const int y1 = std::max<int>(a.y, b.y);
+    const int x2 = std::min<int>(a.x + a.w, b.x + b.w);
+    const int y2 = std::min<int>(a.y + a.h, b.y + b.h);
+
+    if (x2 <= x1 || y2 <= y1)
+        return false;
+
+    result = makeRect(x1, y1, x2 - x1, y2 - y1);
+    return true;
+}
+
+static inline Uint32 mix(Uint32 hash, Uint32 value)
+{
+    return (hash ^ value) * 16777619u;
+}
+
+static inline Uint32 mix(Uint32 hash, const SDL_Rect &rect)
+{
+    hash = mix(hash, (Uint16) rect.x | (Uint32) (Uint16) rect.y << 16);
+    return mix(hash, rect.w | (Uint32) rect.h << 16);
+}
+
+SDLGraphics::SDLGraphics():
+    mDirtyRects(false),
+    mInvalidated(true)
 {
     mTarget = NULL;
 }
@@ -39,6 +89,9 @@ SDLGraphics::SDLGraphics()
 SDLGraphics::~SDLGraphics()
 {
     _endDraw();
+
+    release(mOps);
+    release(mLastOps);
 }
 
 void SDLGraphics::_beginDraw()
@@ -100,6 +153,9 @@ void SDLGraphics::drawPoint(int x, int y)
     x += top.xOffset;
     y += top.yOffset;
 
+    if (record(DrawOp::POINT, x, y, x, y, makeRect(x, y, 1, 1)))
+        return;
+
     pixelRGBA(mTarget, x, y, mColor.r, mColor.g, mColor.b, mColor.a);
 }
 
@@ -116,6 +172,11 @@ void SDLGraphics::drawLine(int x1, int y1, int x2, int y2)
     x2 += top.xOffset;
     y2 += top.yOffset;
 
+    if (record(DrawOp::LINE, x1, y1, x2, y2,
+               makeRect(std::min(x1, x2), std::min(y1, y2),
+                        abs(x2 - x1) + 1, abs(y2 - y1) + 1)))
+        return;
+
     if (x1 == x2)
         vlineRGBA(mTarget, x1, y1, y2, mColor.r, mColor.g, mColor.b, mColor.a);
     else if (y1 == y2)
@@ -139,6 +200,11 @@ void SDLGraphics::drawRectangle(const gcn::Rectangle& rectangle)
     if(!area.isIntersecting(top))
         return;
 
+    if (record(DrawOp::RECTANGLE, area.x, area.y, area.x + area.width,
+               area.y + area.height,
+               makeRect(area.x, area.y, area.width + 1, area.height + 1)))
+        return;
+
     rectangleRGBA(mTarget, area.x, area.y, area.x + area.width,
                   area.y + area.height, mColor.r, mColor.g, mColor.b, mColor.a);
 }
@@ -158,6 +224,11 @@ void SDLGraphics::fillRectangle(const gcn::Rectangle& rectangle)
     if(!area.isIntersecting(top))
         return;
 
+    if (record(DrawOp::FILL, area.x, area.y, area.x + area.width,
+               area.y + area.height,
+               makeRect(area.x, area.y, area.width + 1, area.height + 1)))
+        return;
+
     boxRGBA(mTarget, area.x, area.y, area.x + area.width,
             area.y + area.height, mColor.r, mColor.g, mColor.b, mColor.a);
 }
@@ -191,6 +262,13 @@ bool SDLGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
 
     setTarget(target);
 
+    // Dirty rectangles need the previous frame to stay in the buffer, which
+    // is not the case when flipping pages.
+    release(mOps);
+    mDirtyRects = config.getValue("dirtyRects", 0) &&
+                  !(target->flags & SDL_DOUBLEBUF);
+    mInvalidated = true;
+
     char videoDriverName[64];
 
     if (SDL_VideoDriverName(videoDriverName, 64))
@@ -219,6 +297,8 @@ bool SDLGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
     logger->log("Accelerated color fills: %s",
             ((vi->blit_fill) ? "yes" : "no"));
     logger->log("Available video memory: %d", vi->video_mem);
+    logger->log("Drawing only changed areas: %s",
+            (mDirtyRects ? "yes" : "no"));
 
     return true;
 }
@@ -230,6 +310,10 @@ bool SDLGraphics::drawImage(Image *image, int srcX, int srcY, int dstX, int dstY
     if (!mTarget || !image || !image->mImage)
         return false;
 
+    SDL_Surface *surface = image->getAlphaSurface();
+    if (!surface)
+        return false;
+
     dstX += mClipStack.top().xOffset;
     dstY += mClipStack.top().yOffset;
 
@@ -243,7 +327,13 @@ bool SDLGraphics::drawImage(Image *image, int srcX, int srcY, int dstX, int dstY
     srcRect.w = width;
     srcRect.h = height;
 
-    return !(SDL_BlitSurface(image->mImage, &srcRect, mTarget, &dstRect) < 0);
+    if (mDirtyRects)
+    {
+        blit(surface, srcRect, dstRect);
+        return true;
+    }
+
+    return !(SDL_BlitSurface(surface, &srcRect, mTarget, &dstRect) < 0);
 }
 
 void SDLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
@@ -252,6 +342,10 @@ void SDLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
     if (!mTarget || !image || !image->mImage)
         return;
 
+    SDL_Surface *surface = image->getAlphaSurface();
+    if (!surface)
+        return;
+
     const int iw = image->getWidth();
     const int ih = image->getHeight();
  
@@ -275,14 +369,254 @@ void SDLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
             srcRect.x = srcX; srcRect.y = srcY;
             srcRect.w = dw;   srcRect.h = dh;
 
-            SDL_BlitSurface(image->mImage, &srcRect, mTarget, &dstRect);
+            blit(surface, srcRect, dstRect);
         }
     }
 }
 
 void SDLGraphics::updateScreen()
 {
-    SDL_Flip(mTarget);
+    if (!mDirtyRects)
+    {
+        SDL_Flip(mTarget);
+        return;
+    }
+
+    const SDL_Rect clip = mTarget->clip_rect;
+
+    if (findDirtyRects())
+    {
+        for (size_t r = 0; r < mRects.size(); r++)
+        {
+            SDL_Rect area;
+            for (DrawOps::const_iterator i = mOps.begin(); i != mOps.end(); ++i)
+            {
+                if (intersect(i->bounds, mRects[r], area))
+                    replay(*i, area);
+            }
+        }
+
+        if (!mRects.empty())
+            SDL_UpdateRects(mTarget, mRects.size(), &mRects[0]);
+    }
+    else
+    {
+        const SDL_Rect screen = makeRect(0, 0, mTarget->w, mTarget->h);
+
+        for (DrawOps::const_iterator i = mOps.begin(); i != mOps.end(); ++i)
+            replay(*i, screen);
+
+        SDL_Flip(mTarget);
+    }
+
+    SDL_SetClipRect(mTarget, &clip);
+
+    // The surfaces of the previous frame were kept alive until now, so that
+    // no new surface could take their place and go unnoticed.
+    release(mLastOps);
+    mLastOps.swap(mOps);
+}
+
+void SDLGraphics::blit(SDL_Surface *surface, SDL_Rect &srcRect,
+                       SDL_Rect &dstRect)
+{
+    if (!mDirtyRects)
+    {
+        SDL_BlitSurface(surface, &srcRect, mTarget, &dstRect);
+        return;
+    }
+
+    DrawOp op;
+    op.type = DrawOp::BLIT;
+    op.surface = surface;
+    op.alphaFlags = surface->flags & (SDL_SRCALPHA | SDL_RLEACCELOK);
+    op.alpha = surface->format->alpha;
+    op.src = srcRect;
+    op.dst = makeRect(dstRect.x, dstRect.y, srcRect.w, srcRect.h);
+
+    record(op, op.dst);
+}
+
+bool SDLGraphics::record(DrawOp::Type type, int x1, int y1, int x2, int y2,
+                         const SDL_Rect &area)
+{
+    if (!mDirtyRects)
+        return false;
+
+    // Primitives keep their first point in dst and their second one in src
+    DrawOp op;
+    op.type = type;
+    op.surface = NULL;
+    op.alphaFlags = 0;
+    op.alpha = 0;
+    op.src = makeRect(x2, y2, 0, 0);
+    op.dst = makeRect(x1, y1, 0, 0);
+    op.color = mColor;
+
+    record(op, area);
+
+    return true;
+}
+
+void SDLGraphics::record(DrawOp &op, const SDL_Rect &area)
+{
+    op.clip = mTarget->clip_rect;
+
+    if (!intersect(area, op.clip, op.bounds))
+        return;
+
+    if (op.surface)
+        op.surface->refcount++;
+
+    mOps.push_back(op);
+}
+
+void SDLGraphics::replay(const DrawOp &op, const SDL_Rect &area)
+{
+    SDL_Rect clip;
+    if (!intersect(op.clip, area, clip))
+        return;
+
+    SDL_SetClipRect(mTarget, &clip);
+
+    const gcn::Color &c = op.color;
+
+    switch (op.type)
+    {
+        case DrawOp::BLIT:
+        {
+            // The alpha of a surface may have changed since it was recorded
+            SDL_Surface *surface = op.surface;
+            if ((surface->flags & (SDL_SRCALPHA | SDL_RLEACCELOK)) !=
+                    op.alphaFlags || surface->format->alpha != op.alpha)
+                SDL_SetAlpha(surface, op.alphaFlags, op.alpha);
+
+            SDL_Rect srcRect = op.src;
+            SDL_Rect dstRect = op.dst;
+            SDL_BlitSurface(surface, &srcRect, mTarget, &dstRect);
+            break;
+        }
+        case DrawOp::POINT:
+            pixelRGBA(mTarget, op.dst.x, op.dst.y, c.r, c.g, c.b, c.a);
+            break;
+        case DrawOp::LINE:
+            if (op.dst.x == op.src.x)
+                vlineRGBA(mTarget, op.dst.x, op.dst.y, op.src.y,
+                          c.r, c.g, c.b, c.a);
+            else if (op.dst.y == op.src.y)
+                hlineRGBA(mTarget, op.dst.x, op.src.x, op.src.y,
+                          c.r, c.g, c.b, c.a);
+            else
+                lineRGBA(mTarget, op.dst.x, op.dst.y, op.src.x, op.src.y,
+                         c.r, c.g, c.b, c.a);
+            break;
+        case DrawOp::RECTANGLE:
+            rectangleRGBA(mTarget, op.dst.x, op.dst.y, op.src.x, op.src.y,
+                          c.r, c.g, c.b, c.a);
+            break;
+        case DrawOp::FILL:
+            boxRGBA(mTarget, op.dst.x, op.dst.y, op.src.x, op.src.y,
+                    c.r, c.g, c.b, c.a);
+            break;
+    }
+}
+
+bool SDLGraphics::findDirtyRects()
+{
+    const int columns = (mTarget->w + CELL_SIZE - 1) / CELL_SIZE;
+    const int rows = (mTarget->h + CELL_SIZE - 1) / CELL_SIZE;
+
+    mCells.assign(columns * rows, 2166136261u);
+
+    // The operations are hashed in drawing order, so that a changed order
+    // of overlapping images counts as a change as well
+    for (DrawOps::const_iterator i = mOps.begin(); i != mOps.end(); ++i)
+    {
+        const Uint32 opHash = hash(*i);
+        const int x1 = i->bounds.x / CELL_SIZE;
+        const int y1 = i->bounds.y / CELL_SIZE;
+        const int x2 = (i->bounds.x + i->bounds.w - 1) / CELL_SIZE;
+        const int y2 = (i->bounds.y + i->bounds.h - 1) / CELL_SIZE;
+
+        for (int y = y1; y <= y2; y++)
+            for (int x = x1; x <= x2; x++)
+                mCells[y * columns + x] = mix(mCells[y * columns + x], opHash);
+    }
+
+    bool partial = !mInvalidated && mCells.size() == mLastCells.size();
+    unsigned int dirtyCells = 0;
+
+    mRects.clear();
+    mInvalidated = false;
+
+    for (int y = 0; y < rows && partial; y++)
+    {
+        const int top = y * CELL_SIZE;
+        const int height = std::min(CELL_SIZE, mTarget->h - top);
+
+        for (int x = 0; x < columns; x++)
+        {
+            if (mCells[y * columns + x] == mLastCells[y * columns + x])
+                continue;
+
+            // Take the whole run of changed cells on this row
+            const int first = x;
+            while (x < columns &&
+                   mCells[y * columns + x] != mLastCells[y * columns + x])
+                x++;
+
+            dirtyCells += x - first;
+
+            const int left = first * CELL_SIZE;
+            const int width = std::min(x * CELL_SIZE, (int) mTarget->w) - left;
+
+            // Grow the run of the row above when it spans the same columns
+            std::vector<SDL_Rect>::iterator r = mRects.begin();
+            while (r != mRects.end() && !(r->x == left && r->w == width &&
+                                          r->y + r->h == top))
+                ++r;
+
+            if (r != mRects.end())
+                r->h += height;
+            else
+                mRects.push_back(makeRect(left, top, width, height));
+        }
+
+        if (mRects.size() > MAX_DIRTY_RECTS || dirtyCells * 2 > mCells.size())
+            partial = false;
+    }
+
+    mLastCells.swap(mCells);
+
+    return partial;
+}
+
+Uint32 SDLGraphics::hash(const DrawOp &op)
+{
+    const size_t surface = (size_t) op.surface;
+
+    Uint32 result = mix(2166136261u, op.type);
+    result = mix(result, (Uint32) surface);
+    result = mix(result, (Uint32) (surface >> 16 >> 16));
+    result = mix(result, op.alphaFlags | (Uint32) op.alpha << 24);
+    result = mix(result, op.src);
+    result = mix(result, op.dst);
+    result = mix(result, op.bounds);
+    result = mix(result, op.color.r | op.color.g << 8 | op.color.b << 16 |
+                         (Uint32) op.color.a << 24);
+
+    return result;
+}
+
+void SDLGraphics::release(DrawOps &ops)
+{
+    for (DrawOps::iterator i = ops.begin(); i != ops.end(); ++i)
+    {
+        if (i->surface)
+            SDL_FreeSurface(i->surface);
+    }
+
+    ops.clear();
 }
 
 SDL_Surface* SDLGraphics::getScreenshot()
@@ -23,13 +23,15 @@
 #ifndef _SDL_GRAPHICS_H
 #define _SDL_GRAPHICS_H
 
+#include <vector>
+
+#include <SDL.h>
+
 #include "../graphics.h"
 
 class Image;
 class ImageRect;
 
-struct SDL_Surface;
-
 /**
  * A central point of control for SDLGraphics.
  */
@@ -102,12 +104,88 @@ class SDLGraphics : public Graphics
          * Takes a screenshot and returns it as SDL surface.
          */
         virtual SDL_Surface* getScreenshot();
+
+        /**
+         * Forces the next frame to be drawn in full when dirty rectangles
+         * are used.
+         */
+        virtual void invalidate() { mInvalidated = true; }
+
         // Inherited from Graphics
 
         virtual void _beginDraw();
 
         virtual void _endDraw();
 
+    private:
+        /**
+         * A drawing operation recorded in dirty rectangle mode. Operations
+         * are replayed once the changed areas of the frame are known.
+         */
+        struct DrawOp
+        {
+            enum Type { BLIT, POINT, LINE, RECTANGLE, FILL };
+
+            Type type;
+            SDL_Surface *surface;    /**< Blitted surface, holds a reference */
+            Uint32 alphaFlags;       /**< Alpha state of the surface */
+            Uint8 alpha;
+            SDL_Rect src;            /**< Blitted area of the surface */
+            SDL_Rect dst;            /**< Blit position or primitive points */
+            SDL_Rect clip;           /**< Clip area at the time of drawing */
+            SDL_Rect bounds;         /**< Touched screen area, clipped */
+            gcn::Color color;
+        };
+
+        typedef std::vector<DrawOp> DrawOps;
+
+        /**
+         * Blits a surface, or records the blit in dirty rectangle mode.
+         */
+        void blit(SDL_Surface *surface, SDL_Rect &srcRect, SDL_Rect &dstRect);
+
+        /**
+         * Records a primitive covering the given screen area. Returns false
+         * when the primitive is to be drawn directly.
+         */
+        bool record(DrawOp::Type type, int x1, int y1, int x2, int y2,
+                    const SDL_Rect &area);
+
+        /**
+         * Adds the operation to the recorded frame if the screen area it
+         * covers is visible.
+         */
+        void record(DrawOp &op, const SDL_Rect &area);
+
+        /**
+         * Draws an operation, limited to the given screen area.
+         */
+        void replay(const DrawOp &op, const SDL_Rect &area);
+
+        /**
+         * Hashes the recorded frame into the screen cells and collects the
+         * areas which differ from the previous frame. Returns false when the
+         * whole screen has to be drawn.
+         */
+        bool findDirtyRects();
+
+        /**
+         * Returns a hash of everything which affects the drawn pixels.
+         */
+        static Uint32 hash(const DrawOp &op);
+
+        /**
+         * Drops the surface references held by the operations.
+         */
+        static void release(DrawOps &ops);
+
+        bool mDirtyRects;            /**< Whether only changes are drawn */
+        bool mInvalidated;           /**< Whether to draw the next frame in full */
+        DrawOps mOps;                /**< Operations of the current frame */
+        DrawOps mLastOps;            /**< Operations of the previous frame */
+        std::vector<Uint32> mCells;  /**< Hashes of the screen cells */
+        std::vector<Uint32> mLastCells;
+        std::vector<SDL_Rect> mRects; /**< Changed areas of the frame */
 };
 
 #endif
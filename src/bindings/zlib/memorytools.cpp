@@ -28,17 +28,21 @@
 
 #include "../../core/log.h"
 
-unsigned int inflateMemory(unsigned char *in, const unsigned int &inLength,
-                           unsigned char *&out)
+/**
+ * Inflates the given data into out, which holds outLength bytes. When grow is
+ * set, out is reallocated whenever it is full, otherwise inflating stops when
+ * it is full and Z_BUF_ERROR is returned. On return, outLength holds the
+ * number of bytes inflated.
+ */
+static int inflateBuffer(unsigned char *in, const unsigned int &inLength,
+                         unsigned char *&out, unsigned int &outLength,
+                         const bool grow)
 {
-    int bufferSize = 256 * 1024;
+    unsigned int bufferSize = outLength;
     int ret;
-    unsigned int outLength = 0u;
     z_stream strm;
 
-    out = (unsigned char*) malloc(bufferSize);
-
-    /* allocate deflate state */
+    /* allocate inflate state */
     strm.zalloc = Z_NULL;
     strm.zfree = Z_NULL;
     strm.opaque = Z_NULL;
@@ -50,60 +54,62 @@ unsigned int inflateMemory(unsigned char *in, const unsigned int &inLength,
     ret = inflateInit2(&strm, 15 + 32);
 
     if (ret != Z_OK)
+    {
+        outLength = 0u;
         return ret;
+    }
 
-    do
+    for (;;)
     {
-        if (strm.next_out == NULL)
-        {
-            inflateEnd(&strm);
-            return Z_MEM_ERROR;
-        }
-
         ret = inflate(&strm, Z_NO_FLUSH);
         assert(ret != Z_STREAM_ERROR);
 
-        switch (ret)
+        if (ret == Z_STREAM_END)
+            break;
+
+        if (ret == Z_NEED_DICT)
+            ret = Z_DATA_ERROR;
+
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            break;
+
+        // Output space left means the input ended before the stream did
+        if (strm.avail_out > 0)
         {
-            case Z_NEED_DICT:
-                ret = Z_DATA_ERROR;
-            case Z_DATA_ERROR:
-            case Z_MEM_ERROR:
-                (void) inflateEnd(&strm);
-                return ret;
+            ret = Z_DATA_ERROR;
+            break;
         }
 
-        if (ret != Z_STREAM_END)
+        if (!grow)
         {
-            out = (unsigned char*) realloc(out, bufferSize * 2);
+            ret = Z_BUF_ERROR;
+            break;
+        }
 
-            if (out == NULL)
-            {
-                inflateEnd(&strm);
-                return Z_MEM_ERROR;
-            }
+        unsigned char *larger = (unsigned char*) realloc(out, bufferSize * 2);
 
-            strm.next_out = out + bufferSize;
-            strm.avail_out = bufferSize;
-            bufferSize *= 2;
+        if (larger == NULL)
+        {
+            ret = Z_MEM_ERROR;
+            break;
         }
-    }
-    while (ret != Z_STREAM_END);
-    assert(strm.avail_in == 0);
 
-    if (ret != Z_STREAM_END)
-    {
-        reportError(ret, out);
-        outLength = 0u;
+        out = larger;
+        strm.next_out = out + bufferSize;
+        strm.avail_out = bufferSize;
+        bufferSize *= 2;
     }
-    else
-        outLength = bufferSize - strm.avail_out;
+
+    outLength = bufferSize - strm.avail_out;
 
     (void) inflateEnd(&strm);
-    return outLength;
+    return ret == Z_STREAM_END ? Z_OK : ret;
 }
 
-void reportError(const int &errorCode, unsigned char *&out)
+/**
+ * Logs a zlib error.
+ */
+static void logError(const int &errorCode)
 {
     if (errorCode == Z_MEM_ERROR)
        logger->log("Error: Out of memory while decompressing data!");
@@ -113,6 +119,53 @@ void reportError(const int &errorCode, unsigned char *&out)
        logger->log("Error: Incorrect zlib compressed data!");
     else
        logger->log("Error: Unknown error while decompressing data!");
+}
+
+unsigned int inflateMemory(unsigned char *in, const unsigned int &inLength,
+                           unsigned char *&out,
+                           const unsigned int &expectedLength)
+{
+    unsigned int outLength = expectedLength > 0 ? expectedLength : 256 * 1024;
+
+    out = (unsigned char*) malloc(outLength);
+
+    if (out == NULL)
+    {
+        logError(Z_MEM_ERROR);
+        return 0u;
+    }
+
+    const int ret = inflateBuffer(in, inLength, out, outLength, true);
+
+    if (ret != Z_OK)
+    {
+        reportError(ret, out);
+        return 0u;
+    }
+
+    return outLength;
+}
+
+unsigned int inflateMemoryInto(unsigned char *in, const unsigned int &inLength,
+                               unsigned char *out,
+                               const unsigned int &outLength)
+{
+    unsigned int length = outLength;
+    const int ret = inflateBuffer(in, inLength, out, length, false);
+
+    // A full buffer isn't an error, the rest of the data is just ignored
+    if (ret != Z_OK && ret != Z_BUF_ERROR)
+    {
+        logError(ret);
+        return 0u;
+    }
+
+    return length;
+}
+
+void reportError(const int &errorCode, unsigned char *&out)
+{
+    logError(errorCode);
 
     free(out);
     out = NULL;
@@ -25,10 +25,22 @@
 
 /**
  * Inflates either zlib or gzip deflated memory. The inflated memory is
- * expected to be freed by the caller.
+ * expected to be freed by the caller. When the inflated size is known or can
+ * be estimated, passing it as expectedLength allocates a buffer of that size
+ * up front, so the buffer only needs to grow when the estimate was too small.
  */
 unsigned int inflateMemory(unsigned char *in, const unsigned int &inLength,
-                           unsigned char *&out);
+                           unsigned char *&out,
+                           const unsigned int &expectedLength = 0);
+
+/**
+ * Inflates either zlib or gzip deflated memory into a buffer provided by the
+ * caller. Data which doesn't fit in the buffer is ignored. Returns the number
+ * of bytes inflated, or 0 when the data couldn't be inflated.
+ */
+unsigned int inflateMemoryInto(unsigned char *in, const unsigned int &inLength,
+                               unsigned char *out,
+                               const unsigned int &outLength);
 
 /**
  * Reports a zlib error to the logger.
@@ -119,6 +119,29 @@ Dye::Dye(const std::string &description)
     for (int i = 0; i < 7; ++i)
         mDyePalettes[i] = 0;
 
+    parse(description);
+
+    for (int i = 0; i < 7; ++i)
+    {
+        if (!mDyePalettes[i])
+            continue;
+
+        const int channels = i + 1;
+        gcn::Color color;
+
+        for (int value = 0; value < 256; ++value)
+        {
+            color.r = channels & DyeTable::RED ? value : 0;
+            color.g = channels & DyeTable::GREEN ? value : 0;
+            color.b = channels & DyeTable::BLUE ? value : 0;
+            mDyePalettes[i]->getColor(value, &color);
+            mTable.setColor(channels, value, color.r, color.g, color.b);
+        }
+    }
+}
+
+void Dye::parse(const std::string &description)
+{
     if (description.empty())
         return;
 
@@ -167,21 +190,12 @@ Dye::~Dye()
 
 void Dye::update(gcn::Color *color) const
 {
-    const int cmax = std::max(color->r, std::max(color->g, color->b));
-    if (cmax == 0)
-        return;
-
-    const int cmin = std::min(color->r, std::min(color->g, color->b));
-    const int intensity = color->r + color->g + color->b;
-
-    // not pure
-    if (cmin != cmax && (cmin != 0 || (intensity != cmax && intensity != 2 * cmax)))
-        return;
-
-    const int i = (color->r != 0) | ((color->g != 0) << 1) | ((color->b != 0) << 2);
+    const uint32_t pixel = mTable.dye((uint32_t) color->r << 24 |
+                                      color->g << 16 | color->b << 8 | 255);
 
-    if (mDyePalettes[i - 1])
-        mDyePalettes[i - 1]->getColor(cmax, color);
+    color->r = pixel >> 24;
+    color->g = (pixel >> 16) & 255;
+    color->b = (pixel >> 8) & 255;
 }
 
 void Dye::instantiate(std::string &target, const std::string &palettes)
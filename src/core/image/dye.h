@@ -26,6 +26,8 @@
 #include <string>
 #include <vector>
 
+#include "dyetable.h"
+
 #include "../../bindings/guichan/guichanfwd.h"
 
 /**
@@ -78,6 +80,12 @@ class Dye
          */
         void update(gcn::Color *color) const;
 
+        /**
+         * Recolors 32-bit RGBA pixels, with the alpha in the lowest byte.
+         */
+        void apply(uint32_t *pixels, const int count) const
+        { mTable.apply(pixels, count); }
+
         /**
          * Fills the blank in a dye placeholder with some palette names.
          */
@@ -86,12 +94,23 @@ class Dye
 
     private:
 
+        /**
+         * Reads the palettes from the description.
+         */
+        void parse(const std::string &description);
+
         /**
          * The order of the palettes, as well as their uppercase letter, is:
          *
          * Red, Green, Yellow, Blue, Magenta, White (or rather gray).
          */
         DyePalette *mDyePalettes[7];
+
+        /**
+         * The colors of all palettes, computed once so that recoloring only
+         * needs a lookup per pixel.
+         */
+        DyeTable mTable;
 };
 
 #endif
@@ -0,0 +1,121 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "dyetable.h"
+
+DyeTable::DyeTable()
+{
+    for (int channels = 0; channels < 8; channels++)
+    {
+        for (int value = 0; value < 256; value++)
+        {
+            setColor(channels, value,
+                     channels & RED ? value : 0,
+                     channels & GREEN ? value : 0,
+                     channels & BLUE ? value : 0);
+        }
+    }
+}
+
+void DyeTable::setColor(const int channels, const int value,
+                        const int r, const int g, const int b)
+{
+    mColors[channels * 256 + value] = (uint32_t) r << 24 | g << 16 | b << 8;
+}
+
+uint32_t DyeTable::dye(const uint32_t pixel) const
+{
+    const uint32_t alpha = pixel & 255;
+    const uint32_t r = pixel >> 24;
+    const uint32_t g = (pixel >> 16) & 255;
+    const uint32_t b = (pixel >> 8) & 255;
+    const uint32_t value = std::max(r, std::max(g, b));
+
+    if (!alpha || (r && r != value) || (g && g != value) || (b && b != value))
+        return pixel;
+
+    const int channels = (r != 0) | (g != 0) << 1 | (b != 0) << 2;
+
+    return mColors[channels * 256 + value] | alpha;
+}
+
+void DyeTable::apply(uint32_t *pixels, const int count) const
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i byte = _mm_set1_epi32(255);
+    const __m128i zero = _mm_setzero_si128();
+
+    // Finds the pure pixels and their table index four at a time, only the
+    // table lookups are done one by one
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i *block = (__m128i*) (pixels + i);
+        const __m128i pixel = _mm_loadu_si128(block);
+        const __m128i r = _mm_srli_epi32(pixel, 24);
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(pixel, 16), byte);
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(pixel, 8), byte);
+        const __m128i alpha = _mm_and_si128(pixel, byte);
+
+        // The channels fit in 16 bits, so the 16-bit maximum works on them
+        const __m128i value = _mm_max_epi16(r, _mm_max_epi16(g, b));
+
+        const __m128i rOff = _mm_cmpeq_epi32(r, zero);
+        const __m128i gOff = _mm_cmpeq_epi32(g, zero);
+        const __m128i bOff = _mm_cmpeq_epi32(b, zero);
+
+        __m128i pure = _mm_or_si128(rOff, _mm_cmpeq_epi32(r, value));
+        pure = _mm_and_si128(pure, _mm_or_si128(gOff, _mm_cmpeq_epi32(g, value)));
+        pure = _mm_and_si128(pure, _mm_or_si128(bOff, _mm_cmpeq_epi32(b, value)));
+        pure = _mm_andnot_si128(_mm_cmpeq_epi32(alpha, zero), pure);
+
+        if (_mm_movemask_epi8(pure) == 0)
+            continue;
+
+        __m128i index = _mm_andnot_si128(rOff, _mm_set1_epi32(RED * 256));
+        index = _mm_or_si128(index, _mm_andnot_si128(gOff,
+                                                     _mm_set1_epi32(GREEN * 256)));
+        index = _mm_or_si128(index, _mm_andnot_si128(bOff,
+                                                     _mm_set1_epi32(BLUE * 256)));
+        index = _mm_or_si128(index, value);
+
+        uint32_t indices[4];
+        _mm_storeu_si128((__m128i*) indices, index);
+
+        const __m128i colors = _mm_or_si128(alpha,
+            _mm_set_epi32(mColors[indices[3]], mColors[indices[2]],
+                          mColors[indices[1]], mColors[indices[0]]));
+
+        _mm_storeu_si128(block, _mm_or_si128(_mm_and_si128(pure, colors),
+                                             _mm_andnot_si128(pure, pixel)));
+    }
+#endif
+
+    for (; i < count; i++)
+        pixels[i] = dye(pixels[i]);
+}
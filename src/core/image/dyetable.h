@@ -0,0 +1,75 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DYETABLE_H
+#define DYETABLE_H
+
+#include <stdint.h>
+
+/**
+ * The colors a dye turns pure colors into. A color is pure when all of its
+ * channels are either off or at the same value, so it can be looked up by
+ * the set of channels which are on and that value.
+ *
+ * Pixels are 32-bit RGBA with the red channel in the highest byte and the
+ * alpha channel in the lowest one.
+ */
+class DyeTable
+{
+    public:
+        /**
+         * Channel bits of the colors in the table.
+         */
+        enum
+        {
+            RED = 1,
+            GREEN = 2,
+            BLUE = 4
+        };
+
+        /**
+         * Creates a table which leaves all colors as they are.
+         */
+        DyeTable();
+
+        /**
+         * Sets the color which the pure color with the given channels and
+         * value turns into.
+         */
+        void setColor(const int channels, const int value,
+                      const int r, const int g, const int b);
+
+        /**
+         * Recolors a single pixel.
+         */
+        uint32_t dye(const uint32_t pixel) const;
+
+        /**
+         * Recolors the given pixels. Transparent pixels and pixels which are
+         * not pure are left alone.
+         */
+        void apply(uint32_t *pixels, const int count) const;
+
+    private:
+        uint32_t mColors[8 * 256];   /**< Indexed by channels * 256 + value */
+};
+
+#endif
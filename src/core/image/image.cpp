@@ -20,17 +20,27 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
 #include <SDL_image.h>
 #include <SDL_rotozoom.h>
 
-#include <guichan/color.hpp>
-
 #include "dye.h"
 #include "image.h"
+#include "textureatlas.h"
 
 #include "../log.h"
 
-#include "../utils/dtor.h"
+/**
+ * Number of alpha values images with an alpha channel are drawn at in SDL
+ * mode. Every level an image is drawn at costs a copy of its surface.
+ */
+static const int ALPHA_LEVELS = 32;
+
+/**
+ * Number of pixels the copies of an image for other alpha values may take
+ * together, before the ones made so far are thrown away.
+ */
+static const int MAX_VARIANT_PIXELS = 1024 * 1024;
 
 #ifdef USE_OPENGL
 #include "../../bindings/guichan/opengl/openglgraphics.h"
@@ -41,13 +51,13 @@ int Image::mTextureType = 0;
 int Image::mTextureSize = 0;
 #endif
 
-Image::Image(SDL_Surface *image, uint8_t* alphas):
-    mStoredAlpha(alphas),
+Image::Image(SDL_Surface *image):
 #ifdef USE_OPENGL
     mGLImage(0),
 #endif
     mImage(image),
-    mAlpha(1.0f)
+    mAlpha(1.0f),
+    mVariantCount(0)
 {
     mBounds.x = 0;
     mBounds.y = 0;
@@ -58,12 +68,12 @@ Image::Image(SDL_Surface *image, uint8_t* alphas):
 #ifdef USE_OPENGL
 Image::Image(const GLuint &glimage, const int width, const int height,
              const int texWidth, const int texHeight):
-    mStoredAlpha(NULL),
     mGLImage(glimage),
     mTexWidth(texWidth),
     mTexHeight(texHeight),
     mImage(0),
-    mAlpha(1.0)
+    mAlpha(1.0),
+    mVariantCount(0)
 {
     mBounds.x = 0;
     mBounds.y = 0;
@@ -77,7 +87,7 @@ Image::~Image()
     unload();
 }
 
-Resource *Image::load(SDL_RWops *rw)
+Resource *Image::load(SDL_RWops *rw, TextureAtlas *atlas)
 {
     SDL_Surface *tmpImage = IMG_Load_RW(rw, 1);
 
@@ -87,13 +97,13 @@ Resource *Image::load(SDL_RWops *rw)
         return NULL;
     }
 
-    Image *image = load(tmpImage);
+    Image *image = load(tmpImage, atlas);
 
     SDL_FreeSurface(tmpImage);
     return image;
 }
 
-Resource *Image::load(SDL_RWops *rw, const Dye &dye)
+Resource *Image::load(SDL_RWops *rw, const Dye &dye, TextureAtlas *atlas)
 {
     SDL_Surface *tmpImage = IMG_Load_RW(rw, 1);
 
@@ -103,6 +113,35 @@ Resource *Image::load(SDL_RWops *rw, const Dye &dye)
         return NULL;
     }
 
+    SDL_Surface *surf = convertToRGBA(tmpImage);
+    SDL_FreeSurface(tmpImage);
+
+    if (!surf)
+        return NULL;
+
+    dye.apply(static_cast<uint32_t*>(surf->pixels), surf->w * surf->h);
+
+    Image *image = load(surf, atlas);
+    SDL_FreeSurface(surf);
+    return image;
+}
+
+Image *Image::load(SDL_Surface *rgba, const Dye &dye, TextureAtlas *atlas)
+{
+    SDL_Surface *surf = SDL_ConvertSurface(rgba, rgba->format, SDL_SWSURFACE);
+
+    if (!surf)
+        return NULL;
+
+    dye.apply(static_cast<uint32_t*>(surf->pixels), surf->w * surf->h);
+
+    Image *image = load(surf, atlas);
+    SDL_FreeSurface(surf);
+    return image;
+}
+
+SDL_Surface *Image::convertToRGBA(SDL_Surface *surface)
+{
     SDL_PixelFormat rgba;
     rgba.palette = NULL;
     rgba.BitsPerPixel = 32;
@@ -114,27 +153,7 @@ Resource *Image::load(SDL_RWops *rw, const Dye &dye)
     rgba.colorkey = 0;
     rgba.alpha = 255;
 
-    SDL_Surface *surf = SDL_ConvertSurface(tmpImage, &rgba, SDL_SWSURFACE);
-    SDL_FreeSurface(tmpImage);
-
-    uint32_t *pixels = static_cast<uint32_t* >(surf->pixels);
-    for (uint32_t *p_end = pixels + surf->w * surf->h; pixels != p_end; ++pixels)
-    {
-        int alpha = *pixels & 255;
-        if (!alpha)
-            continue;
-        gcn::Color *v = new gcn::Color();
-        v->r = (*pixels >> 24) & 255;
-        v->g = (*pixels >> 16) & 255;
-        v->b = (*pixels >> 8 ) & 255;
-        dye.update(v);
-        *pixels = (v->r << 24) | (v->g << 16) | (v->b << 8) | alpha;
-        destroy(v);
-    }
-
-    Image *image = load(surf);
-    SDL_FreeSurface(surf);
-    return image;
+    return SDL_ConvertSurface(surface, &rgba, SDL_SWSURFACE);
 }
 
 Resource *Image::resize(Image *image, const int width, const int height)
@@ -142,11 +161,20 @@ Resource *Image::resize(Image *image, const int width, const int height)
     return image->resize(width, height);
 }
 
-Image *Image::load(SDL_Surface *tmpImage)
+Image *Image::load(SDL_Surface *tmpImage, TextureAtlas *atlas)
 {
 #ifdef USE_OPENGL
     if (mUseOpenGL)
     {
+        // Small images share a texture with others, so drawing them doesn't
+        // need to switch textures as often
+        if (atlas)
+        {
+            SubImage *packed = atlas->add(tmpImage);
+            if (packed)
+                return packed;
+        }
+
         // Flush current error flag.
         glGetError();
 
@@ -161,34 +189,10 @@ Image *Image::load(SDL_Surface *tmpImage)
                     tmpImage->w, tmpImage->h);
         }
 
-        // Make sure the alpha channel is not used, but copied to destination
-        SDL_SetAlpha(tmpImage, 0, SDL_ALPHA_OPAQUE);
-
-        // Determine 32-bit masks based on byte order
-        uint32_t rmask, gmask, bmask, amask;
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-        rmask = 0xff000000;
-        gmask = 0x00ff0000;
-        bmask = 0x0000ff00;
-        amask = 0x000000ff;
-#else
-        rmask = 0x000000ff;
-        gmask = 0x0000ff00;
-        bmask = 0x00ff0000;
-        amask = 0xff000000;
-#endif
-
-        SDL_Surface *oldImage = tmpImage;
-        tmpImage = SDL_CreateRGBSurface(SDL_SWSURFACE, realWidth, realHeight,
-                                        32, rmask, gmask, bmask, amask);
+        tmpImage = convertToTexture(tmpImage, realWidth, realHeight);
 
         if (!tmpImage)
-        {
-            logger->log("Error, image convert failed: out of memory");
             return NULL;
-        }
-
-        SDL_BlitSurface(oldImage, NULL, tmpImage, NULL);
 
         GLuint texture;
         glGenTextures(1, &texture);
@@ -244,7 +248,6 @@ Image *Image::load(SDL_Surface *tmpImage)
 
     bool hasAlpha = false;
 
-    uint8_t* imageAlphas = new uint8_t[tmpImage->w * tmpImage->h];
     if (tmpImage->format->BitsPerPixel == 32)
     {
         // Figure out whether the image uses its alpha layer
@@ -254,10 +257,11 @@ Image *Image::load(SDL_Surface *tmpImage)
             SDL_GetRGBA(((uint32_t*) tmpImage->pixels)[i],
                           tmpImage->format, &r, &g, &b, &a);
 
-            imageAlphas[i] = a;
-
             if (a != 255)
+            {
                 hasAlpha = true;
+                break;
+            }
         }
     }
 
@@ -272,28 +276,29 @@ Image *Image::load(SDL_Surface *tmpImage)
     if (!image)
     {
         logger->log("Error: Image convert failed.");
-        delete [] imageAlphas;
         return NULL;
     }
 
-    return new Image(image, imageAlphas);
+    return new Image(image);
 }
 
 void Image::unload()
 {
     mLoaded = false;
 
+    clearVariants();
+
     if (mImage)
     {
         // Free the image surface.
         SDL_FreeSurface(mImage);
         mImage = NULL;
-        delete [] mStoredAlpha;
     }
 
 #ifdef USE_OPENGL
     if (mGLImage)
     {
+        OpenGLGraphics::forgetTexture(mGLImage);
         glDeleteTextures(1, &mGLImage);
         mGLImage = 0;
     }
@@ -312,29 +317,12 @@ Image* Image::resize(const int width, const int height)
     
     if (mImage)
     {
-        SDL_Surface* scaledSurface = NULL;
-        uint8_t* imageAlphas = NULL;
-
         const double scaleX = (double) width / (double) getWidth();
         const double scaleY = (double) height / (double) getHeight();
 
-        scaledSurface = zoomSurface(mImage, scaleX, scaleY, 1);
+        SDL_Surface* scaledSurface = zoomSurface(mImage, scaleX, scaleY, 1);
 
-        imageAlphas = new uint8_t[scaledSurface->w * scaledSurface->h];
-        if (scaledSurface->format->BitsPerPixel == 32)
-        {
-            // Recalculate the alpha layers
-            for (int i = 0; i < scaledSurface->w * scaledSurface->h; ++i)
-            {
-                uint8_t r, g, b, a;
-                SDL_GetRGBA(((uint32_t*) scaledSurface->pixels)[i],
-                              scaledSurface->format, &r, &g, &b, &a);
-
-                imageAlphas[i] = a;
-            }
-        }
-
-        return new Image(scaledSurface, imageAlphas);
+        return new Image(scaledSurface);
     }
 
     return this;
@@ -353,38 +341,95 @@ SubImage *Image::getSubImage(const int x, const int y, const int width,
     return new SubImage(this, mImage, x, y, width, height);
 }
 
-void Image::setAlpha(float alpha)
+SDL_Surface *Image::getVariant(const float alpha)
 {
-    if (mAlpha == alpha)
-        return;
+    if (!mImage)
+        return NULL;
 
-    mAlpha = alpha;
+    if (!mImage->format->Amask)
+    {
+        // Only changes the surface when the value differs from the last one
+        if (alpha >= 1.0f)
+            SDL_SetAlpha(mImage, 0, SDL_ALPHA_OPAQUE);
+        else
+            SDL_SetAlpha(mImage, SDL_SRCALPHA, (uint8_t) (alpha * 255));
 
-#ifdef USE_OPENGL
-    if (mImage && !mUseOpenGL)
-#else
-    if (mImage)
-#endif
+        return mImage;
+    }
+
+    const int level = (int) (alpha * (ALPHA_LEVELS - 1) + 0.5f);
+
+    if (level >= ALPHA_LEVELS - 1 || mImage->format->BytesPerPixel != 4)
+        return mImage;
+
+    if (mVariants.empty())
+        mVariants.resize(ALPHA_LEVELS - 1, NULL);
+
+    if (!mVariants[level])
     {
-        if (SDL_MUSTLOCK(mImage))
-            SDL_LockSurface(mImage);
+        // Large images only keep a few copies around
+        const int maxVariants = std::max(1, MAX_VARIANT_PIXELS /
+                                            (mImage->w * mImage->h));
+        if (mVariantCount >= maxVariants)
+            clearVariants();
 
-        // Set the alpha value this image is drawn at, pixel by pixel
-        for (int i = 0; i < mImage->w * mImage->h; i++)
-        {
-            uint8_t r, g, b, a;
-            SDL_GetRGBA(((uint32_t*) mImage->pixels)[i], mImage->format, &r, 
-                                                         &g, &b, &a);
+        mVariants[level] = createVariant(level);
+
+        if (!mVariants[level])
+            return mImage;
+
+        mVariantCount++;
+    }
+
+    return mVariants[level];
+}
+
+SDL_Surface *Image::createVariant(const int level) const
+{
+    SDL_Surface *variant = SDL_ConvertSurface(mImage, mImage->format,
+                                              mImage->flags);
+    if (!variant)
+    {
+        logger->log("Error: Image alpha copy failed.");
+        return NULL;
+    }
+
+    const SDL_PixelFormat *format = variant->format;
 
-            a = (uint8_t) (mStoredAlpha[i] * mAlpha);
+    if (SDL_MUSTLOCK(variant))
+        SDL_LockSurface(variant);
 
-            ((uint32_t *)(mImage->pixels))[i] = SDL_MapRGBA(mImage->format, r,
-                                                            g, b, a);
+    for (int y = 0; y < variant->h; y++)
+    {
+        uint32_t *pixel = (uint32_t*) ((uint8_t*) variant->pixels +
+                                       y * variant->pitch);
+
+        for (uint32_t *end = pixel + variant->w; pixel != end; ++pixel)
+        {
+            const uint32_t a = (*pixel & format->Amask) >> format->Ashift;
+            *pixel = (*pixel & ~format->Amask) |
+                     ((a * level / (ALPHA_LEVELS - 1)) << format->Ashift);
         }
+    }
 
-        if (SDL_MUSTLOCK(mImage))
-            SDL_UnlockSurface(mImage);
+    if (SDL_MUSTLOCK(variant))
+        SDL_UnlockSurface(variant);
+
+    return variant;
+}
+
+void Image::clearVariants()
+{
+    for (unsigned int i = 0; i < mVariants.size(); i++)
+    {
+        if (mVariants[i])
+        {
+            SDL_FreeSurface(mVariants[i]);
+            mVariants[i] = NULL;
+        }
     }
+
+    mVariantCount = 0;
 }
 
 Image* Image::merge(Image* image, const int x, const int y)
@@ -470,11 +515,6 @@ Image* Image::merge(Image* image, const int x, const int y)
     return newImage;
 }
 
-float Image::getAlpha() const
-{
-    return mAlpha;
-}
-
 #ifdef USE_OPENGL
 void Image::setLoadAsOpenGL(const bool useOpenGL)
 {
@@ -494,6 +534,41 @@ int Image::powerOfTwo(const int input)
 
     return value >= mTextureSize ? mTextureSize : value;
 }
+
+SDL_Surface *Image::convertToTexture(SDL_Surface *surface, const int width,
+                                     const int height)
+{
+    // Make sure the alpha channel is not used, but copied to destination
+    SDL_SetAlpha(surface, 0, SDL_ALPHA_OPAQUE);
+
+    // Determine 32-bit masks based on byte order
+    uint32_t rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0xff000000;
+    gmask = 0x00ff0000;
+    bmask = 0x0000ff00;
+    amask = 0x000000ff;
+#else
+    rmask = 0x000000ff;
+    gmask = 0x0000ff00;
+    bmask = 0x00ff0000;
+    amask = 0xff000000;
+#endif
+
+    SDL_Surface *converted = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                                  32, rmask, gmask, bmask,
+                                                  amask);
+
+    if (!converted)
+    {
+        logger->log("Error, image convert failed: out of memory");
+        return NULL;
+    }
+
+    SDL_BlitSurface(surface, NULL, converted, NULL);
+
+    return converted;
+}
 #endif
 
 //============================================================================
@@ -547,43 +622,7 @@ SubImage *SubImage::getSubImage(const int x, const int y, const int w,
     return mParent->getSubImage(mBounds.x + x, mBounds.y + y, w, h);
 }
 
-void SubImage::setAlpha(float alpha)
+SDL_Surface *SubImage::getAlphaSurface()
 {
-    if (mAlpha == alpha)
-        return;
-
-    mAlpha = alpha;
-
-#ifdef USE_OPENGL
-    if (mImage && !mUseOpenGL)
-#else
-    if (mImage)
-#endif
-    {
-        if (SDL_MUSTLOCK(mImage))
-            SDL_LockSurface(mImage);
-
-        // Set the alpha value this image is drawn at, pixel by pixel
-        for (int offsetY = 0; offsetY < getHeight() &&
-            (offsetY + mBounds.y) < mParent->getHeight(); offsetY++)
-        {
-            for (int offsetX = 0; offsetX < getWidth() &&
-                (offsetX + mBounds.x) < mParent->getWidth(); offsetX++)
-            {
-                int i = (offsetY + mBounds.y) * mParent->getWidth() + offsetX +
-                        mBounds.x;
-                uint8_t r, g, b, a;
-                SDL_GetRGBA(((uint32_t*) mImage->pixels)[i], mImage->format, &r, 
-                            &g, &b, &a);
-
-                a = (uint8_t) (mParent->mStoredAlpha[i] * mAlpha);
-
-                ((uint32_t *)(mImage->pixels))[i] = SDL_MapRGBA(mImage->format,
-                                                                r, g, b, a);
-            }
-        }
-        if (SDL_MUSTLOCK(mImage))
-            SDL_UnlockSurface(mImage);
-    }
+    return mParent->getVariant(mAlpha);
 }
-
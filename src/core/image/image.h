@@ -24,6 +24,7 @@
 #define IMAGE_H
 
 #include <SDL.h>
+#include <vector>
 
 #ifdef HAVE_CONFIG_H
 #include "../../../config.h"
@@ -46,15 +47,18 @@ class Dye;
 class SDL_Rect;
 class SDL_Surface;
 class SubImage;
+class TextureAtlas;
 
 /**
  * Defines a class for loading and storing images.
  */
 class Image : public Resource
 {
+    friend class NullGraphics;
     friend class SDLGraphics;
 #ifdef USE_OPENGL
     friend class OpenGLGraphics;
+    friend class TextureAtlas;
 #endif
 
     friend class SubImage;
@@ -69,22 +73,25 @@ class Image : public Resource
          * Loads an image from an SDL_RWops structure.
          *
          * @param rw         The SDL_RWops to load the image from.
+         * @param atlas      The atlas to pack the image into, if it fits.
          *
          * @return <code>NULL</code> if an error occurred, a valid pointer
          *         otherwise.
          */
-        static Resource *load(SDL_RWops *rw);
+        static Resource *load(SDL_RWops *rw, TextureAtlas *atlas = NULL);
 
         /**
          * Loads an image from a buffer in memory and recolors it.
          *
          * @param rw         The SDL_RWops to load the image from.
          * @param dye        The dye used to recolor the image.
+         * @param atlas      The atlas to pack the image into, if it fits.
          *
          * @return <code>NULL</code> if an error occurred, a valid pointer
          *         otherwise.
          */
-        static Resource *load(SDL_RWops *rw, const Dye &dye);
+        static Resource *load(SDL_RWops *rw, const Dye &dye,
+                              TextureAtlas *atlas = NULL);
 
         /**
          * Loads a resized image from another image. Essentially just a wrapper
@@ -101,9 +108,23 @@ class Image : public Resource
 
 
         /**
-         * Loads an image from an SDL surface.
+         * Loads an image from an SDL surface. When an atlas is given and the
+         * image fits into it, the image is packed into one of its pages.
          */
-        static Image *load(SDL_Surface *);
+        static Image *load(SDL_Surface *, TextureAtlas *atlas = NULL);
+
+        /**
+         * Loads a recolored copy of a surface, which has to be in the format
+         * returned by convertToRGBA.
+         */
+        static Image *load(SDL_Surface *rgba, const Dye &dye,
+                           TextureAtlas *atlas = NULL);
+
+        /**
+         * Converts a surface to 32-bit RGBA with the alpha in the lowest
+         * byte, the format dyes are applied to. The caller frees the result.
+         */
+        static SDL_Surface *convertToRGBA(SDL_Surface *surface);
 
         /**
          * Frees the resources created by SDL.
@@ -120,6 +141,11 @@ class Image : public Resource
          */
         virtual int getHeight() const { return mBounds.h; }
 
+        /**
+         * Returns the area of the underlying pixel data covered by the image.
+         */
+        const SDL_Rect &getBounds() const { return mBounds; }
+
         /**
          * Creates a new image with the desired clipping rectangle.
          *
@@ -130,14 +156,21 @@ class Image : public Resource
                                       const int width, const int height);
 
         /**
-         * Sets the alpha value of this image.
+         * Sets the alpha value this image is drawn at. The pixel data is left
+         * alone, so this is cheap enough to call every frame.
          */
-        virtual void setAlpha(float alpha);
+        void setAlpha(float alpha) { mAlpha = alpha; }
 
         /**
          * Returns the alpha value of this image.
          */
-        float getAlpha() const;
+        float getAlpha() const { return mAlpha; }
+
+        /**
+         * Returns the surface to blit for drawing the image at its alpha
+         * value. Used by SDL only.
+         */
+        virtual SDL_Surface *getAlphaSurface() { return getVariant(mAlpha); }
 
 #ifdef USE_OPENGL
         /**
@@ -146,9 +179,15 @@ class Image : public Resource
          */
         static void setLoadAsOpenGL(const bool useOpenGL);
 
+        /**
+         * Returns whether images are loaded as OpenGL textures.
+         */
+        static bool getLoadAsOpenGL() { return mUseOpenGL; }
+
         int getTextureWidth() const { return mTexWidth; }
         int getTextureHeight() const { return mTexHeight; }
         static int getTextureType() { return mTextureType; }
+        static int getTextureSize() { return mTextureSize; }
 #endif
 
         /**
@@ -169,10 +208,27 @@ class Image : public Resource
 
     protected:
         /**
-         * Returns the current alpha value at a given pixel. Used to compute
-         * what the alpha value should be for a given pixel in SDL mode.
+         * Returns the surface to blit for drawing this image, or the images
+         * cut from it, at the given alpha value.
+         *
+         * Surfaces without an alpha channel are blended with a surface alpha,
+         * which SDL applies while blitting. For surfaces with an alpha channel
+         * SDL ignores the surface alpha, so for those a copy with the alpha
+         * channel scaled to one of ALPHA_LEVELS values is made the first time
+         * it is needed, and kept for the next time.
+         */
+        SDL_Surface *getVariant(const float alpha);
+
+        /**
+         * Makes a copy of the surface with the alpha channel scaled to the
+         * given level.
+         */
+        SDL_Surface *createVariant(const int level) const;
+
+        /**
+         * Frees the copies made for other alpha values.
          */
-        uint8_t* mStoredAlpha;
+        void clearVariants();
 
         /**
          * Constructor.
@@ -185,8 +241,16 @@ class Image : public Resource
          * Returns the first power of two equal or bigger than the input.
          */
         static int powerOfTwo(const int input);
+
+        /**
+         * Copies the surface into a new 32-bit RGBA surface of the given
+         * size, in the layout OpenGL expects the pixels of a texture in.
+         */
+        static SDL_Surface *convertToTexture(SDL_Surface *surface,
+                                             const int width,
+                                             const int height);
 #endif
-        Image(SDL_Surface *image, uint8_t* alphas = NULL);
+        Image(SDL_Surface *image);
 
         SDL_Rect mBounds;
         bool mLoaded;
@@ -202,6 +266,9 @@ class Image : public Resource
 #endif
         SDL_Surface *mImage;
         float mAlpha;
+
+        std::vector<SDL_Surface*> mVariants; /**< Copies by alpha level. */
+        int mVariantCount;
 };
 
 /**
@@ -236,9 +303,15 @@ class SubImage : public Image
                               const int height);
 
         /**
-         * Sets the alpha value of this image.
+         * Returns the surface of the parent image for drawing at the alpha
+         * value of this image.
+         */
+        virtual SDL_Surface *getAlphaSurface();
+
+        /**
+         * Returns the image this image was cut from.
          */
-        virtual void setAlpha(float alpha);
+        Image *getParent() const { return mParent; }
 
     private:
         Image *mParent;
@@ -22,14 +22,14 @@
 
 #include <algorithm>
 #include <cmath>
+#include <ctime>
 
 #include <guichan/color.hpp>
 
-#include "animationparticle.h"
-#include "imageparticle.h"
 #include "particle.h"
+#include "particleeffect.h"
 #include "particleemitter.h"
-#include "rotationalparticle.h"
+#include "particlepool.h"
 #include "textparticle.h"
 
 #include "../../configuration.h"
@@ -40,12 +40,16 @@
 
 #include "../../utils/dtor.h"
 #include "../../utils/fastsqrt.h"
-#include "../../utils/xml.h"
+#include "../../utils/jobsystem.h"
 
 #include "../../../eathena/beingmanager.h"
 
 #define SIN45 0.707106781f
 
+/** Tile size effects are read for when the particle isn't on a map */
+const int DEFAULT_TILE_WIDTH = 32;
+const int DEFAULT_TILE_HEIGHT = 32;
+
 class Graphics;
 class Image;
 
@@ -55,6 +59,16 @@ int Particle::fastPhysics = 0;
 int Particle::emitterSkip = 1;
 const float Particle::PARTICLE_SKY = 800.0f;
 bool Particle::enabled = true;
+ParticlePool *Particle::pool = NULL;
+int Particle::emitterThrottle = 1;
+int Particle::dormancyMargin = 0;
+Random Particle::random;
+
+/** Area where emitters run, empty until the viewport sets it */
+static int activeLeft = 0;
+static int activeTop = 0;
+static int activeRight = -1;
+static int activeBottom = -1;
 
 Particle::Particle(Map *map):
     mAlpha(1.0f),
@@ -65,6 +79,7 @@ Particle::Particle(Map *map):
     mAlive(ALIVE),
     mAutoDelete(true),
     mMap(map),
+    mPooledChildren(0),
     mDeathEffectConditions(0x00),
     mGravity(0.0f),
     mRandomness(0),
@@ -78,17 +93,21 @@ Particle::Particle(Map *map):
     Particle::particleCount++;
 
     if (mMap)
-        setSpriteIterator(mMap->addSprite(this));
+        mMap->addSprite(this);
 }
 
 Particle::~Particle()
 {
     // Remove from map sprite list
     if (mMap)
-        mMap->removeSprite(mSpriteIterator);
+        mMap->removeSprite(this);
 
     // Delete child emitters and child particles
     clear();
+
+    if (this == particleEngine)
+        destroy(Particle::pool);
+
     // Update particle count
     Particle::particleCount--;
 }
@@ -99,6 +118,17 @@ void Particle::setupEngine()
     Particle::fastPhysics = config.getValue("particleFastPhysics", 0);
     Particle::emitterSkip = config.getValue("particleEmitterSkip", 1) + 1;
     Particle::enabled = config.getValue("particleeffects", true);
+    Particle::dormancyMargin = config.getValue("particleDormancyMargin", 256);
+
+    // A fixed seed makes particle effects the same every run
+    const int seed = config.getValue("particleSeed", 0);
+    Particle::random.setSeed(seed ? seed : time(NULL));
+    if (seed)
+        logger->log("Particle engine seeded with %d", seed);
+
+    if (!Particle::pool)
+        Particle::pool =
+            new ParticlePool(JobSystem::getInstance());
     disableAutoDelete();
     logger->log("Particle engine set up");
 }
@@ -153,11 +183,14 @@ bool Particle::update()
 
         if (mRandomness > 0)
         {
-            mVelocity.x += (rand() % mRandomness - rand() % mRandomness) /
+            mVelocity.x += (random.nextInt(mRandomness) -
+                            random.nextInt(mRandomness)) /
                            1000.0f;
-            mVelocity.y += (rand() % mRandomness - rand() % mRandomness) /
+            mVelocity.y += (random.nextInt(mRandomness) -
+                            random.nextInt(mRandomness)) /
                            1000.0f;
-            mVelocity.z += (rand() % mRandomness - rand() % mRandomness) /
+            mVelocity.z += (random.nextInt(mRandomness) -
+                            random.nextInt(mRandomness)) /
                            1000.0f;
         }
 
@@ -193,12 +226,15 @@ bool Particle::update()
         }
 
         // Update child emitters
-        if ((mLifetimePast - 1) % Particle::emitterSkip == 0)
+        if ((mLifetimePast - 1) % (Particle::emitterSkip *
+                                   Particle::emitterThrottle) == 0 &&
+            !mChildEmitters.empty() && !isDormant())
         {
             for (EmitterIterator e = mChildEmitters.begin();
                  e != mChildEmitters.end(); e++)
             {
-                Particles newParticles = (*e)->createParticles(mLifetimePast);
+                Particles newParticles = (*e)->createParticles(mLifetimePast,
+                                                               this);
                 for (ParticleIterator p = newParticles.begin();
                      p != newParticles.end(); p++)
                 {
@@ -243,7 +279,42 @@ bool Particle::update()
         }
     }
 
-    return (mAlive == ALIVE || !mChildParticles.empty() || !mAutoDelete);
+    // The engine updates the particles spawned by all emitters at once, after
+    // their owners had a chance to spawn new ones
+    if (this == particleEngine && Particle::pool)
+        Particle::pool->update();
+
+    return (mAlive == ALIVE || !mChildParticles.empty() || mPooledChildren ||
+            !mAutoDelete);
+}
+
+void Particle::setActiveArea(const int x, const int y, const int width,
+                             const int height)
+{
+    activeLeft = x - dormancyMargin;
+    activeTop = y - dormancyMargin;
+    activeRight = x + width + dormancyMargin;
+    activeBottom = y + height + dormancyMargin;
+}
+
+void Particle::clearActiveArea()
+{
+    activeLeft = 0;
+    activeTop = 0;
+    activeRight = -1;
+    activeBottom = -1;
+}
+
+bool Particle::isDormant() const
+{
+    if (activeRight < activeLeft)
+        return false;
+
+    // Particles are drawn higher up the further they are above the ground
+    const float screenY = mPos.y - mPos.z;
+
+    return mPos.x < activeLeft || mPos.x > activeRight ||
+           screenY < activeTop || screenY > activeBottom;
 }
 
 void Particle::moveBy(const Vector &change)
@@ -283,91 +354,26 @@ Particle* Particle::addEffect(const std::string &particleEffectFile,
 {
     Particle *newParticle = NULL;
 
-    const XML::Document doc(particleEffectFile);
-    const xmlNodePtr rootNode = doc.rootNode();
+    // The effect file is only parsed the first time it is used
+    ResourceManager *resman = ResourceManager::getInstance();
+    ParticleEffect *effect = resman->getParticleEffect(particleEffectFile,
+        mMap ? mMap->getTileWidth() : DEFAULT_TILE_WIDTH,
+        mMap ? mMap->getTileHeight() : DEFAULT_TILE_HEIGHT);
 
-    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "effect"))
-    {
-        logger->log("Error loading particle: %s", particleEffectFile.c_str());
+    if (!effect)
         return NULL;
-    }
 
-    ResourceManager *resman = ResourceManager::getInstance();
+    const Vector position(mPos.x + (float) pixelX, mPos.y + (float) pixelY,
+                          mPos.z);
 
-    // Parse particles
-    for_each_xml_child_node(effectChildNode, rootNode)
+    for (int i = 0; i < effect->getParticleCount(); i++)
     {
-        // We're only interested in particles
-        if (!xmlStrEqual(effectChildNode->name, BAD_CAST "particle"))
-            continue;
-
-        // Determine the exact particle type
-        xmlNodePtr node;
-
-        // Animation
-        if ((node = XML::findFirstChildByName(effectChildNode, "animation")))
-            newParticle = new AnimationParticle(mMap, node);
-
-        // Rotational
-        else if ((node = XML::findFirstChildByName(effectChildNode, "rotation")))
-            newParticle = new RotationalParticle(mMap, node);
-
-        // Image
-        else if ((node = XML::findFirstChildByName(effectChildNode, "image")))
-        {
-            Image *img= resman->getImage((const char*)
-                    node->xmlChildrenNode->content);
-
-            newParticle = new ImageParticle(mMap, img);
-        }
-        // Other
-        else
-            newParticle = new Particle(mMap);
-
-        // Read and set the basic properties of the particle
-        float offsetX = XML::getFloatProperty(effectChildNode, "position-x", 0);
-        float offsetY = XML::getFloatProperty(effectChildNode, "position-y", 0);
-        float offsetZ = XML::getFloatProperty(effectChildNode, "position-z", 0);
-        Vector position (mPos.x + (float) pixelX + offsetX,
-                         mPos.y + (float) pixelY + offsetY, mPos.z + offsetZ);
-        newParticle->moveTo(position);
-
-        int lifetime = XML::getProperty(effectChildNode, "lifetime", -1);
-        newParticle->setLifetime(lifetime);
-
-        // Look for additional emitters for this particle
-        for_each_xml_child_node(emitterNode, effectChildNode)
-        {
-            if (xmlStrEqual(emitterNode->name, BAD_CAST "emitter"))
-            {
-                ParticleEmitter *newEmitter;
-                newEmitter = new ParticleEmitter(emitterNode, newParticle, mMap,
-                                                 rotation);
-                newParticle->addEmitter(newEmitter);
-            }
-            else if (xmlStrEqual(emitterNode->name, BAD_CAST "deatheffect"))
-            {
-                std::string deathEffect = (const char*)emitterNode->xmlChildrenNode->content;
-                char deathEffectConditions = 0x00;
-
-                if (XML::getBoolProperty(emitterNode, "on-floor", true))
-                    deathEffectConditions += Particle::DEAD_FLOOR;
-                if (XML::getBoolProperty(emitterNode, "on-sky", true))
-                    deathEffectConditions += Particle::DEAD_SKY;
-                if (XML::getBoolProperty(emitterNode, "on-other", false))
-                    deathEffectConditions += Particle::DEAD_OTHER;
-                if (XML::getBoolProperty(emitterNode, "on-impact", true))
-                    deathEffectConditions += Particle::DEAD_IMPACT;
-                if (XML::getBoolProperty(emitterNode, "on-timeout", true))
-                    deathEffectConditions += Particle::DEAD_TIMEOUT;
-
-                newParticle->setDeathEffect(deathEffect, deathEffectConditions);
-            }
-        }
-
+        newParticle = effect->createParticle(i, mMap, position, rotation);
         mChildParticles.push_back(newParticle);
     }
 
+    effect->decRef();
+
     return newParticle;
 }
 
@@ -377,9 +383,9 @@ Particle *Particle::addTextSplashEffect(const std::string &text, const int x,
 {
     Particle *newParticle = new TextParticle(mMap, text, color, font, outline);
     newParticle->moveTo(x, y);
-    newParticle->setVelocity(((rand() % 100) - 50) / 200.0f,    // X
-                             ((rand() % 100) - 50) / 200.0f,    // Y
-                             ((rand() % 100) / 200.0f) + 4.0f); // Z
+    newParticle->setVelocity((random.nextInt(100) - 50) / 200.0f,    // X
+                             (random.nextInt(100) - 50) / 200.0f,    // Y
+                             (random.nextInt(100) / 200.0f) + 4.0f); // Z
     newParticle->setGravity(0.1f);
     newParticle->setBounce(0.5f);
     newParticle->setLifetime(200);
@@ -427,11 +433,15 @@ void Particle::setMap(Map *map)
     mMap = map;
 
     if (mMap)
-        setSpriteIterator(mMap->addSprite(this));
+        mMap->addSprite(this);
 }
 
 void Particle::clear()
 {
+    // Pooled particles refer to the emitters that spawned them
+    if (mPooledChildren && Particle::pool)
+        Particle::pool->remove(this);
+
     delete_all(mChildEmitters);
     mChildEmitters.clear();
 
@@ -28,6 +28,7 @@
 
 #include "../../map/sprite/sprite.h"
 
+#include "../../utils/random.h"
 #include "../../utils/vector.h"
 
 #include "../../../bindings/guichan/guichanfwd.h"
@@ -35,6 +36,7 @@
 class Map;
 class Particle;
 class ParticleEmitter;
+class ParticlePool;
 
 typedef std::list<Particle *> Particles;
 typedef Particles::iterator ParticleIterator;
@@ -66,6 +68,17 @@ class Particle : public Sprite
                                               emitter updates in ticks */
         static bool enabled;             /**< Whether unnecessary particle
                                               effects are enabled or not */
+        static ParticlePool *pool;       /**< Storage of the particles spawned
+                                              by emitters */
+        static int emitterThrottle;      /**< Factor the pause between two
+                                              emitter updates is stretched by
+                                              when particles run late */
+        static int dormancyMargin;       /**< Distance in pixels outside the
+                                              active area where emitters still
+                                              run */
+        static Random random;            /**< Random numbers of the particle
+                                              engine, seeded by the
+                                              particleSeed setting if set */
 
         /**
          * Constructor.
@@ -90,6 +103,30 @@ class Particle : public Sprite
          */
         void setupEngine();
 
+        /**
+         * Sets the area of the map in pixels where emitters run, which is
+         * usually the part of the map on screen. Emitters of particles
+         * further than the dormancy margin away from it sleep until the area
+         * gets close again. Their particles keep aging while they sleep, so
+         * time dependent emitter properties continue where they would have
+         * been when the emitters wake up.
+         */
+        static void setActiveArea(const int x, const int y, const int width,
+                                  const int height);
+
+        /**
+         * Forgets the active area, so that all emitters run until it is set
+         * again. Called when the map changes, as the area belongs to the
+         * previous map.
+         */
+        static void clearActiveArea();
+
+        /**
+         * Returns whether the emitters of the particle are asleep because it
+         * is too far away from the active area.
+         */
+        bool isDormant() const;
+
         /**
          * Updates particle position, returns false when the particle should
          * be deleted.
@@ -197,19 +234,6 @@ class Particle : public Sprite
         virtual void setDeathEffect(const std::string &effectFile, char conditions)
         { mDeathEffect = effectFile; mDeathEffectConditions = conditions; }
 
-        /**
-         * Sets the sprite iterator of the particle on the current map to make
-         * it easier to remove the particle from the map when it is destroyed.
-         */
-        void setSpriteIterator(std::list<Sprite*>::iterator spriteIterator)
-        { mSpriteIterator = spriteIterator; }
-
-        /**
-         * Gets the sprite iterator of the particle on the current map.
-         */
-        const std::list<Sprite*>::iterator &getSpriteIterator() const
-        { return mSpriteIterator; }
-
         /**
          * Sets the current velocity in 3 dimensional space.
          */
@@ -262,7 +286,8 @@ class Particle : public Sprite
         /**
          * Determines whether the particle and its children are all dead
          */
-        bool isExtinct() const { return !isAlive() && mChildParticles.empty(); }
+        bool isExtinct() const
+        { return !isAlive() && mChildParticles.empty() && !mPooledChildren; }
 
         /**
          * Manually marks the particle for deletion.
@@ -293,18 +318,19 @@ class Particle : public Sprite
         Vector mVelocity;           /**< Speed in pixels per game-tick. */
 
     private:
+        friend class ParticlePool;
+
         AliveStatus mAlive;         /**< Is the particle supposed to be drawn
                                          and updated?*/
         // generic properties
         bool mAutoDelete;           /**< May the particle request its deletion
                                          by the parent particle? */
         Map *mMap;                  /**< Map the particle is on. */
-        std::list<Sprite*>::iterator mSpriteIterator;
-                                    /**< iterator of the particle on the current
-                                         map */
         Emitters mChildEmitters;    /**< List of child emitters. */
         Particles mChildParticles;  /**< List of particles controlled by this
                                          particle */
+        int mPooledChildren;        /**< Number of particles in the pool spawned
+                                         by the emitters of this particle */
         std::string mDeathEffect;   /**< Particle effect file to be spawned when
                                          the particle dies */
         char mDeathEffectConditions;/**< Bitfield of death conditions which
@@ -0,0 +1,166 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "animationparticle.h"
+#include "imageparticle.h"
+#include "particle.h"
+#include "particleeffect.h"
+#include "rotationalparticle.h"
+
+#include "../animation.h"
+#include "../image.h"
+#include "../simpleanimation.h"
+
+#include "../../log.h"
+#include "../../resourcemanager.h"
+
+#include "../../utils/dtor.h"
+#include "../../utils/xml.h"
+
+ParticleEffect *ParticleEffect::load(const std::string &file,
+                                     const int tileWidth,
+                                     const int tileHeight)
+{
+    const XML::Document doc(file);
+    const xmlNodePtr rootNode = doc.rootNode();
+
+    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "effect"))
+    {
+        logger->log("Error loading particle: %s", file.c_str());
+        return NULL;
+    }
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    ParticleEffect *effect = new ParticleEffect();
+
+    // Parse particles
+    for_each_xml_child_node(effectChildNode, rootNode)
+    {
+        // We're only interested in particles
+        if (!xmlStrEqual(effectChildNode->name, BAD_CAST "particle"))
+            continue;
+
+        effect->mParticles.push_back(ParticleDef());
+        ParticleDef &def = effect->mParticles.back();
+        def.image = NULL;
+        def.animation = NULL;
+        def.rotational = false;
+        def.deathEffectConditions = 0x00;
+
+        // Determine the exact particle type
+        xmlNodePtr node;
+
+        // Animation
+        if ((node = XML::findFirstChildByName(effectChildNode, "animation")))
+            def.animation = SimpleAnimation::readAnimation(node);
+
+        // Rotational
+        else if ((node = XML::findFirstChildByName(effectChildNode, "rotation")))
+        {
+            def.animation = SimpleAnimation::readAnimation(node);
+            def.rotational = true;
+        }
+
+        // Image
+        else if ((node = XML::findFirstChildByName(effectChildNode, "image")))
+            def.image = resman->getImage((const char*)
+                    node->xmlChildrenNode->content);
+
+        // Read the basic properties of the particle
+        def.offset.x = XML::getFloatProperty(effectChildNode, "position-x", 0);
+        def.offset.y = XML::getFloatProperty(effectChildNode, "position-y", 0);
+        def.offset.z = XML::getFloatProperty(effectChildNode, "position-z", 0);
+        def.lifetime = XML::getProperty(effectChildNode, "lifetime", -1);
+
+        // Look for additional emitters for this particle
+        for_each_xml_child_node(emitterNode, effectChildNode)
+        {
+            if (xmlStrEqual(emitterNode->name, BAD_CAST "emitter"))
+            {
+                def.emitters.push_back(ParticleEmitter(emitterNode, tileWidth,
+                                                       tileHeight));
+            }
+            else if (xmlStrEqual(emitterNode->name, BAD_CAST "deatheffect"))
+            {
+                def.deathEffect = (const char*)emitterNode->xmlChildrenNode->content;
+                def.deathEffectConditions = 0x00;
+
+                if (XML::getBoolProperty(emitterNode, "on-floor", true))
+                    def.deathEffectConditions += Particle::DEAD_FLOOR;
+                if (XML::getBoolProperty(emitterNode, "on-sky", true))
+                    def.deathEffectConditions += Particle::DEAD_SKY;
+                if (XML::getBoolProperty(emitterNode, "on-other", false))
+                    def.deathEffectConditions += Particle::DEAD_OTHER;
+                if (XML::getBoolProperty(emitterNode, "on-impact", true))
+                    def.deathEffectConditions += Particle::DEAD_IMPACT;
+                if (XML::getBoolProperty(emitterNode, "on-timeout", true))
+                    def.deathEffectConditions += Particle::DEAD_TIMEOUT;
+            }
+        }
+    }
+
+    return effect;
+}
+
+ParticleEffect::~ParticleEffect()
+{
+    for (std::vector<ParticleDef>::iterator i = mParticles.begin();
+         i != mParticles.end(); i++)
+    {
+        if (i->image)
+            i->image->decRef();
+
+        destroy(i->animation);
+    }
+}
+
+Particle *ParticleEffect::createParticle(const int index, Map *map,
+                                         const Vector &position,
+                                         const int rotation) const
+{
+    const ParticleDef &def = mParticles[index];
+    Particle *newParticle;
+
+    if (def.animation && def.rotational)
+        newParticle = new RotationalParticle(map, new Animation(*def.animation));
+    else if (def.animation)
+        newParticle = new AnimationParticle(map, new Animation(*def.animation));
+    else if (def.image)
+        newParticle = new ImageParticle(map, def.image);
+    else
+        newParticle = new Particle(map);
+
+    newParticle->moveTo(position + def.offset);
+    newParticle->setLifetime(def.lifetime);
+
+    for (std::list<ParticleEmitter>::const_iterator i = def.emitters.begin();
+         i != def.emitters.end(); i++)
+    {
+        ParticleEmitter *newEmitter = new ParticleEmitter(*i);
+        newEmitter->setup(newParticle, map, rotation);
+        newParticle->addEmitter(newEmitter);
+    }
+
+    if (!def.deathEffect.empty())
+        newParticle->setDeathEffect(def.deathEffect, def.deathEffectConditions);
+
+    return newParticle;
+}
@@ -0,0 +1,100 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _PARTICLEEFFECT_H
+#define _PARTICLEEFFECT_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "particleemitter.h"
+
+#include "../../resource.h"
+
+#include "../../utils/vector.h"
+
+class Animation;
+class Image;
+class Map;
+class Particle;
+
+/**
+ * A parsed particle effect file. Effects are read once and kept by the
+ * resource manager, so that spawning an effect only needs to create the
+ * particles and copy their emitters.
+ */
+class ParticleEffect : public Resource
+{
+    public:
+        /**
+         * Loads a particle effect file. The tile size is needed to position
+         * the animation frames of the emitters.
+         */
+        static ParticleEffect *load(const std::string &file,
+                                    const int tileWidth,
+                                    const int tileHeight);
+
+        /**
+         * Returns the number of particles the effect consists of.
+         */
+        int getParticleCount() const { return mParticles.size(); }
+
+        /**
+         * Creates the particle with the given index on the given map, with
+         * its emitters rotated by the given number of degrees. The particle
+         * is placed at its offset from the given position.
+         */
+        Particle *createParticle(const int index, Map *map,
+                                 const Vector &position,
+                                 const int rotation) const;
+
+    private:
+        /**
+         * The definition of a single particle of the effect.
+         */
+        struct ParticleDef
+        {
+            Image *image;           /**< Image, if used */
+            Animation *animation;   /**< Animation, if used */
+            bool rotational;        /**< Whether the animation frame follows
+                                         the direction of the particle */
+            Vector offset;          /**< Offset from the effect position */
+            int lifetime;
+            std::list<ParticleEmitter> emitters;
+            std::string deathEffect;
+            char deathEffectConditions;
+        };
+
+        /**
+         * Constructor.
+         */
+        ParticleEffect() {}
+
+        /**
+         * Destructor.
+         */
+        ~ParticleEffect();
+
+        std::vector<ParticleDef> mParticles;
+};
+
+#endif
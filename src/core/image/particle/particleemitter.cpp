@@ -26,6 +26,7 @@
 #include "imageparticle.h"
 #include "particle.h"
 #include "particleemitter.h"
+#include "particlepool.h"
 #include "rotationalparticle.h"
 
 #include "../image.h"
@@ -34,21 +35,20 @@
 #include "../../log.h"
 #include "../../resourcemanager.h"
 
-#include "../../map/map.h"
-
 #include "../../utils/stringutils.h"
 
 #define SIN45 0.707106781f
 #define DEG_RAD_FACTOR 0.017453293f
 
-ParticleEmitter::ParticleEmitter(const xmlNodePtr &emitterNode, Particle *target,
-                                 Map *map, const int rotation):
+ParticleEmitter::ParticleEmitter(const xmlNodePtr &emitterNode,
+                                 const int tileWidth, const int tileHeight):
+    mRotatable(false),
+    mParticleTarget(NULL),
+    mMap(NULL),
     mOutputPauseLeft(0),
-    mParticleImage(0)
+    mParticleImage(0),
+    mDeathEffectConditions(0x00)
 {
-    mMap = map;
-    mParticleTarget = target;
-
     // Initializing default values
     mParticlePosX.set(0.0f);
     mParticlePosY.set(0.0f);
@@ -106,11 +106,10 @@ ParticleEmitter::ParticleEmitter(const xmlNodePtr &emitterNode, Particle *target
             else if (name == "horizontal-angle")
             {
                 mParticleAngleHorizontal = readParticleEmitterProp(propertyNode, 0.0f);
-                mParticleAngleHorizontal.minVal += rotation;
                 mParticleAngleHorizontal.minVal *= DEG_RAD_FACTOR;
-                mParticleAngleHorizontal.maxVal += rotation;
                 mParticleAngleHorizontal.maxVal *= DEG_RAD_FACTOR;
                 mParticleAngleHorizontal.changeAmplitude *= DEG_RAD_FACTOR;
+                mRotatable = true;
             }
             else if (name == "vertical-angle")
             {
@@ -138,10 +137,7 @@ ParticleEmitter::ParticleEmitter(const xmlNodePtr &emitterNode, Particle *target
                 mOutput.maxVal +=1;
             }
             else if (name == "output-pause")
-            {
                 mOutputPause = readParticleEmitterProp(propertyNode, 0);
-                mOutputPauseLeft = mOutputPause.value(0);
-            }
             else if (name == "acceleration")
                 mParticleAcceleration = readParticleEmitterProp(propertyNode, 0.0f);
             else if (name == "die-distance")
@@ -164,7 +160,7 @@ ParticleEmitter::ParticleEmitter(const xmlNodePtr &emitterNode, Particle *target
         }
         else if (xmlStrEqual(propertyNode->name, BAD_CAST "emitter"))
         {
-            ParticleEmitter newEmitter(propertyNode, mParticleTarget, map);
+            ParticleEmitter newEmitter(propertyNode, tileWidth, tileHeight);
             mParticleChildEmitters.push_back(newEmitter);
         }
         else if (xmlStrEqual(propertyNode->name, BAD_CAST "rotation"))
@@ -180,8 +176,8 @@ ParticleEmitter::ParticleEmitter(const xmlNodePtr &emitterNode, Particle *target
                 int delay = XML::getProperty(frameNode, "delay", 0);
                 int offsetX = XML::getProperty(frameNode, "offsetX", 0);
                 int offsetY = XML::getProperty(frameNode, "offsetY", 0);
-                offsetY -= imageset->getHeight() - mMap->getTileHeight();
-                offsetX -= (imageset->getWidth() - mMap->getTileWidth()) / 2;
+                offsetY -= imageset->getHeight() - tileHeight;
+                offsetX -= (imageset->getWidth() - tileWidth) / 2;
 
                 if (xmlStrEqual(frameNode->name, BAD_CAST "frame"))
                 {
@@ -251,8 +247,8 @@ ParticleEmitter::ParticleEmitter(const xmlNodePtr &emitterNode, Particle *target
                 int delay = XML::getProperty(frameNode, "delay", 0);
                 int offsetX = XML::getProperty(frameNode, "offsetX", 0);
                 int offsetY = XML::getProperty(frameNode, "offsetY", 0);
-                offsetY -= imageset->getHeight() - mMap->getTileHeight();
-                offsetX -= (imageset->getWidth() - mMap->getTileWidth()) / 2;
+                offsetY -= imageset->getHeight() - tileHeight;
+                offsetX -= (imageset->getWidth() - tileWidth) / 2;
 
                 if (xmlStrEqual(frameNode->name, BAD_CAST "frame"))
                 {
@@ -335,6 +331,7 @@ ParticleEmitter & ParticleEmitter::operator=(const ParticleEmitter &o)
     mParticlePosZ = o.mParticlePosZ;
     mParticleAngleHorizontal = o.mParticleAngleHorizontal;
     mParticleAngleVertical = o.mParticleAngleVertical;
+    mRotatable = o.mRotatable;
     mParticlePower = o.mParticlePower;
     mParticleGravity = o.mParticleGravity;
     mParticleRandomness = o.mParticleRandomness;
@@ -355,6 +352,8 @@ ParticleEmitter & ParticleEmitter::operator=(const ParticleEmitter &o)
     mParticleAnimation = o.mParticleAnimation;
     mParticleRotation = o.mParticleRotation;
     mParticleChildEmitters = o.mParticleChildEmitters;
+    mDeathEffect = o.mDeathEffect;
+    mDeathEffectConditions = o.mDeathEffectConditions;
 
     mOutputPauseLeft = 0;
 
@@ -368,6 +367,25 @@ ParticleEmitter::~ParticleEmitter()
     if (mParticleImage) mParticleImage->decRef();
 }
 
+void ParticleEmitter::setup(Particle *target, Map *map, const int rotation)
+{
+    mParticleTarget = target;
+    mMap = map;
+    mOutputPauseLeft = mOutputPause.value(0);
+
+    if (mRotatable)
+    {
+        mParticleAngleHorizontal.minVal += rotation * DEG_RAD_FACTOR;
+        mParticleAngleHorizontal.maxVal += rotation * DEG_RAD_FACTOR;
+    }
+
+    for (std::list<ParticleEmitter>::iterator i = mParticleChildEmitters.begin();
+         i != mParticleChildEmitters.end(); i++)
+    {
+        i->setup(target, map);
+    }
+}
+
 template <typename T> ParticleEmitterProp<T>
 ParticleEmitter::readParticleEmitterProp(xmlNodePtr propertyNode, T def)
 {
@@ -394,7 +412,8 @@ ParticleEmitter::readParticleEmitterProp(xmlNodePtr propertyNode, T def)
     return retval;
 }
 
-std::list<Particle *> ParticleEmitter::createParticles(const int tick)
+std::list<Particle *> ParticleEmitter::createParticles(const int tick,
+                                                      Particle *parent)
 {
     std::list<Particle *> newParticles;
 
@@ -405,11 +424,62 @@ std::list<Particle *> ParticleEmitter::createParticles(const int tick)
     }
     mOutputPauseLeft = mOutputPause.value(tick);
 
+    // Particles with emitters of their own have to be objects
+    const bool pooled = Particle::pool && mMap &&
+                        mParticleChildEmitters.empty();
+
     for (int i = mOutput.value(tick); i > 0; i--)
     {
         // Limit maximum particles
         if (Particle::particleCount > Particle::maxCount) break;
 
+        if (pooled)
+        {
+            ParticlePool::Properties properties;
+            properties.image = mParticleImage;
+            properties.animation = NULL;
+            properties.rotational = false;
+            if (!mParticleImage && mParticleRotation.getLength() > 0)
+            {
+                properties.animation = &mParticleRotation;
+                properties.rotational = true;
+            }
+            else if (!mParticleImage && mParticleAnimation.getLength() > 0)
+                properties.animation = &mParticleAnimation;
+
+            properties.position = Vector(mParticlePosX.value(tick),
+                                         mParticlePosY.value(tick),
+                                         mParticlePosZ.value(tick));
+
+            float angleH = mParticleAngleHorizontal.value(tick);
+            float angleV = mParticleAngleVertical.value(tick);
+            float power = mParticlePower.value(tick);
+            properties.velocity = Vector(cos(angleH) * cos(angleV) * power,
+                                         sin(angleH) * cos(angleV) * power,
+                                         sin(angleV) * power);
+
+            properties.randomness = mParticleRandomness.value(tick);
+            properties.gravity = mParticleGravity.value(tick);
+            properties.bounce = mParticleBounce.value(tick);
+            properties.follow = mParticleFollow;
+
+            properties.target = mParticleTarget;
+            properties.acceleration = mParticleAcceleration.value(tick);
+            properties.momentum = mParticleMomentum.value(tick);
+            properties.dieDistance = mParticleDieDistance.value(tick);
+
+            properties.lifetime = mParticleLifetime.value(tick);
+            properties.fadeOut = mParticleFadeOut.value(tick);
+            properties.fadeIn = mParticleFadeIn.value(tick);
+            properties.alpha = mParticleAlpha.value(tick);
+
+            properties.deathEffect = &mDeathEffect;
+            properties.deathEffectConditions = mDeathEffectConditions;
+
+            Particle::pool->add(parent, properties);
+            continue;
+        }
+
         Particle *newParticle;
         if (mParticleImage)
             newParticle = new ImageParticle(mMap, mParticleImage);
@@ -43,10 +43,12 @@ class ParticleEmitter
 {
     public:
         /**
-         * Constructor.
+         * Constructor. Emitters are read once per particle effect, and then
+         * copied for every particle using them. The tile size is needed to
+         * position animation frames.
          */
-        ParticleEmitter(const xmlNodePtr &emitterNode,  Particle *target,
-                        Map *map, const int rotation = 0);
+        ParticleEmitter(const xmlNodePtr &emitterNode, const int tileWidth,
+                        const int tileHeight);
 
         /**
          * Copy Constructor (necessary for reference counting of particle images)
@@ -64,16 +66,28 @@ class ParticleEmitter
         ~ParticleEmitter();
 
         /**
-         * Spawns new particles
-         * @return: a list of created particles
+         * Spawns new particles for the given parent particle. Particles
+         * without emitters of their own are added to the particle pool, only
+         * the others are created as objects.
+         * @return: a list of created particle objects
          */
-        std::list<Particle *> createParticles(const int tick);
+        std::list<Particle *> createParticles(const int tick,
+                                              Particle *parent);
 
         /**
          * Sets the target of the particles that are created
          */
         void setTarget(Particle *target) { mParticleTarget = target; };
 
+        /**
+         * Prepares a copy of an emitter read from a particle effect for use.
+         * Sets the target of the particles that are created, by this emitter
+         * and its child emitters, and the map they are created on. The
+         * horizontal angle of the created particles is rotated by the given
+         * number of degrees.
+         */
+        void setup(Particle *target, Map *map, const int rotation = 0);
+
     private:
         template <typename T>
         ParticleEmitterProp<T> readParticleEmitterProp(xmlNodePtr propertyNode, T def);
@@ -87,6 +101,7 @@ class ParticleEmitter
          * initial vector of particles:
          */
         ParticleEmitterProp<float> mParticleAngleHorizontal, mParticleAngleVertical;
+        bool mRotatable;        /**< Whether the horizontal angle was given */
 
         /**
          * Initial velocity of particles
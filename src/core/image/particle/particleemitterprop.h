@@ -22,6 +22,8 @@
 
 #include <cmath>
 
+#include "particle.h"
+
 enum ChangeFunc
 {
     FUNC_NONE,
@@ -60,7 +62,8 @@ template <typename T> struct ParticleEmitterProp
     T value(int tick)
     {
         tick += changePhase;
-        T val = (T) (minVal + (maxVal - minVal) * (rand() / ((double) RAND_MAX + 1)));
+        T val = (T) (minVal + (maxVal - minVal) *
+                     Particle::random.nextDouble());
 
         switch (changeFunc)
         {
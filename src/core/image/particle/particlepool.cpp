@@ -0,0 +1,521 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cmath>
+
+#include "particle.h"
+#include "particlepool.h"
+
+#include "../animation.h"
+#include "../image.h"
+
+#include "../../map/map.h"
+
+#include "../../map/sprite/sprite.h"
+
+#include "../../utils/fastsqrt.h"
+#include "../../utils/jobsystem.h"
+#include "../../utils/profiler.h"
+
+#include "../../../bindings/guichan/graphics.h"
+
+#define SIN45 0.707106781f
+#define PI 3.14159265
+
+/** Number of slots the pool starts out with */
+const int INITIAL_CAPACITY = 256;
+
+/** Number of particles updated by one job */
+const int JOB_SIZE = 1024;
+
+/**
+ * The sprite a pooled particle is sorted and drawn on the map as. The pool
+ * keeps one for every slot, and moves it along with the particle when the
+ * particle changes slots.
+ */
+class PooledParticle : public Sprite
+{
+    public:
+        PooledParticle(const ParticlePool *pool, const int slot):
+            mPool(pool),
+            mSlot(slot)
+        {}
+
+        void draw(Graphics *graphics, const int offsetX,
+                  const int offsetY) const
+        { mPool->draw(mSlot, graphics, offsetX, offsetY); }
+
+        const int getPixelY() const { return mPool->getPixelY(mSlot); }
+
+        const ParticlePool *mPool;
+        int mSlot;
+};
+
+ParticlePool::ParticlePool(JobSystem *jobs):
+    mCount(0),
+    mCapacity(0),
+    mSeed(0),
+    mJobs(jobs)
+{
+    reserve(INITIAL_CAPACITY);
+}
+
+ParticlePool::~ParticlePool()
+{
+    // Owners free their particles when they die, so normally none are left
+    for (int i = 0; i < mCount; i++)
+    {
+        if (mMap[i])
+            mMap[i]->removeSprite(mSprites[i]);
+        if (mImage[i])
+            mImage[i]->decRef();
+    }
+
+    for (int i = 0; i < mCapacity; i++)
+        delete mSprites[i];
+}
+
+void ParticlePool::reserve(const int capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+
+    mPosX.resize(capacity); mPosY.resize(capacity); mPosZ.resize(capacity);
+    mVelX.resize(capacity); mVelY.resize(capacity); mVelZ.resize(capacity);
+    mBaseX.resize(capacity); mBaseY.resize(capacity); mBaseZ.resize(capacity);
+    mGravity.resize(capacity);
+    mBounce.resize(capacity);
+    mMomentum.resize(capacity);
+    mRandomness.resize(capacity);
+    mFollow.resize(capacity);
+    mTarget.resize(capacity);
+    mAcceleration.resize(capacity);
+    mInvDieDistance.resize(capacity);
+    mLifetimeLeft.resize(capacity);
+    mLifetimePast.resize(capacity);
+    mFadeOut.resize(capacity);
+    mFadeIn.resize(capacity);
+    mAlpha.resize(capacity);
+    mImage.resize(capacity);
+    mAnimation.resize(capacity);
+    mRotational.resize(capacity);
+    mAnimationTime.resize(capacity);
+    mAnimationPhase.resize(capacity);
+    mOwner.resize(capacity);
+    mMap.resize(capacity);
+    mStatus.resize(capacity);
+    mDeathEffect.resize(capacity);
+    mDeathEffectConditions.resize(capacity);
+
+    mSprites.resize(capacity);
+    for (int i = mCapacity; i < capacity; i++)
+        mSprites[i] = new PooledParticle(this, i);
+
+    mCapacity = capacity;
+}
+
+void ParticlePool::add(Particle *owner, const Properties &properties)
+{
+    if (mCount == mCapacity)
+        reserve(mCapacity * 2);
+
+    const int i = mCount++;
+
+    mPosX[i] = properties.position.x;
+    mPosY[i] = properties.position.y;
+    mPosZ[i] = properties.position.z;
+    mVelX[i] = properties.velocity.x;
+    mVelY[i] = properties.velocity.y;
+    mVelZ[i] = properties.velocity.z;
+    mGravity[i] = properties.gravity;
+    mBounce[i] = properties.bounce;
+    mMomentum[i] = properties.momentum;
+    mRandomness[i] = properties.randomness;
+    mFollow[i] = properties.follow;
+    mTarget[i] = properties.target;
+    mAcceleration[i] = properties.acceleration;
+    mInvDieDistance[i] = 1.0f / properties.dieDistance;
+    mLifetimeLeft[i] = properties.lifetime;
+    mLifetimePast[i] = 0;
+    mFadeOut[i] = properties.fadeOut;
+    mFadeIn[i] = properties.fadeIn;
+    mAlpha[i] = properties.alpha;
+    mImage[i] = properties.image;
+    mAnimation[i] = properties.animation;
+    mRotational[i] = properties.rotational;
+    mAnimationTime[i] = 0;
+    mAnimationPhase[i] = 0;
+    mOwner[i] = owner;
+    mMap[i] = owner->mMap;
+    mDeathEffect[i] = properties.deathEffect;
+    mDeathEffectConditions[i] = properties.deathEffectConditions;
+
+    if (mImage[i])
+        mImage[i]->incRef();
+
+    // Positions of followers stay relative to the owner
+    if (!mFollow[i])
+    {
+        const Vector &base = owner->getPosition();
+        mPosX[i] += base.x;
+        mPosY[i] += base.y;
+        mPosZ[i] += base.z;
+    }
+
+    owner->mPooledChildren++;
+    Particle::particleCount++;
+
+    if (mMap[i])
+        mMap[i]->addSprite(mSprites[i]);
+}
+
+void ParticlePool::remove(Particle *owner)
+{
+    for (int i = mCount - 1; i >= 0 && owner->mPooledChildren > 0; i--)
+    {
+        if (mOwner[i] == owner)
+            release(i);
+    }
+}
+
+void ParticlePool::update()
+{
+    ProfileScope scope("ParticlePool::update");
+
+    // Particles whose lifetime ran out die before they move. Slots are walked
+    // backwards so that the particle moved into a freed slot was seen already.
+    for (int i = mCount - 1; i >= 0; i--)
+    {
+        if (mLifetimeLeft[i] == 0)
+            kill(i, Particle::DEAD_TIMEOUT);
+    }
+
+    if (mCount == 0)
+        return;
+
+    // Every job gets random numbers of its own, which keeps the results the
+    // same no matter how many threads run them
+    mSeed = Particle::random.next();
+    mJobs->parallelFor(simulateJob, this, mCount, JOB_SIZE);
+
+    // Spawning death effects and freeing slots changes shared state, so the
+    // particles which died are handled afterwards on this thread
+    const int *status = &mStatus[0];
+    for (int i = mCount - 1; i >= 0; i--)
+    {
+        if (status[i] != Particle::ALIVE)
+            kill(i, status[i]);
+    }
+}
+
+void ParticlePool::simulateJob(void *pool, const int begin, const int end,
+                               const int)
+{
+    static_cast<ParticlePool*>(pool)->simulate(begin, end);
+}
+
+void ParticlePool::simulate(const int begin, const int end)
+{
+    Random random(mSeed + begin * 2654435761U);
+
+    float *posX = &mPosX[0], *posY = &mPosY[0], *posZ = &mPosZ[0];
+    float *velX = &mVelX[0], *velY = &mVelY[0], *velZ = &mVelZ[0];
+    float *baseX = &mBaseX[0], *baseY = &mBaseY[0], *baseZ = &mBaseZ[0];
+    const float *gravity = &mGravity[0];
+    const float *momentum = &mMomentum[0];
+    int *lifetimeLeft = &mLifetimeLeft[0];
+    int *lifetimePast = &mLifetimePast[0];
+    int *status = &mStatus[0];
+
+    for (int i = begin; i < end; i++)
+    {
+        if (mFollow[i])
+        {
+            const Vector &base = mOwner[i]->getPosition();
+            baseX[i] = base.x;
+            baseY[i] = base.y;
+            baseZ[i] = base.z;
+        }
+        else
+        {
+            baseX[i] = baseY[i] = baseZ[i] = 0.0f;
+        }
+        status[i] = Particle::ALIVE;
+    }
+
+    for (int i = begin; i < end; i++)
+    {
+        velX[i] *= momentum[i];
+        velY[i] *= momentum[i];
+        velZ[i] *= momentum[i];
+    }
+
+    // Attraction towards targets and random movement
+    for (int i = begin; i < end; i++)
+    {
+        const Particle *target = mTarget[i];
+
+        if (target && mAcceleration[i] != 0.0f)
+        {
+            const Vector &targetPos = target->getPosition();
+            const float distX = (baseX[i] + posX[i] - targetPos.x) * SIN45;
+            const float distY = baseY[i] + posY[i] - targetPos.y;
+            const float distZ = baseZ[i] + posZ[i] - targetPos.z;
+            float invHypotenuse;
+
+            switch (Particle::fastPhysics)
+            {
+                case 1:
+                    invHypotenuse = fastInvSqrt(distX * distX + distY *
+                                                distY + distZ * distZ);
+                    break;
+                case 2:
+                    invHypotenuse = 2.0f / fabs(distX) + fabs(distY) +
+                                    fabs(distZ);
+                    break;
+                default:
+                    invHypotenuse = 1.0f / sqrt(distX * distX + distY *
+                                    distY + distZ * distZ);
+                    break;
+            }
+
+            if (invHypotenuse)
+            {
+                if (mInvDieDistance[i] > 0.0f &&
+                    invHypotenuse > mInvDieDistance[i])
+                {
+                    status[i] = Particle::DEAD_IMPACT;
+                }
+
+                const float accFactor = invHypotenuse * mAcceleration[i];
+                velX[i] -= distX * accFactor;
+                velY[i] -= distY * accFactor;
+                velZ[i] -= distZ * accFactor;
+            }
+        }
+
+        const int randomness = mRandomness[i];
+        if (randomness > 0)
+        {
+            velX[i] += (random.nextInt(randomness) -
+                        random.nextInt(randomness)) / 1000.0f;
+            velY[i] += (random.nextInt(randomness) -
+                        random.nextInt(randomness)) / 1000.0f;
+            velZ[i] += (random.nextInt(randomness) -
+                        random.nextInt(randomness)) / 1000.0f;
+        }
+    }
+
+    for (int i = begin; i < end; i++)
+    {
+        velZ[i] -= gravity[i];
+
+        posX[i] += velX[i];
+        posY[i] += velY[i] * SIN45;
+        posZ[i] += velZ[i] * SIN45;
+
+        lifetimeLeft[i] -= lifetimeLeft[i] > 0;
+        lifetimePast[i]++;
+    }
+
+    // Hitting the floor or the sky, and animation of the survivors
+    for (int i = begin; i < end; i++)
+    {
+        float z = baseZ[i] + posZ[i];
+
+        if (z < 0.0f)
+        {
+            const float bounce = mBounce[i];
+
+            if (bounce > 0.0f)
+            {
+                z *= -bounce;
+                posZ[i] = z - baseZ[i];
+                velX[i] *= bounce;
+                velY[i] *= bounce;
+                velZ[i] *= -bounce;
+            }
+            else
+            {
+                status[i] = Particle::DEAD_FLOOR;
+            }
+        }
+        else if (z > Particle::PARTICLE_SKY)
+        {
+            status[i] = Particle::DEAD_SKY;
+        }
+
+        if (status[i] != Particle::ALIVE)
+            continue;
+
+        Animation *animation = mAnimation[i];
+        if (!animation || mRotational[i])
+            continue;
+
+        // The particle engine is updated every 10ms
+        unsigned int &time = mAnimationTime[i];
+        unsigned int &phase = mAnimationPhase[i];
+        Frame *frame = animation->getFrame(phase);
+
+        time += 10;
+        while (time > frame->delay && frame->delay > 0)
+        {
+            time -= frame->delay;
+            phase++;
+
+            if (phase >= animation->getLength())
+                phase = 0;
+
+            frame = animation->getFrame(phase);
+        }
+    }
+}
+
+void ParticlePool::kill(const int slot, const int status)
+{
+    if ((status & mDeathEffectConditions[slot]) > 0x00 &&
+        mDeathEffect[slot] && !mDeathEffect[slot]->empty())
+    {
+        Particle *deathEffect =
+            particleEngine->addEffect(*mDeathEffect[slot], 0, 0);
+        if (deathEffect)
+            deathEffect->moveBy(getPosition(slot));
+    }
+
+    release(slot);
+}
+
+void ParticlePool::release(const int slot)
+{
+    if (mMap[slot])
+        mMap[slot]->removeSprite(mSprites[slot]);
+    if (mImage[slot])
+        mImage[slot]->decRef();
+
+    mOwner[slot]->mPooledChildren--;
+    Particle::particleCount--;
+
+    const int last = --mCount;
+    if (slot == last)
+        return;
+
+    mPosX[slot] = mPosX[last];
+    mPosY[slot] = mPosY[last];
+    mPosZ[slot] = mPosZ[last];
+    mVelX[slot] = mVelX[last];
+    mVelY[slot] = mVelY[last];
+    mVelZ[slot] = mVelZ[last];
+    mGravity[slot] = mGravity[last];
+    mBounce[slot] = mBounce[last];
+    mMomentum[slot] = mMomentum[last];
+    mRandomness[slot] = mRandomness[last];
+    mFollow[slot] = mFollow[last];
+    mTarget[slot] = mTarget[last];
+    mAcceleration[slot] = mAcceleration[last];
+    mInvDieDistance[slot] = mInvDieDistance[last];
+    mLifetimeLeft[slot] = mLifetimeLeft[last];
+    mLifetimePast[slot] = mLifetimePast[last];
+    mFadeOut[slot] = mFadeOut[last];
+    mFadeIn[slot] = mFadeIn[last];
+    mAlpha[slot] = mAlpha[last];
+    mImage[slot] = mImage[last];
+    mAnimation[slot] = mAnimation[last];
+    mRotational[slot] = mRotational[last];
+    mAnimationTime[slot] = mAnimationTime[last];
+    mAnimationPhase[slot] = mAnimationPhase[last];
+    mOwner[slot] = mOwner[last];
+    mMap[slot] = mMap[last];
+    mDeathEffect[slot] = mDeathEffect[last];
+    mDeathEffectConditions[slot] = mDeathEffectConditions[last];
+
+    // The sprite goes along, so the map's sprite order stays valid
+    PooledParticle *sprite = mSprites[slot];
+    mSprites[slot] = mSprites[last];
+    mSprites[last] = sprite;
+    mSprites[slot]->mSlot = slot;
+    mSprites[last]->mSlot = last;
+}
+
+Vector ParticlePool::getPosition(const int slot) const
+{
+    Vector position(mPosX[slot], mPosY[slot], mPosZ[slot]);
+
+    if (mFollow[slot])
+        position += mOwner[slot]->getPosition();
+
+    return position;
+}
+
+int ParticlePool::getPixelY(const int slot) const
+{
+    const Vector position = getPosition(slot);
+    return (int) (position.y + position.z) - 64;
+}
+
+void ParticlePool::draw(const int slot, Graphics *graphics,
+                        const int offsetX, const int offsetY) const
+{
+    Image *image = mImage[slot];
+    Animation *animation = mAnimation[slot];
+
+    if (animation && mRotational[slot])
+    {
+        // Pick the frame facing the direction the particle moves in
+        float rad = atan2(mVelX[slot], mVelY[slot]);
+        if (rad < 0)
+            rad = PI + (PI + rad);
+        const int size = animation->getLength();
+        const float range = PI / size;
+
+        image = animation->getFrame((int) ((rad + range) / (2 * range)) %
+                                    size)->image;
+    }
+    else if (animation)
+    {
+        image = animation->getFrame(mAnimationPhase[slot])->image;
+    }
+
+    if (!image)
+        return;
+
+    const Vector position = getPosition(slot);
+    const int screenX = (int) position.x + offsetX - image->getWidth() / 2;
+    const int screenY = (int) position.y - (int) position.z + offsetY -
+                         image->getHeight() / 2;
+
+    // Check if on screen
+    if (screenX + image->getWidth() < 0 || screenX > graphics->getWidth() ||
+        screenY + image->getHeight() < 0 || screenY > graphics->getHeight())
+    {
+        return;
+    }
+
+    float alpha = mAlpha[slot];
+
+    if (mLifetimeLeft[slot] > -1 && mLifetimeLeft[slot] < mFadeOut[slot])
+        alpha *= (float) mLifetimeLeft[slot] / (float) mFadeOut[slot];
+
+    if (mLifetimePast[slot] < mFadeIn[slot])
+        alpha *= (float) mLifetimePast[slot] / (float) mFadeIn[slot];
+
+    image->setAlpha(alpha);
+    graphics->drawImage(image, screenX, screenY);
+}
@@ -0,0 +1,195 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _PARTICLEPOOL_H
+#define _PARTICLEPOOL_H
+
+#include <string>
+#include <vector>
+
+#include "../../utils/vector.h"
+
+class Animation;
+class Graphics;
+class Image;
+class JobSystem;
+class Map;
+class Particle;
+class PooledParticle;
+
+/**
+ * Storage for the particles spawned by emitters. Instead of being objects of
+ * their own, these particles are slots in a pool, which keeps each of their
+ * properties in an array of its own. Active particles are kept at the front
+ * of the arrays, so they can be updated in a few tight loops, and slots of
+ * dead particles are reused instead of being freed.
+ *
+ * Every particle belongs to the particle owning the emitter that spawned it,
+ * which stays alive as long as it has particles in the pool. Particles which
+ * follow their owner store their position relative to it.
+ */
+class ParticlePool
+{
+    public:
+        /**
+         * The initial properties of a new particle.
+         */
+        struct Properties
+        {
+            Vector position;        /**< Relative to the owner */
+            Vector velocity;
+            float gravity;
+            int randomness;
+            float bounce;
+            bool follow;
+            Particle *target;
+            float acceleration;
+            float momentum;
+            float dieDistance;
+            int lifetime;
+            int fadeOut;
+            int fadeIn;
+            float alpha;
+            Image *image;
+            Animation *animation;   /**< Must outlive the particle */
+            bool rotational;
+            const std::string *deathEffect; /**< Must outlive the particle */
+            char deathEffectConditions;
+        };
+
+        /**
+         * Constructor, taking the job system updating the particles, which
+         * has to outlive the pool.
+         */
+        ParticlePool(JobSystem *jobs);
+
+        /**
+         * Destructor.
+         */
+        ~ParticlePool();
+
+        /**
+         * Adds a particle spawned by an emitter of the given owner, on the
+         * map of the owner.
+         */
+        void add(Particle *owner, const Properties &properties);
+
+        /**
+         * Removes all particles of the given owner.
+         */
+        void remove(Particle *owner);
+
+        /**
+         * Updates all particles, spawning death effects and freeing the
+         * slots of particles which died. The particles are moved by jobs
+         * running in parallel, which only touch the slots they were given.
+         * The particles which died are handled afterwards.
+         */
+        void update();
+
+        /**
+         * Returns the number of active particles.
+         */
+        int getCount() const { return mCount; }
+
+    private:
+        friend class PooledParticle;
+
+        ParticlePool(const ParticlePool&);  // prevent copying
+        ParticlePool& operator=(const ParticlePool&);
+
+        /**
+         * Makes room for at least the given number of particles.
+         */
+        void reserve(const int capacity);
+
+        static void simulateJob(void *pool, const int begin, const int end,
+                                const int worker);
+
+        /**
+         * Moves the particles in the given range of slots, and marks those
+         * which died in their status.
+         */
+        void simulate(const int begin, const int end);
+
+        /**
+         * Spawns the death effect of the particle in the given slot when it
+         * died in one of its death effect conditions, and frees the slot.
+         */
+        void kill(const int slot, const int status);
+
+        /**
+         * Frees the given slot by moving the last active particle into it.
+         */
+        void release(const int slot);
+
+        Vector getPosition(const int slot) const;
+
+        void draw(const int slot, Graphics *graphics, const int offsetX,
+                  const int offsetY) const;
+
+        int getPixelY(const int slot) const;
+
+        int mCount;             /**< Number of active particles */
+        int mCapacity;
+        unsigned int mSeed;     /**< Random seed of the current update */
+        JobSystem *mJobs;
+
+        // Kinematics
+        std::vector<float> mPosX, mPosY, mPosZ;
+        std::vector<float> mVelX, mVelY, mVelZ;
+        std::vector<float> mBaseX, mBaseY, mBaseZ;  /**< Owner position for
+                                                         followers this tick */
+        std::vector<float> mGravity;
+        std::vector<float> mBounce;
+        std::vector<float> mMomentum;
+        std::vector<int> mRandomness;
+        std::vector<char> mFollow;
+
+        // Targeting
+        std::vector<Particle*> mTarget;
+        std::vector<float> mAcceleration;
+        std::vector<float> mInvDieDistance;
+
+        // Lifetime and appearance
+        std::vector<int> mLifetimeLeft;
+        std::vector<int> mLifetimePast;
+        std::vector<int> mFadeOut;
+        std::vector<int> mFadeIn;
+        std::vector<float> mAlpha;
+        std::vector<Image*> mImage;
+        std::vector<Animation*> mAnimation;
+        std::vector<char> mRotational;
+        std::vector<unsigned int> mAnimationTime;
+        std::vector<unsigned int> mAnimationPhase;
+
+        // Ownership and death
+        std::vector<Particle*> mOwner;
+        std::vector<Map*> mMap;
+        std::vector<int> mStatus;
+        std::vector<const std::string*> mDeathEffect;
+        std::vector<char> mDeathEffectConditions;
+
+        /** Sprites drawing the particles, one per slot and never freed */
+        std::vector<PooledParticle*> mSprites;
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <SDL.h>
+
+#include "particle.h"
+#include "particlescheduler.h"
+
+#include "../../configuration.h"
+
+#include "../../utils/profiler.h"
+
+/** Highest factor the emitter updates are spread out by */
+const int MAX_THROTTLE = 8;
+
+/** Frames in a row within half the budget before the throttle is eased */
+const int CALM_FRAMES = 50;
+
+ParticleScheduler::ParticleScheduler(Particle *engine):
+    mEngine(engine),
+    mBudget(config.getValue("particleFrameBudget", 8)),
+    mDroppedTicks(0),
+    mCalmFrames(0)
+{
+    Particle::emitterThrottle = 1;
+}
+
+void ParticleScheduler::update(const int ticks)
+{
+    ProfileScope scope("Particle::update");
+
+    const Uint32 start = SDL_GetTicks();
+    int done = 0;
+
+    // The budget is checked after each tick, so at least one due tick runs
+    // and the particles never stand still
+    while (done < ticks)
+    {
+        mEngine->update();
+        done++;
+
+        if (mBudget > 0 && (int) (SDL_GetTicks() - start) >= mBudget)
+            break;
+    }
+
+    const int spent = SDL_GetTicks() - start;
+    mDroppedTicks = ticks - done;
+
+    if (mDroppedTicks > 0)
+    {
+        // Halve the emission rate each frame until the ticks fit again
+        if (Particle::emitterThrottle < MAX_THROTTLE)
+            Particle::emitterThrottle *= 2;
+        mCalmFrames = 0;
+    }
+    else if (mBudget <= 0 || spent * 2 < mBudget)
+    {
+        // Recover slowly, to avoid swinging back and forth
+        if (Particle::emitterThrottle > 1 && ++mCalmFrames >= CALM_FRAMES)
+        {
+            Particle::emitterThrottle--;
+            mCalmFrames = 0;
+        }
+    }
+    else
+    {
+        mCalmFrames = 0;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _PARTICLESCHEDULER_H
+#define _PARTICLESCHEDULER_H
+
+class Particle;
+
+/**
+ * Runs the game ticks of the particle engine within a time budget per frame.
+ *
+ * When a frame took long, many ticks are due at once. Instead of simulating
+ * all of them, which makes the next frame even slower, the ticks that don't
+ * fit in the budget are dropped and the emitters are throttled until the
+ * engine keeps up again.
+ */
+class ParticleScheduler
+{
+    public:
+        /**
+         * Constructor, reads the budget from the configuration.
+         *
+         * @param engine the root particle of the particle engine
+         */
+        ParticleScheduler(Particle *engine);
+
+        /**
+         * Runs as many of the given number of ticks as the budget allows,
+         * and adjusts the emitter throttle.
+         */
+        void update(const int ticks);
+
+        /**
+         * Sets the time in milliseconds the particles may take per frame,
+         * or 0 for no limit.
+         */
+        void setBudget(const int budget) { mBudget = budget; }
+
+        /**
+         * Returns the number of ticks dropped during the last update.
+         */
+        int getDroppedTicks() const { return mDroppedTicks; }
+
+    private:
+        Particle *mEngine;
+        int mBudget;            /**< Milliseconds per frame, 0 for no limit */
+        int mDroppedTicks;
+        int mCalmFrames;        /**< Frames in a row which used less than
+                                     half the budget */
+};
+
+#endif
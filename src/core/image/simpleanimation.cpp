@@ -41,10 +41,16 @@ SimpleAnimation::SimpleAnimation(Animation *animation):
 };
 
 SimpleAnimation::SimpleAnimation(xmlNodePtr animationNode):
+    mAnimation(readAnimation(animationNode)),
     mAnimationTime(0),
-    mAnimationPhase(0)
+    mAnimationPhase(0),
+    mCurrentFrame(mAnimation->getFrame(0))
+{
+}
+
+Animation *SimpleAnimation::readAnimation(xmlNodePtr animationNode)
 {
-    mAnimation = new Animation();
+    Animation *animation = new Animation();
 
     ImageSet *imageset = ResourceManager::getInstance()->getImageSet(
         XML::getProperty(animationNode, "imageset", ""),
@@ -83,7 +89,7 @@ SimpleAnimation::SimpleAnimation(xmlNodePtr animationNode):
                 continue;
             }
 
-            mAnimation->addFrame(img, delay, offsetX, offsetY);
+            animation->addFrame(img, delay, offsetX, offsetY);
         }
         else if (xmlStrEqual(frameNode->name, BAD_CAST "sequence"))
         {
@@ -106,15 +112,15 @@ SimpleAnimation::SimpleAnimation(xmlNodePtr animationNode):
                     continue;
                 }
 
-                mAnimation->addFrame(img, delay, offsetX, offsetY);
+                animation->addFrame(img, delay, offsetX, offsetY);
                 start++;
             }
         }
         else if (xmlStrEqual(frameNode->name, BAD_CAST "end"))
-            mAnimation->addTerminator();
+            animation->addTerminator();
     }
 
-    mCurrentFrame = mAnimation->getFrame(0);
+    return animation;
 }
 
 bool SimpleAnimation::draw(Graphics* graphics, const int posX, const int posY) const
@@ -49,6 +49,12 @@ class SimpleAnimation
 
         ~SimpleAnimation();
 
+        /**
+         * Reads an animation from XML data. The returned animation is to be
+         * deleted by the caller.
+         */
+        static Animation *readAnimation(xmlNodePtr animationNode);
+
         Frame *getFrame() { return mCurrentFrame; }
 
         void setFrame(unsigned int frame);
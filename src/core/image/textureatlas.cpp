@@ -0,0 +1,178 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../../../config.h"
+#endif
+
+#ifdef USE_OPENGL
+
+#include <sstream>
+
+#include "image.h"
+#include "textureatlas.h"
+
+#include "../log.h"
+#include "../resourcemanager.h"
+
+#include "../../bindings/guichan/opengl/openglgraphics.h"
+
+/**
+ * Space left free around every image, so that neighbours never bleed into
+ * each other.
+ */
+static const int PADDING = 1;
+
+TextureAtlas::TextureAtlas(const int pageSize):
+    mPage(NULL),
+    mPageSize(pageSize),
+    mPageCount(0),
+    mBottom(0)
+{
+    logger->log("Packing small images into %dx%d textures", mPageSize,
+                mPageSize);
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    if (mPage)
+        mPage->decRef();
+}
+
+SubImage *TextureAtlas::add(SDL_Surface *surface)
+{
+    // Large images gain little from sharing a texture and would leave too
+    // much of a page unused
+    if (surface->w > mPageSize / 4 || surface->h > mPageSize / 4)
+        return NULL;
+
+    const int width = surface->w + PADDING;
+    const int height = surface->h + PADDING;
+    int x, y;
+
+    if (!mPage || !allocate(width, height, x, y))
+    {
+        if (!newPage() || !allocate(width, height, x, y))
+            return NULL;
+    }
+
+    SDL_Surface *converted = Image::convertToTexture(surface, surface->w,
+                                                     surface->h);
+    if (!converted)
+        return NULL;
+
+    OpenGLGraphics::bindTexture(Image::mTextureType, mPage->mGLImage);
+
+    if (SDL_MUSTLOCK(converted))
+        SDL_LockSurface(converted);
+
+    glTexSubImage2D(Image::mTextureType, 0, x, y, converted->w, converted->h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, converted->pixels);
+
+    if (SDL_MUSTLOCK(converted))
+        SDL_UnlockSurface(converted);
+
+    SDL_FreeSurface(converted);
+
+    return mPage->getSubImage(x, y, surface->w, surface->h);
+}
+
+bool TextureAtlas::allocate(const int width, const int height, int &x,
+                            int &y)
+{
+    // Use the flattest shelf the image fits on
+    Shelf *shelf = NULL;
+    for (std::vector<Shelf>::iterator i = mShelves.begin();
+         i != mShelves.end(); ++i)
+    {
+        if (i->height >= height && i->used + width <= mPageSize &&
+            (!shelf || i->height < shelf->height))
+            shelf = &(*i);
+    }
+
+    // Don't waste a shelf on images much flatter than it, when there's room
+    // left for a new one
+    if ((!shelf || shelf->height > height * 2) &&
+        mBottom + height <= mPageSize)
+    {
+        Shelf newShelf = { mBottom, height, 0 };
+        mShelves.push_back(newShelf);
+        mBottom += height;
+        shelf = &mShelves.back();
+    }
+
+    if (!shelf)
+        return false;
+
+    x = shelf->used;
+    y = shelf->y;
+    shelf->used += width;
+
+    return true;
+}
+
+bool TextureAtlas::newPage()
+{
+    if (mPage)
+        mPage->decRef();
+
+    mShelves.clear();
+    mBottom = 0;
+
+    std::stringstream ss;
+    ss << "atlas page " << ++mPageCount;
+
+    mPage = static_cast<Image*>(ResourceManager::getInstance()->get(ss.str(),
+                                    createPage, &mPageSize));
+
+    return mPage != NULL;
+}
+
+Resource *TextureAtlas::createPage(void *size)
+{
+    const int pageSize = *static_cast<int*>(size);
+
+    // Flush current error flag.
+    glGetError();
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    OpenGLGraphics::bindTexture(Image::mTextureType, texture);
+
+    glTexImage2D(Image::mTextureType, 0, GL_RGBA8, pageSize, pageSize, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glTexParameteri(Image::mTextureType, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(Image::mTextureType, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    if (glGetError())
+    {
+        logger->log("Error: Could not create a %dx%d atlas texture", pageSize,
+                    pageSize);
+        OpenGLGraphics::forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+        return NULL;
+    }
+
+    return new Image(texture, pageSize, pageSize, pageSize, pageSize);
+}
+
+#endif // USE_OPENGL
@@ -0,0 +1,104 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <vector>
+
+class Image;
+class Resource;
+class SubImage;
+
+struct SDL_Surface;
+
+/**
+ * Packs small images into large shared OpenGL textures, so that drawing them
+ * one after another doesn't need to bind another texture every time. Images
+ * are placed on shelves, rows as high as the first image put on them, which
+ * keeps images of the same size like tiles and icons together.
+ *
+ * The pages are resources of their own, kept alive by the images cut from
+ * them. Space of images which are released is not reused; a page is freed
+ * once none of its images are in use anymore.
+ */
+class TextureAtlas
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param pageSize The width and height of the pages.
+         */
+        TextureAtlas(const int pageSize);
+
+        /**
+         * Destructor. Pages stay alive as long as images refer to them.
+         */
+        ~TextureAtlas();
+
+        /**
+         * Copies the surface into a page.
+         *
+         * @return the packed image, or <code>NULL</code> when the surface is
+         *         too large to be packed.
+         */
+        SubImage *add(SDL_Surface *surface);
+
+        /**
+         * Returns the number of pages created so far.
+         */
+        int getPageCount() const { return mPageCount; }
+
+    private:
+        /**
+         * Finds a place on the current page for an image of the given size.
+         *
+         * @return <code>true</code> when there was room, <code>false</code>
+         *         otherwise.
+         */
+        bool allocate(const int width, const int height, int &x, int &y);
+
+        /**
+         * Stops packing into the current page and starts a new one.
+         */
+        bool newPage();
+
+        /**
+         * Creates an empty texture for a page. Used as resource generator.
+         */
+        static Resource *createPage(void *size);
+
+        struct Shelf
+        {
+            int y;      /**< Top of the shelf. */
+            int height; /**< Height of the highest image the shelf holds. */
+            int used;   /**< Width taken by the images on the shelf. */
+        };
+
+        std::vector<Shelf> mShelves;
+        Image *mPage;     /**< The page images are currently packed into. */
+        int mPageSize;
+        int mPageCount;
+        int mBottom;      /**< Top of the space not taken by any shelf. */
+};
+
+#endif
@@ -27,6 +27,8 @@
 
 #include <sys/time.h>
 
+#include <SDL_thread.h>
+
 #ifdef WIN32
 #include <windows.h>
 #elif __APPLE__
@@ -43,7 +45,9 @@
 
 Logger::Logger():
     mLogToStandardOut(false),
-    mLogToChatWindow(false)
+    mLogToChatWindow(false),
+    mMutex(SDL_CreateMutex()),
+    mMainThread(SDL_ThreadID())
 {
 }
 
@@ -51,6 +55,8 @@ Logger::~Logger()
 {
     if (mLogFile.is_open())
         mLogFile.close();
+
+    SDL_DestroyMutex(mMutex);
 }
 
 void Logger::setLogFile(const std::string &logFilename)
@@ -95,12 +101,17 @@ void Logger::log(const char *log_text, ...)
         << (int)((tv.tv_usec / 10000) % 100)
         << "] ";
 
+    SDL_mutexP(mMutex);
+
     mLogFile << timeStr.str() << buf << std::endl;
 
     if (mLogToStandardOut)
         std::cout << timeStr.str() << buf << std::endl;
 
-    if (chatWindow && mLogToChatWindow)
+    SDL_mutexV(mMutex);
+
+    // The chat window can't be touched from other threads
+    if (chatWindow && mLogToChatWindow && SDL_ThreadID() == mMainThread)
         chatWindow->chatLog(buf, Palette::LOGGER);
 
     // Delete temporary buffer
@@ -25,8 +25,12 @@
 
 #include <fstream>
 
+struct SDL_mutex;
+
 /**
- * The Log Class : Useful to write debug or info messages
+ * The Log Class : Useful to write debug or info messages. Messages may be
+ * logged from any thread, but they only show up in the chat window when they
+ * are logged from the main thread.
  */
 class Logger
 {
@@ -76,6 +80,8 @@ class Logger
         std::ofstream mLogFile;
         bool mLogToStandardOut;
         bool mLogToChatWindow;
+        SDL_mutex *mMutex;
+        unsigned int mMainThread;   /**< Thread the logger was created in */
 };
 
 extern Logger *logger;
@@ -0,0 +1,64 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "beinggrid.h"
+
+BeingGrid::BeingGrid(const int width, const int height):
+    mCellsX(std::max((width + CELL_SIZE - 1) / CELL_SIZE, 1)),
+    mCellsY(std::max((height + CELL_SIZE - 1) / CELL_SIZE, 1)),
+    mCells(mCellsX * mCellsY)
+{
+}
+
+BeingGrid::Cell &BeingGrid::getCell(const int x, const int y)
+{
+    const int cx = std::min(std::max(x, 0) / CELL_SIZE, mCellsX - 1);
+    const int cy = std::min(std::max(y, 0) / CELL_SIZE, mCellsY - 1);
+
+    return mCells[cx + cy * mCellsX];
+}
+
+void BeingGrid::add(Being *being, const int x, const int y)
+{
+    getCell(x, y).push_back(being);
+}
+
+void BeingGrid::remove(Being *being, const int x, const int y)
+{
+    Cell &cell = getCell(x, y);
+    Cell::iterator i = std::find(cell.begin(), cell.end(), being);
+
+    if (i != cell.end())
+    {
+        *i = cell.back();
+        cell.pop_back();
+    }
+}
+
+void BeingGrid::move(Being *being, const int oldX, const int oldY,
+                     const int x, const int y)
+{
+    if (&getCell(oldX, oldY) == &getCell(x, y))
+        return;
+
+    remove(being, oldX, oldY);
+    add(being, x, y);
+}
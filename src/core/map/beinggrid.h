@@ -0,0 +1,112 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BEINGGRID_H
+#define BEINGGRID_H
+
+#include <algorithm>
+#include <vector>
+
+class Being;
+
+/**
+ * A spatial index of the beings on a map. The map is divided into square
+ * cells of a few tiles each, and every being is kept in the cell containing
+ * its tile, so looking for beings around a location only has to look at the
+ * beings in a few cells instead of at all of them.
+ *
+ * The grid doesn't look at the beings itself. Whoever moves a being has to
+ * tell the grid about both the old and the new tile.
+ */
+class BeingGrid
+{
+    public:
+        /**
+         * Constructor, taking the map size in tiles.
+         */
+        BeingGrid(const int width, const int height);
+
+        /**
+         * Adds a being standing on the given tile.
+         */
+        void add(Being *being, const int x, const int y);
+
+        /**
+         * Removes a being that was last known to stand on the given tile.
+         */
+        void remove(Being *being, const int x, const int y);
+
+        /**
+         * Moves a being from one tile to another.
+         */
+        void move(Being *being, const int oldX, const int oldY,
+                  const int x, const int y);
+
+        /**
+         * Returns the first being near the given range of tiles for which the
+         * predicate returns <code>true</code>, or NULL if there is none. The
+         * range is inclusive. Beings outside of the range may be passed to
+         * the predicate too, so it has to check the location itself.
+         */
+        template <typename Predicate>
+        Being *find(int minX, int minY, int maxX, int maxY,
+                    Predicate &predicate) const
+        {
+            minX = std::max(minX, 0) / CELL_SIZE;
+            minY = std::max(minY, 0) / CELL_SIZE;
+            maxX = std::min(maxX / CELL_SIZE, mCellsX - 1);
+            maxY = std::min(maxY / CELL_SIZE, mCellsY - 1);
+
+            for (int cy = minY; cy <= maxY; cy++)
+            {
+                for (int cx = minX; cx <= maxX; cx++)
+                {
+                    const Cell &cell = mCells[cx + cy * mCellsX];
+
+                    for (Cell::const_iterator i = cell.begin();
+                         i != cell.end(); ++i)
+                    {
+                        if (predicate(*i))
+                            return *i;
+                    }
+                }
+            }
+
+            return NULL;
+        }
+
+    private:
+        typedef std::vector<Being*> Cell;
+
+        /**
+         * Returns the cell containing the given tile. Tiles outside of the
+         * map are kept in the nearest cell.
+         */
+        Cell &getCell(const int x, const int y);
+
+        /** Width and height of a cell in tiles. */
+        static const int CELL_SIZE = 4;
+
+        int mCellsX, mCellsY;
+        std::vector<Cell> mCells;
+};
+
+#endif
@@ -0,0 +1,538 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "compiledmap.h"
+#include "map.h"
+#include "tileset.h"
+
+#include "../log.h"
+#include "../resourcemanager.h"
+
+#include "../image/animation.h"
+#include "../image/image.h"
+
+#include "../utils/dtor.h"
+
+/** "AMAP" in little endian. */
+static const uint32_t COMPILED_MAP_MAGIC = 0x50414d41;
+
+/** Needs to be raised whenever the layout of the file changes. */
+static const uint32_t COMPILED_MAP_VERSION = 2;
+
+static void writeInt(std::string &out, const int value)
+{
+    const uint32_t v = value;
+    out += (char) (v & 0xff);
+    out += (char) ((v >> 8) & 0xff);
+    out += (char) ((v >> 16) & 0xff);
+    out += (char) ((v >> 24) & 0xff);
+}
+
+static void writeString(std::string &out, const std::string &value)
+{
+    writeInt(out, value.length());
+    out += value;
+}
+
+/**
+ * Reads the values of a compiled map file, refusing to read past its end.
+ */
+class CompiledMapInput
+{
+    public:
+        CompiledMapInput(const unsigned char *data, const int size):
+            mPos(data), mEnd(data + size), mFailed(false)
+        {}
+
+        int readInt()
+        {
+            if (!has(4))
+                return 0;
+
+            const uint32_t v = mPos[0] | mPos[1] << 8 | mPos[2] << 16 |
+                               mPos[3] << 24;
+            mPos += 4;
+            return (int) v;
+        }
+
+        /**
+         * Reads a count of items of at least the given size each, failing
+         * when the file can't possibly contain that many.
+         */
+        int readCount(const int itemSize)
+        {
+            const int count = readInt();
+
+            if (count < 0 || count > (mEnd - mPos) / itemSize)
+            {
+                mFailed = true;
+                return 0;
+            }
+
+            return count;
+        }
+
+        std::string readString()
+        {
+            const int length = readCount(1);
+            const std::string value((const char*) mPos, length);
+            mPos += length;
+            return value;
+        }
+
+        bool failed() const { return mFailed; }
+
+    private:
+        bool has(const unsigned int size)
+        {
+            if (mFailed || (unsigned int) (mEnd - mPos) < size)
+                mFailed = true;
+
+            return !mFailed;
+        }
+
+        const unsigned char *mPos;
+        const unsigned char *mEnd;
+        bool mFailed;
+};
+
+CompiledMap::CompiledMap(const int width, const int height,
+                         const int tileWidth, const int tileHeight):
+    mWidth(width), mHeight(height),
+    mTileWidth(tileWidth), mTileHeight(tileHeight),
+    mBlocked((width * height + 31) / 32, 0)
+{
+}
+
+bool CompiledMap::load(const std::string &filename, const uint32_t checksum)
+{
+    ResourceManager *resman = ResourceManager::getInstance();
+
+    if (!resman->exists(filename))
+        return false;
+
+    // Read the whole file at once and decode it from memory
+    int fileSize;
+    unsigned char *buffer = (unsigned char*) resman->loadFile(filename,
+                                                              fileSize);
+
+    if (!buffer)
+        return false;
+
+    CompiledMapInput in(buffer, fileSize);
+
+    if ((uint32_t) in.readInt() != COMPILED_MAP_MAGIC ||
+        (uint32_t) in.readInt() != COMPILED_MAP_VERSION ||
+        (uint32_t) in.readInt() != checksum)
+    {
+        logger->log("Compiled map %s is outdated", filename.c_str());
+        free(buffer);
+        return false;
+    }
+
+    mWidth = in.readInt();
+    mHeight = in.readInt();
+    mTileWidth = in.readInt();
+    mTileHeight = in.readInt();
+
+    for (int i = in.readCount(8); i > 0; i--)
+    {
+        const std::string name = in.readString();
+        setProperty(name, in.readString());
+    }
+
+    mTilesets.resize(in.readCount(20));
+    for (unsigned int i = 0; i < mTilesets.size(); i++)
+    {
+        TilesetData &tileset = mTilesets[i];
+        tileset.firstGid = in.readInt();
+        tileset.tileWidth = in.readInt();
+        tileset.tileHeight = in.readInt();
+        tileset.image = in.readString();
+
+        tileset.animations.resize(in.readCount(8));
+        for (unsigned int j = 0; j < tileset.animations.size(); j++)
+        {
+            AnimationData &animation = tileset.animations[j];
+            animation.gid = in.readInt();
+            animation.frames.resize(in.readCount(8));
+
+            for (unsigned int k = 0; k < animation.frames.size(); k++)
+            {
+                animation.frames[k].first = in.readInt();
+                animation.frames[k].second = in.readInt();
+            }
+        }
+    }
+
+    mLayers.resize(in.readCount(32));
+    for (unsigned int i = 0; i < mLayers.size() && !in.failed(); i++)
+    {
+        LayerData &layer = mLayers[i];
+        layer.x = in.readInt();
+        layer.y = in.readInt();
+        layer.width = in.readInt();
+        layer.height = in.readInt();
+        layer.tileWidth = in.readInt();
+        layer.tileHeight = in.readInt();
+
+        const int flags = in.readInt();
+        layer.isFringeLayer = flags & 1;
+        layer.isVisible = flags & 2;
+
+        layer.gids.resize(in.readCount(4));
+        for (unsigned int j = 0; j < layer.gids.size(); j++)
+            layer.gids[j] = in.readInt();
+    }
+
+    mBlocked.resize(in.readCount(4));
+    for (unsigned int i = 0; i < mBlocked.size(); i++)
+        mBlocked[i] = in.readInt();
+
+    mEffects.resize(in.readCount(12));
+    for (unsigned int i = 0; i < mEffects.size(); i++)
+    {
+        mEffects[i].file = in.readString();
+        mEffects[i].x = in.readInt();
+        mEffects[i].y = in.readInt();
+    }
+
+    mWarps.resize(in.readCount(20));
+    for (unsigned int i = 0; i < mWarps.size(); i++)
+    {
+        mWarps[i].x = in.readInt();
+        mWarps[i].y = in.readInt();
+        mWarps[i].width = in.readInt();
+        mWarps[i].height = in.readInt();
+        mWarps[i].destination = in.readString();
+    }
+
+    free(buffer);
+
+    if (in.failed() || mWidth < 0 || mHeight < 0 ||
+        mBlocked.size() != (unsigned int) (mWidth * mHeight + 31) / 32)
+    {
+        logger->log("Error: Compiled map %s is damaged", filename.c_str());
+        return false;
+    }
+
+    for (unsigned int i = 0; i < mLayers.size(); i++)
+    {
+        if (mLayers[i].gids.size() !=
+            (unsigned int) (mLayers[i].width * mLayers[i].height))
+        {
+            logger->log("Error: Compiled map %s is damaged", filename.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CompiledMap::save(const std::string &filename,
+                       const uint32_t checksum) const
+{
+    std::string out;
+
+    writeInt(out, COMPILED_MAP_MAGIC);
+    writeInt(out, COMPILED_MAP_VERSION);
+    writeInt(out, checksum);
+    writeInt(out, mWidth);
+    writeInt(out, mHeight);
+    writeInt(out, mTileWidth);
+    writeInt(out, mTileHeight);
+
+    const PropertyMap &properties = getProperties();
+    writeInt(out, properties.size());
+    for (PropertyMap::const_iterator i = properties.begin();
+         i != properties.end(); ++i)
+    {
+        writeString(out, i->first);
+        writeString(out, i->second);
+    }
+
+    writeInt(out, mTilesets.size());
+    for (std::vector<TilesetData>::const_iterator i = mTilesets.begin();
+         i != mTilesets.end(); ++i)
+    {
+        writeInt(out, i->firstGid);
+        writeInt(out, i->tileWidth);
+        writeInt(out, i->tileHeight);
+        writeString(out, i->image);
+
+        writeInt(out, i->animations.size());
+        for (std::vector<AnimationData>::const_iterator j =
+             i->animations.begin(); j != i->animations.end(); ++j)
+        {
+            writeInt(out, j->gid);
+            writeInt(out, j->frames.size());
+
+            for (unsigned int k = 0; k < j->frames.size(); k++)
+            {
+                writeInt(out, j->frames[k].first);
+                writeInt(out, j->frames[k].second);
+            }
+        }
+    }
+
+    writeInt(out, mLayers.size());
+    for (std::vector<LayerData>::const_iterator i = mLayers.begin();
+         i != mLayers.end(); ++i)
+    {
+        writeInt(out, i->x);
+        writeInt(out, i->y);
+        writeInt(out, i->width);
+        writeInt(out, i->height);
+        writeInt(out, i->tileWidth);
+        writeInt(out, i->tileHeight);
+        writeInt(out, (i->isFringeLayer ? 1 : 0) | (i->isVisible ? 2 : 0));
+
+        out.reserve(out.size() + 4 + i->gids.size() * 4);
+        writeInt(out, i->gids.size());
+        for (unsigned int j = 0; j < i->gids.size(); j++)
+            writeInt(out, i->gids[j]);
+    }
+
+    writeInt(out, mBlocked.size());
+    for (unsigned int i = 0; i < mBlocked.size(); i++)
+        writeInt(out, mBlocked[i]);
+
+    writeInt(out, mEffects.size());
+    for (std::vector<EffectData>::const_iterator i = mEffects.begin();
+         i != mEffects.end(); ++i)
+    {
+        writeString(out, i->file);
+        writeInt(out, i->x);
+        writeInt(out, i->y);
+    }
+
+    writeInt(out, mWarps.size());
+    for (std::vector<WarpData>::const_iterator i = mWarps.begin();
+         i != mWarps.end(); ++i)
+    {
+        writeInt(out, i->x);
+        writeInt(out, i->y);
+        writeInt(out, i->width);
+        writeInt(out, i->height);
+        writeString(out, i->destination);
+    }
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    const std::string dir = filename.substr(0, filename.rfind("/"));
+
+    if (!resman->isDirectory(dir) && !resman->mkdir(dir))
+        return false;
+
+    return resman->saveFile(filename, out.data(), out.size());
+}
+
+Map *CompiledMap::createMap() const
+{
+    ResourceManager *resman = ResourceManager::getInstance();
+    Map *map = new Map(mWidth, mHeight, mTileWidth, mTileHeight);
+
+    const PropertyMap &properties = getProperties();
+    for (PropertyMap::const_iterator i = properties.begin();
+         i != properties.end(); ++i)
+    {
+        map->setProperty(i->first, i->second);
+    }
+
+    for (std::vector<TilesetData>::const_iterator i = mTilesets.begin();
+         i != mTilesets.end(); ++i)
+    {
+        Image *tilebmp = resman->getImage(i->image);
+
+        if (!tilebmp)
+        {
+            logger->log("Warning: Failed to load tileset (%s)",
+                        i->image.c_str());
+            continue;
+        }
+
+        Tileset *set = new Tileset(tilebmp, i->tileWidth, i->tileHeight,
+                                   i->firstGid);
+        tilebmp->decRef();
+        map->addTileset(set);
+
+        for (std::vector<AnimationData>::const_iterator j =
+             i->animations.begin(); j != i->animations.end(); ++j)
+        {
+            Animation *ani = new Animation();
+
+            for (unsigned int k = 0; k < j->frames.size(); k++)
+            {
+                ani->addFrame(set->get(j->frames[k].first),
+                              j->frames[k].second, 0, 0);
+            }
+
+            if (ani->getLength() > 0)
+            {
+                map->addAnimation(j->gid, new TileAnimation(ani));
+                logger->log("Animation length: %d", ani->getLength());
+            }
+            else
+                destroy(ani);
+        }
+    }
+
+    // Look up the image and animation of each gid once, instead of searching
+    // the tilesets for every tile
+    std::vector<TileEntry> table;
+    createTileTable(map, table);
+    const int tableSize = table.size();
+
+    for (std::vector<LayerData>::const_iterator i = mLayers.begin();
+         i != mLayers.end(); ++i)
+    {
+        MapLayer *layer = new MapLayer(i->x, i->y, i->width, i->height,
+                                       i->tileWidth, i->tileHeight,
+                                       i->isFringeLayer, i->isVisible);
+        map->addLayer(layer);
+
+        const int size = i->width * i->height;
+        const std::vector<int> &gids = i->gids;
+
+        for (int index = 0; index < size; index++)
+        {
+            const int gid = gids[index];
+
+            // Empty tiles are the default
+            if (gid <= 0)
+                continue;
+
+            if (gid < tableSize)
+            {
+                const TileEntry &entry = table[gid];
+
+                if (entry.image)
+                    layer->setTile(index, entry.image);
+                if (entry.animation)
+                    entry.animation->addAffectedTile(layer, index);
+
+                continue;
+            }
+
+            // Gids past the end of the last tileset
+            const Tileset *set = map->getTilesetWithGid(gid);
+            layer->setTile(index, set ? set->get(gid - set->getFirstGid())
+                                      : NULL);
+
+            TileAnimation *ani = map->getAnimationForGid(gid);
+            if (ani)
+                ani->addAffectedTile(layer, index);
+        }
+    }
+
+    for (int y = 0; y < mHeight; y++)
+    {
+        for (int x = 0; x < mWidth; x++)
+        {
+            const int index = x + y * mWidth;
+
+            if ((mBlocked[index >> 5] >> (index & 31)) & 1)
+                map->setWalk(x, y, false);
+        }
+    }
+
+    for (std::vector<EffectData>::const_iterator i = mEffects.begin();
+         i != mEffects.end(); ++i)
+    {
+        map->addParticleEffect(i->file, i->x, i->y);
+    }
+
+    for (std::vector<WarpData>::const_iterator i = mWarps.begin();
+         i != mWarps.end(); ++i)
+    {
+        MapWarp warp;
+        warp.x = i->x;
+        warp.y = i->y;
+        warp.width = i->width;
+        warp.height = i->height;
+        warp.destination = i->destination;
+        map->addWarp(warp);
+    }
+
+    map->initializeAmbientLayers();
+    map->initializePathCache();
+
+    return map;
+}
+
+void CompiledMap::createTileTable(Map *map, std::vector<TileEntry> &table)
+{
+    int size = 0;
+
+    for (Tilesets::const_iterator i = map->getTilesets().begin();
+         i != map->getTilesets().end(); ++i)
+    {
+        size = std::max(size, (*i)->getFirstGid() + (int) (*i)->size());
+    }
+
+    table.resize(size);
+
+    for (int gid = 1; gid < size; gid++)
+    {
+        const Tileset *set = map->getTilesetWithGid(gid);
+        const unsigned int index = set ? gid - set->getFirstGid() : 0;
+
+        table[gid].image = set && index < set->size() ? set->get(index) : NULL;
+        table[gid].animation = map->getAnimationForGid(gid);
+    }
+}
+
+std::string CompiledMap::getCacheFile(const std::string &mapFile)
+{
+    std::string name = mapFile;
+
+    for (std::string::size_type i = 0; i < name.length(); i++)
+    {
+        if (name[i] == '/' || name[i] == '\\')
+            name[i] = '_';
+    }
+
+    return "mapcache/" + name + ".bin";
+}
+
+void CompiledMap::setCollision(const int x, const int y, const int gid)
+{
+    if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
+        return;
+
+    // Like Map::getTilesetWithGid, the last tileset starting at or before the
+    // gid is the one it belongs to
+    const TilesetData *set = NULL;
+
+    for (std::vector<TilesetData>::const_iterator i = mTilesets.begin();
+         i != mTilesets.end() && i->firstGid <= gid; ++i)
+    {
+        set = &*i;
+    }
+
+    if (set && gid != set->firstGid)
+    {
+        const int index = x + y * mWidth;
+        mBlocked[index >> 5] |= 1u << (index & 31);
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef COMPILEDMAP_H
+#define COMPILEDMAP_H
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "properties.h"
+
+class Image;
+class Map;
+class TileAnimation;
+
+/**
+ * Everything needed to build a map, as read from a map file but without any
+ * of the resources it refers to loaded yet. Besides being built from the XML
+ * map files by the MapReader, a compiled map can be stored in a simple binary
+ * format, which loads a lot faster than parsing and decoding the XML again.
+ */
+class CompiledMap : public Properties
+{
+    friend class MapReader;
+
+    public:
+        /**
+         * Frames of an animated tile, as pairs of tileset index and delay.
+         */
+        struct AnimationData
+        {
+            int gid;
+            std::vector<std::pair<int, int> > frames;
+        };
+
+        struct TilesetData
+        {
+            int firstGid;
+            int tileWidth, tileHeight;
+            std::string image;
+            std::vector<AnimationData> animations;
+        };
+
+        struct LayerData
+        {
+            int x, y;
+            int width, height;
+            int tileWidth, tileHeight;
+            bool isFringeLayer;
+            bool isVisible;
+            std::vector<int> gids;
+        };
+
+        struct EffectData
+        {
+            std::string file;
+            int x, y;
+        };
+
+        struct WarpData
+        {
+            int x, y;
+            int width, height;
+            std::string destination;
+        };
+
+        /**
+         * Constructor, taking the map and tile dimensions.
+         */
+        CompiledMap(const int width = 0, const int height = 0,
+                    const int tileWidth = 0, const int tileHeight = 0);
+
+        /**
+         * Reads a compiled map from a file. Fails when the file doesn't
+         * exist, is damaged or was compiled from a map file with a different
+         * checksum.
+         *
+         * @return <code>true</code> on success, <code>false</code> otherwise.
+         */
+        bool load(const std::string &filename, const uint32_t checksum);
+
+        /**
+         * Writes the compiled map to a file in the write directory, together
+         * with the checksum of the map file it was compiled from.
+         *
+         * @return <code>true</code> on success, <code>false</code> otherwise.
+         */
+        bool save(const std::string &filename, const uint32_t checksum) const;
+
+        /**
+         * Returns the tilesets used by the map.
+         */
+        const std::vector<TilesetData> &getTilesets() const
+        { return mTilesets; }
+
+        /**
+         * Creates the map, loading the tilesets it uses.
+         */
+        Map *createMap() const;
+
+        /**
+         * Returns the name of the compiled version of the given map file in
+         * the write directory.
+         */
+        static std::string getCacheFile(const std::string &mapFile);
+
+    private:
+        /**
+         * The image and animation of a gid.
+         */
+        struct TileEntry
+        {
+            Image *image;
+            TileAnimation *animation;
+        };
+
+        /**
+         * Fills a table with the image and animation of each gid, for the
+         * tilesets and animations of the given map. Gids past the end of
+         * the last tileset aren't in the table.
+         */
+        static void createTileTable(Map *map, std::vector<TileEntry> &table);
+
+        /**
+         * Marks a tile as blocked when the given gid of a collision layer
+         * isn't the first tile of its tileset.
+         */
+        void setCollision(const int x, const int y, const int gid);
+
+        int mWidth, mHeight;
+        int mTileWidth, mTileHeight;
+        std::vector<TilesetData> mTilesets;
+        std::vector<LayerData> mLayers;
+        std::vector<uint32_t> mBlocked;     /**< Packed collision bits */
+        std::vector<EffectData> mEffects;
+        std::vector<WarpData> mWarps;
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "layerdecoder.h"
+
+#include "../log.h"
+
+#include "../utils/base64.h"
+#include "../utils/jobsystem.h"
+
+#include "../../bindings/zlib/memorytools.h"
+
+LayerDecoder::~LayerDecoder()
+{
+    for (unsigned int i = 0; i < mJobs.size(); i++)
+        free(mJobs[i].data);
+}
+
+int LayerDecoder::add(const char *text, bool compressed, unsigned int length)
+{
+    Job job;
+    job.text = text;
+    job.compressed = compressed;
+    job.expectedLength = length;
+    job.data = NULL;
+    job.length = 0;
+    mJobs.push_back(job);
+
+    return mJobs.size() - 1;
+}
+
+void LayerDecoder::decode()
+{
+    // Layers differ a lot in size, so each is a job of its own, which lets
+    // idle workers steal the remaining layers
+    JobSystem::getInstance()->parallelFor(decodeJobs, this, mJobs.size(), 1);
+}
+
+const unsigned char *LayerDecoder::getData(int index, int &length) const
+{
+    length = mJobs[index].length;
+    return mJobs[index].data;
+}
+
+void LayerDecoder::decodeJobs(void *decoder, const int begin, const int end,
+                              const int)
+{
+    // Each job is only touched by the worker that took it
+    LayerDecoder *self = static_cast<LayerDecoder*>(decoder);
+
+    for (int i = begin; i < end; i++)
+        decodeJob(self->mJobs[i]);
+}
+
+void LayerDecoder::decodeJob(Job &job)
+{
+    const int textLength = strlen(job.text);
+
+    if (!job.compressed)
+    {
+        // Uncompressed data is decoded straight into the layer buffer
+        job.data = job.expectedLength > 0 ?
+            (unsigned char*) malloc(job.expectedLength) : NULL;
+        job.length = job.data ?
+            base64_decode_into((const unsigned char*) job.text, textLength,
+                               job.data, job.expectedLength) : 0;
+        return;
+    }
+
+    // The base64 decoder skips whitespace by itself, so the text doesn't
+    // need to be copied first
+    const int binSize = textLength / 4 * 3 + 3;
+    unsigned char *binData = (unsigned char*) malloc(binSize);
+    const int binLen = binData ?
+        base64_decode_into((const unsigned char*) job.text, textLength,
+                           binData, binSize) : 0;
+
+    // The size of the layer is known, so inflate straight into a buffer
+    // of that size instead of letting it grow
+    unsigned char *inflated = NULL;
+    unsigned int inflatedSize = 0;
+
+    if (job.expectedLength > 0)
+    {
+        inflated = (unsigned char*) malloc(job.expectedLength);
+        if (inflated)
+            inflatedSize = inflateMemoryInto(binData, binLen, inflated,
+                                             job.expectedLength);
+
+        if (inflatedSize == 0)
+        {
+            logger->log("Error: Could not decompress layer!");
+            free(inflated);
+            inflated = NULL;
+        }
+    }
+
+    free(binData);
+
+    job.data = inflated;
+    job.length = inflatedSize;
+}
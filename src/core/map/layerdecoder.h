@@ -0,0 +1,86 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LAYERDECODER_H
+#define LAYERDECODER_H
+
+#include <vector>
+
+/**
+ * Decodes the base64 encoded, optionally gzip compressed, tile data of map
+ * layers. Decoding the layers of a large map is the bulk of the time spent
+ * reading it, so the layers are decoded concurrently on the shared job
+ * system, one job per layer.
+ */
+class LayerDecoder
+{
+    public:
+        /**
+         * Constructor.
+         */
+        LayerDecoder() {}
+
+        /**
+         * Destructor, frees the decoded data.
+         */
+        ~LayerDecoder();
+
+        /**
+         * Queues the given layer data for decoding and returns its index. The
+         * text isn't copied, so it needs to stay around until decode() has
+         * returned. The data is decoded, and inflated when compressed, into
+         * a buffer of the given length. Anything beyond it is ignored.
+         */
+        int add(const char *text, bool compressed, unsigned int length);
+
+        /**
+         * Decodes all queued layers, returning when all are decoded.
+         */
+        void decode();
+
+        /**
+         * Returns the decoded data of the given layer, or NULL when it
+         * couldn't be decoded.
+         */
+        const unsigned char *getData(int index, int &length) const;
+
+    private:
+        LayerDecoder(const LayerDecoder&);  // prevent copying
+        LayerDecoder& operator=(const LayerDecoder&);
+
+        struct Job
+        {
+            const char *text;
+            bool compressed;
+            unsigned int expectedLength;
+            unsigned char *data;
+            int length;
+        };
+
+        static void decodeJobs(void *decoder, const int begin,
+                               const int end, const int worker);
+
+        static void decodeJob(Job &job);
+
+        std::vector<Job> mJobs;
+};
+
+#endif
@@ -20,12 +20,16 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-#include <queue>
-
 #include "ambientlayer.h"
+#include "beinggrid.h"
 #include "map.h"
+#include "pathcache.h"
+#include "pathfinder.h"
+#include "spriteorder.h"
+#include "tilechunkcache.h"
 #include "tileset.h"
 
+#include "sprite/being.h"
 #include "sprite/sprite.h"
 
 #include "../configuration.h"
@@ -38,39 +42,36 @@
 #include "../image/particle/particle.h"
 
 #include "../utils/dtor.h"
+#include "../utils/profiler.h"
 #include "../utils/stringutils.h"
 
 #include "../../bindings/guichan/graphics.h"
 #include "../../bindings/guichan/gui.h"
 
-#include "../../eathena/beingmanager.h"
-
 extern volatile int tick_time;
 
 /**
- * A location on a tile map. Used for pathfinding, open list.
+ * Matches the beings standing on a tile. Portals (job 45) don't collide.
  */
-struct Location
-{
-    /**
-     * Constructor.
-     */
-    Location(int px, int py, MetaTile *ptile):
-        x(px), y(py), tile(ptile)
-    {}
-
-    /**
-     * Comparison operator.
-     */
-    bool operator< (const Location &loc) const
-    {
-        return tile->Fcost > loc.tile->Fcost;
-    }
+class OccupiedFunctor
+{
+    public:
+        OccupiedFunctor(const int x, const int y): x(x), y(y) {}
 
-    int x, y;
-    MetaTile *tile;
+        bool operator() (const Being *being) const
+        {
+            return being->mX == x && being->mY == y && being->mJob != 45;
+        }
+
+        int x, y;
 };
 
+/**
+ * Time in milliseconds after which a pre-rendered chunk that hasn't been
+ * drawn is freed again.
+ */
+static const int CHUNK_EXPIRE_TIME = 5000;
+
 TileAnimation::TileAnimation(Animation *ani):
     mLastImage(NULL)
 {
@@ -110,7 +111,9 @@ MapLayer::MapLayer(const int x, const int y, const int width, const int height,
     mWidth(width), mHeight(height),
     mTileWidth(tileWidth), mTileHeight(tileHeight),
     mIsFringeLayer(isFringeLayer),
-    mIsVisible(isVisible)
+    mIsVisible(isVisible),
+    mChunkCache(NULL),
+    mChunksX(0), mChunksY(0)
 {
     const int size = mWidth * mHeight;
     mTiles = new Image*[size];
@@ -119,6 +122,12 @@ MapLayer::MapLayer(const int x, const int y, const int width, const int height,
 
 MapLayer::~MapLayer()
 {
+    for (std::vector<TileChunk>::iterator i = mChunks.begin();
+         i != mChunks.end(); ++i)
+    {
+        destroy(i->image);
+    }
+
     delete[] mTiles;
 }
 
@@ -127,14 +136,45 @@ void MapLayer::setTile(const int x, const int y, Image *img)
     setTile(x + y * mWidth, img);
 }
 
+void MapLayer::setTile(const int index, Image *img)
+{
+    mTiles[index] = img;
+
+    if (mChunks.empty())
+        return;
+
+    // Throw away the pre-rendered chunk this tile is part of
+    const int chunkX = (index % mWidth) / TILE_CHUNK_SIZE;
+    const int chunkY = (index / mWidth) / TILE_CHUNK_SIZE;
+    TileChunk &chunk = mChunks[chunkX + chunkY * mChunksX];
+
+    if (!chunk.dirty)
+    {
+        destroy(chunk.image);
+        chunk.dirty = true;
+        chunk.invalidations++;
+    }
+}
+
 Image* MapLayer::getTile(const int x, const int y) const
 {
     return mTiles[x + y * mWidth];
 }
 
+void MapLayer::setChunkCache(TileChunkCache *cache)
+{
+    if (mIsFringeLayer)
+        return;
+
+    mChunkCache = cache;
+    mChunksX = (mWidth + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    mChunksY = (mHeight + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    mChunks.resize(mChunksX * mChunksY);
+}
+
 void MapLayer::draw(Graphics *graphics, int startX, int startY,
                     int endX, int endY, int scrollX, int scrollY,
-                    const Sprites &sprites) const
+                    const SpriteOrder &sprites, const bool useChunks)
 {
     startX -= mX;
     startY -= mY;
@@ -146,28 +186,64 @@ void MapLayer::draw(Graphics *graphics, int startX, int startY,
     if (endX > mWidth) endX = mWidth;
     if (endY > mHeight) endY = mHeight;
 
-    Sprites::const_iterator si = sprites.begin();
-
     graphics->pushClipArea(gcn::Rectangle(0, 0, graphics->getWidth(),
                                           graphics->getHeight()));
 
+    if (!mIsFringeLayer)
+    {
+        if (mIsVisible)
+        {
+            if (mChunkCache && useChunks)
+                drawChunks(graphics, startX, startY, endX, endY, scrollX,
+                           scrollY);
+            else
+                drawTiles(graphics, startX, startY, endX, endY, scrollX,
+                          scrollY);
+        }
+
+        expireChunks();
+        graphics->popClipArea();
+        return;
+    }
+
+    SpriteOrder::const_iterator si = sprites.begin();
+
     for (int y = startY; y < endY; y++)
     {
         if (!mIsVisible)
             continue;
 
-        // If drawing the fringe layer, make sure all sprites above this row of
-        // tiles have been drawn
-        if (mIsFringeLayer)
+        // Make sure all sprites above this row of tiles have been drawn
+        while (si != sprites.end() &&
+              si->y <= y * mTileHeight - mTileHeight)
         {
-            while (si != sprites.end() &&
-                  (*si)->getPixelY() <= y * mTileHeight - mTileHeight)
-            {
-                (*si)->draw(graphics, -scrollX, -scrollY);
-                si++;
-            }
+            si->sprite->draw(graphics, -scrollX, -scrollY);
+            ++si;
         }
 
+        drawTiles(graphics, startX, y, endX, y + 1, scrollX, scrollY);
+    }
+
+    // Draw any remaining sprites
+    while (si != sprites.end())
+    {
+        if (-scrollX >= 0 && -scrollX <= graphics->getWidth() &&
+            -scrollY >= 0 && -scrollY <= graphics->getHeight())
+        {
+            si->sprite->draw(graphics, -scrollX, -scrollY);
+        }
+        ++si;
+    }
+
+    graphics->popClipArea();
+}
+
+void MapLayer::drawTiles(Graphics *graphics, const int startX,
+                         const int startY, const int endX, const int endY,
+                         const int scrollX, const int scrollY) const
+{
+    for (int y = startY; y < endY; y++)
+    {
         for (int x = startX; x < endX; x++)
         {
             Image *img = getTile(x, y);
@@ -180,22 +256,68 @@ void MapLayer::draw(Graphics *graphics, int startX, int startY,
             }
         }
     }
+}
 
-    // Draw any remaining sprites
-    if (mIsFringeLayer)
+void MapLayer::drawChunks(Graphics *graphics, const int startX,
+                          const int startY, const int endX, const int endY,
+                          const int scrollX, const int scrollY)
+{
+    if (startX >= endX || startY >= endY)
+        return;
+
+    const int startChunkX = startX / TILE_CHUNK_SIZE;
+    const int startChunkY = startY / TILE_CHUNK_SIZE;
+    const int endChunkX = (endX - 1) / TILE_CHUNK_SIZE;
+    const int endChunkY = (endY - 1) / TILE_CHUNK_SIZE;
+
+    for (int cy = startChunkY; cy <= endChunkY; cy++)
     {
-        while (si != sprites.end())
+        for (int cx = startChunkX; cx <= endChunkX; cx++)
         {
-            if (-scrollX >= 0 && -scrollX <= graphics->getWidth() &&
-                -scrollY >= 0 && -scrollY <= graphics->getHeight())
+            TileChunk &chunk = mChunks[cx + cy * mChunksX];
+            chunk.lastUsed = tick_time;
+
+            if (chunk.dirty &&
+                chunk.invalidations < TILE_CHUNK_MAX_INVALIDATIONS)
+            {
+                mChunkCache->bake(this, cx, cy, chunk);
+            }
+
+            if (!chunk.dirty)
             {
-                (*si)->draw(graphics, -scrollX, -scrollY);
+                if (chunk.image)
+                {
+                    const int px = (cx * TILE_CHUNK_SIZE + mX) * mTileWidth -
+                                   scrollX;
+                    const int py = (cy * TILE_CHUNK_SIZE + mY) * mTileHeight -
+                                   scrollY - chunk.offsetY;
+                    graphics->drawImage(chunk.image, px, py);
+                }
+                continue;
             }
-            si++;
+
+            // Not baked (yet), draw the visible part tile by tile
+            drawTiles(graphics,
+                      std::max(startX, cx * TILE_CHUNK_SIZE),
+                      std::max(startY, cy * TILE_CHUNK_SIZE),
+                      std::min(endX, (cx + 1) * TILE_CHUNK_SIZE),
+                      std::min(endY, (cy + 1) * TILE_CHUNK_SIZE),
+                      scrollX, scrollY);
         }
     }
+}
 
-    graphics->popClipArea();
+void MapLayer::expireChunks()
+{
+    for (std::vector<TileChunk>::iterator i = mChunks.begin();
+         i != mChunks.end(); ++i)
+    {
+        if (i->image && get_elapsed_time(i->lastUsed) > CHUNK_EXPIRE_TIME)
+        {
+            destroy(i->image);
+            i->dirty = true;
+        }
+    }
 }
 
 Map::Map(const int width, const int height, const int tileWidth,
@@ -203,23 +325,28 @@ Map::Map(const int width, const int height, const int tileWidth,
     mWidth(width), mHeight(height),
     mTileWidth(tileWidth), mTileHeight(tileHeight),
     mMaxTileHeight(height),
-    mOnClosedList(1), mOnOpenList(2),
+    mPathCache(NULL),
     mLastScrollX(0.0f), mLastScrollY(0.0f)
 {
-    const int size = mWidth * mHeight;
-
-    mMetaTiles = new MetaTile[size];
+    mPathFinder = new PathFinder(mWidth, mHeight);
+    mBeingGrid = new BeingGrid(mWidth, mHeight);
+    mChunkCache = new TileChunkCache;
+    mSprites = new SpriteOrder(mHeight, mTileHeight);
 }
 
 Map::~Map()
 {
-    // delete metadata, layers, tilesets and overlays
-    delete[] mMetaTiles;
+    // delete path finding data, layers, tilesets and overlays
+    destroy(mPathCache);
+    destroy(mPathFinder);
+    destroy(mBeingGrid);
     delete_all(mLayers);
     delete_all(mTilesets);
     delete_all(mForegrounds);
     delete_all(mBackgrounds);
     delete_all(mTileAnimations);
+    destroy(mChunkCache);
+    destroy(mSprites);
 }
 
 void Map::initializeAmbientLayers()
@@ -271,8 +398,20 @@ void Map::initializeAmbientLayers()
     }
 }
 
+void Map::initializePathCache()
+{
+    destroy(mPathCache);
+
+    if (config.getValue("hierarchicalPathfinding", 1))
+    {
+        mPathCache = new PathCache(mPathFinder);
+        mPathCache->update();
+    }
+}
+
 void Map::addLayer(MapLayer *layer)
 {
+    layer->setChunkCache(mChunkCache);
     mLayers.push_back(layer);
 }
 
@@ -284,11 +423,6 @@ void Map::addTileset(Tileset *tileset)
         mMaxTileHeight = tileset->getHeight();
 }
 
-bool spriteCompare(const Sprite *a, const Sprite *b)
-{
-    return a->getPixelY() < b->getPixelY();
-}
-
 void Map::update(const int ticks)
 {
     //update animated tiles
@@ -302,6 +436,8 @@ void Map::update(const int ticks)
 
 void Map::draw(Graphics *graphics, int scrollX, int scrollY)
 {
+    ProfileScope scope("Map::draw");
+
     //Calculate range of tiles which are on-screen
     int endPixelY = graphics->getHeight() + scrollY + mTileHeight +
                     mMaxTileHeight - mTileHeight - 1;
@@ -312,7 +448,7 @@ void Map::draw(Graphics *graphics, int scrollX, int scrollY)
 
     // Make sure sprites are sorted ascending by Y-coordinate so that they
     // overlap correctly
-    mSprites.sort(spriteCompare);
+    mSprites->update();
 
     // update scrolling of all ambient layers
     updateAmbientLayers(scrollX, scrollY);
@@ -322,11 +458,14 @@ void Map::draw(Graphics *graphics, int scrollX, int scrollY)
                      (int) config.getValue("OverlayDetail", 2));
 
     // draw the game world
+    const bool useChunks = config.getValue("tileChunkCache", 1) == 1;
+    mChunkCache->newFrame();
+
     Layers::const_iterator layeri = mLayers.begin();
     for (; layeri != mLayers.end(); ++layeri)
     {
         (*layeri)->draw(graphics, startX, startY, endX, endY, scrollX, scrollY,
-                        mSprites);
+                        *mSprites, useChunks);
     }
 
     drawAmbientLayers(graphics, FOREGROUND_LAYERS, scrollX, scrollY,
@@ -412,25 +551,22 @@ Tileset* Map::getTilesetWithGid(const int gid) const
 
 void Map::setWalk(const int x, const int y, const bool walkable)
 {
-    mMetaTiles[x + y * mWidth].walkable = walkable;
+    mPathFinder->setWalkable(x, y, walkable);
+
+    if (mPathCache)
+        mPathCache->invalidate(x, y);
 }
  
 bool Map::occupied(const int x, const int y) const
 {
-    const Beings &beings = beingManager->getAll();
-    for (Beings::const_iterator i = beings.begin(); i != beings.end(); i++)
-    {
-        // job 45 is a portal, they don't collide
-        if ((*i)->mX == x && (*i)->mY == y && (*i)->mJob != 45)
-            return true;
-    }
+    OccupiedFunctor finder(x, y);
 
-    return false;
+    return mBeingGrid->find(x, y, x, y, finder) != NULL;
 }
 
 bool Map::tileCollides(const int x, const int y) const
 {
-     return !(contains(x, y) && mMetaTiles[x + y * mWidth].walkable);
+     return !(contains(x, y) && mPathFinder->isWalkable(x, y));
 }
 
 bool Map::contains(const int x, const int y) const
@@ -438,20 +574,14 @@ bool Map::contains(const int x, const int y) const
     return x >= 0 && y >= 0 && x < mWidth && y < mHeight;
 }
 
-MetaTile* Map::getMetaTile(const int x, const int y)
-{
-    return &mMetaTiles[x + y * mWidth];
-}
-
-SpriteIterator Map::addSprite(Sprite *sprite)
+void Map::addSprite(Sprite *sprite)
 {
-    mSprites.push_front(sprite);
-    return mSprites.begin();
+    mSprites->add(sprite);
 }
 
-void Map::removeSprite(SpriteIterator iterator)
+void Map::removeSprite(Sprite *sprite)
 {
-    mSprites.erase(iterator);
+    mSprites->remove(sprite);
 }
 
 const std::string Map::getMusicFile() const
@@ -467,153 +597,16 @@ const std::string Map::getName() const
 Path Map::findPath(const int startX, const int startY, const int destX,
                    const int destY)
 {
-    // Path to be built up (empty by default)
-    Path path;
-
-    // Declare open list, a list with open tiles sorted on F cost
-    std::priority_queue<Location> openList;
-
-    // Reset starting tile's G cost to 0
-    MetaTile *startTile = getMetaTile(startX, startY);
-    startTile->Gcost = 0;
-
-    // Add the start point to the open list
-    openList.push(Location(startX, startY, startTile));
-
-    bool foundPath = false;
-
-    // Keep trying new open tiles until no more tiles to try or target found
-    while (!openList.empty() && !foundPath)
-    {
-        // Take the location with the lowest F cost from the open list.
-        Location curr = openList.top();
-        openList.pop();
-
-        // If the tile is already on the closed list, this means it has already
-        // been processed with a shorter path to the start point (lower G cost)
-        if (curr.tile->whichList == mOnClosedList)
-            continue;
+    if (mPathCache)
+        return mPathCache->findPath(startX, startY, destX, destY);
 
-        // Put the current tile on the closed list
-        curr.tile->whichList = mOnClosedList;
-
-        // Check the adjacent tiles
-        for (int dy = -1; dy <= 1; dy++)
-        {
-            for (int dx = -1; dx <= 1; dx++)
-            {
-                // Calculate location of tile to check
-                const int x = curr.x + dx;
-                const int y = curr.y + dy;
-
-                // Skip if if we're checking the same tile we're leaving from,
-                // or if the new location falls outside of the map boundaries
-                if ((dx == 0 && dy == 0) || !contains(x, y))
-                {
-                    continue;
-                }
-
-                MetaTile *newTile = getMetaTile(x, y);
-
-                // Skip if the tile is on the closed list or collides unless
-                // its the destination tile
-                if (newTile->whichList == mOnClosedList ||
-                   (tileCollides(x, y) && !(x == destX && y == destY)))
-                {
-                    continue;
-                }
-
-                // When taking a diagonal step, verify that we can skip the
-                // corner. We allow skipping past beings but not past non-
-                // walkable tiles.
-                if (dx != 0 && dy != 0)
-                {
-                    MetaTile *t1 = getMetaTile(curr.x, curr.y + dy);
-                    MetaTile *t2 = getMetaTile(curr.x + dx, curr.y);
-
-                    if (!(t1->walkable && t2->walkable))
-                        continue;
-                }
-
-                // Calculate G cost for this route, 10 for moving straight and
-                // 14 for moving diagonal (sqrt(200) = 14.1421...)
-                int Gcost = curr.tile->Gcost + ((dx == 0 || dy == 0) ? 10 : 14);
-
-                // Skip if Gcost becomes too much
-                // Warning: probably not entirely accurate
-                if (Gcost > 200)
-                    continue;
-
-                if (newTile->whichList != mOnOpenList)
-                {
-                    // Found a new tile (not on open nor on closed list)
-                    // Update Hcost of the new tile using Manhatten distance
-                    newTile->Hcost = 10 * (abs(x - destX) + abs(y - destY));
-
-                    // Set the current tile as the parent of the new tile
-                    newTile->parentX = curr.x;
-                    newTile->parentY = curr.y;
-
-                    // Update Gcost and Fcost of new tile
-                    newTile->Gcost = Gcost;
-                    newTile->Fcost = Gcost + newTile->Hcost;
-
-                    if (x != destX || y != destY)
-                    {
-                        // Add this tile to the open list
-                        newTile->whichList = mOnOpenList;
-                        openList.push(Location(x, y, newTile));
-                    }
-                    else
-                    {
-                        // Target location was found
-                        foundPath = true;
-                    }
-                }
-                else if (Gcost < newTile->Gcost)
-                {
-                    // Found a shorter route.
-                    // Update Gcost and Fcost of the new tile
-                    newTile->Gcost = Gcost;
-                    newTile->Fcost = Gcost + newTile->Hcost;
-
-                    // Set the current tile as the parent of the new tile
-                    newTile->parentX = curr.x;
-                    newTile->parentY = curr.y;
-
-                    // Add this tile to the open list (it's already
-                    // there, but this instance has a lower F score)
-                    openList.push(Location(x, y, newTile));
-                }
-            }
-        }
-    }
-
-    // Two new values to indicate whether a tile is on the open or closed list,
-    // this way we don't have to clear all the values between each pathfinding.
-    mOnClosedList += 2;
-    mOnOpenList += 2;
-
-    // If a path has been found, iterate backwards using the parent locations
-    // to extract it.
-    if (foundPath)
-    {
-        int pathX = destX;
-        int pathY = destY;
-
-        while (pathX != startX || pathY != startY)
-        {
-            // Add the new path node to the start of the path list
-            path.push_front(Position(pathX, pathY));
-
-            // Find out the next parent
-            MetaTile *tile = getMetaTile(pathX, pathY);
-            pathX = tile->parentX;
-            pathY = tile->parentY;
-        }
-    }
+    return mPathFinder->findPath(startX, startY, destX, destY);
+}
 
-    return path;
+Path Map::findExactPath(const int startX, const int startY, const int destX,
+                        const int destY)
+{
+    return mPathFinder->findPath(startX, startY, destX, destY);
 }
 
 void Map::addParticleEffect(const std::string &effectFile, const int x,
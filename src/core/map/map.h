@@ -33,39 +33,53 @@
 
 class Animation;
 class AmbientLayer;
+class BeingGrid;
 class Graphics;
 class Image;
 class MapLayer;
 class Particle;
+class PathCache;
+class PathFinder;
 class SimpleAnimation;
 class Sprite;
+class SpriteOrder;
+class TileChunkCache;
 class Tileset;
 
 typedef std::vector<Tileset*> Tilesets;
-typedef std::list<Sprite*> Sprites;
-typedef Sprites::iterator SpriteIterator;
 typedef std::vector<MapLayer*> Layers;
 
 /**
- * A meta tile stores additional information about a location on a tile map.
- * This is information that doesn't need to be repeated for each tile in each
- * layer of the map.
+ * An area of a map which takes the player to another map.
  */
-struct MetaTile
+struct MapWarp
+{
+    int x, y;                   /**< Top left tile of the area */
+    int width, height;          /**< Size of the area in tiles */
+    std::string destination;    /**< Name of the map it leads to */
+};
+
+typedef std::vector<MapWarp> MapWarps;
+
+/**
+ * A block of TILE_CHUNK_SIZE x TILE_CHUNK_SIZE layer tiles, pre-rendered into
+ * a single image. Tiles taller than the tile grid stick out above the chunk,
+ * which is what the vertical offset accounts for.
+ */
+struct TileChunk
 {
     /**
      * Constructor.
      */
-    MetaTile():whichList(0) {};
-
-    // Pathfinding members
-    int Fcost;               /**< Estimation of total path cost */
-    int Gcost;               /**< Cost from start to this location */
-    int Hcost;               /**< Estimated cost to goal */
-    int whichList;           /**< No list, open list or closed list */
-    int parentX;             /**< X coordinate of parent tile */
-    int parentY;             /**< Y coordinate of parent tile */
-    bool walkable;           /**< Can beings walk on this tile */
+    TileChunk():
+        image(NULL), offsetY(0), lastUsed(0), invalidations(0), dirty(true)
+    {};
+
+    Image *image;            /**< Baked tiles, NULL for empty chunks */
+    int offsetY;             /**< Height the tiles reach above the chunk */
+    int lastUsed;            /**< Tick time the chunk was last drawn at */
+    int invalidations;       /**< Times the chunk was changed after baking */
+    bool dirty;              /**< Whether the image needs to be (re)baked */
 };
 
 /**
@@ -114,32 +128,68 @@ class MapLayer
         /**
          * Set tile image with x + y * width already known.
          */
-        void setTile(const int index, Image *img) { mTiles[index] = img; }
+        void setTile(const int index, Image *img);
 
         /**
          * Get tile image, with x and y in layer coordinates.
          */
         Image *getTile(const int x, const int y) const;
 
+        /**
+         * Sets the cache used to pre-render the tiles of this layer. The
+         * fringe layer is never pre-rendered, since it is interleaved with the
+         * sprites.
+         */
+        void setChunkCache(TileChunkCache *cache);
+
         /**
          * Draws this layer to the given graphics context. The coordinates are
          * expected to be in map range and will be translated to local layer
          * coordinates and clipped to the layer's dimensions.
          *
          * The given sprites are only drawn when this layer is the fringe
-         * layer.
+         * layer. When <code>useChunks</code> is set, the tiles are drawn from
+         * pre-rendered chunks where possible.
          */
         void draw(Graphics *graphics, int startX, int startY,
                   int endX, int endY, int scrollX, int scrollY,
-                  const Sprites &sprites) const;
+                  const SpriteOrder &sprites, const bool useChunks);
 
     private:
+        friend class TileChunkCache;
+
+        /**
+         * Draws the tiles in the given range one by one, with the range in
+         * layer coordinates and already clipped.
+         */
+        void drawTiles(Graphics *graphics, const int startX, const int startY,
+                       const int endX, const int endY, const int scrollX,
+                       const int scrollY) const;
+
+        /**
+         * Draws the given range from pre-rendered chunks, baking the chunks
+         * that aren't available yet as the frame budget allows.
+         */
+        void drawChunks(Graphics *graphics, const int startX,
+                        const int startY, const int endX, const int endY,
+                        const int scrollX, const int scrollY);
+
+        /**
+         * Frees the chunk images that haven't been drawn for a while.
+         */
+        void expireChunks();
+
         int mX, mY;
         int mWidth, mHeight;
         int mTileWidth, mTileHeight;
         bool mIsFringeLayer;    /**< Whether the sprites are drawn. */
         bool mIsVisible;
         Image **mTiles;
+
+        // Pre-rendering data
+        TileChunkCache *mChunkCache;
+        std::vector<TileChunk> mChunks;
+        int mChunksX, mChunksY;
 };
 
 /**
@@ -165,6 +215,12 @@ class Map : public Properties
          */
         void initializeAmbientLayers();
 
+        /**
+         * Builds the hierarchical path cache, when enabled. Has to be called
+         * after the collision layer has been read.
+         */
+        void initializePathCache();
+
         /**
          * Updates animations. Called as needed.
          */
@@ -187,14 +243,14 @@ class Map : public Properties
         void addTileset(Tileset *tileset);
 
         /**
-         * Finds the tile set that a tile with the given global id is part of.
+         * Returns the tilesets of the map, in the order they were added.
          */
-        Tileset *getTilesetWithGid(const int gid) const;
+        const Tilesets &getTilesets() const { return mTilesets; }
 
         /**
-         * Get tile reference.
+         * Finds the tile set that a tile with the given global id is part of.
          */
-        MetaTile *getMetaTile(const int x, const int y);
+        Tileset *getTilesetWithGid(const int gid) const;
 
         /**
          * Set walkability flag for a tile.
@@ -235,15 +291,33 @@ class Map : public Properties
         Path findPath(const int startX, const int startY, const int destX,
                       const int destY);
 
+        /**
+         * Finds the shortest path with a single search of the path finder,
+         * bypassing the path cache, so that the costs the path finder holds
+         * afterwards belong to the tiles along the path.
+         */
+        Path findExactPath(const int startX, const int startY,
+                           const int destX, const int destY);
+
+        /**
+         * Returns the path finder, which holds the state of the last search.
+         */
+        const PathFinder *getPathFinder() const { return mPathFinder; }
+
+        /**
+         * Returns the spatial index of the beings on this map.
+         */
+        BeingGrid *getBeingGrid() const { return mBeingGrid; }
+
         /**
          * Adds a sprite to the map.
          */
-        SpriteIterator addSprite(Sprite *sprite);
+        void addSprite(Sprite *sprite);
 
         /**
          * Removes a sprite from the map.
          */
-        void removeSprite(SpriteIterator iterator);
+        void removeSprite(Sprite *sprite);
 
         /**
          * Adds a particle effect
@@ -256,6 +330,16 @@ class Map : public Properties
          */
         void initializeParticleEffects(Particle* particleEngine);
 
+        /**
+         * Adds an area leading to another map.
+         */
+        void addWarp(const MapWarp &warp) { mWarps.push_back(warp); }
+
+        /**
+         * Returns the areas leading to other maps.
+         */
+        const MapWarps &getWarps() const { return mWarps; }
+
         /**
          * Adds a tile animation to the map
          */
@@ -299,13 +383,13 @@ class Map : public Properties
         int mWidth, mHeight;
         int mTileWidth, mTileHeight;
         int mMaxTileHeight;
-        MetaTile *mMetaTiles;
         Layers mLayers;
         Tilesets mTilesets;
-        Sprites mSprites;
+        SpriteOrder *mSprites;
 
-        // Pathfinding members
-        int mOnClosedList, mOnOpenList;
+        PathFinder *mPathFinder;
+        PathCache *mPathCache;
+        BeingGrid *mBeingGrid;
 
         // Overlay data
         std::list<AmbientLayer*> mBackgrounds;
@@ -322,10 +406,14 @@ class Map : public Properties
         };
         std::list<ParticleEffectData> particleEffects;
 
+        MapWarps mWarps;
+
         ParticleList mParticleList;
 
         std::map<int, TileAnimation*> mTileAnimations;
 
+        TileChunkCache *mChunkCache;
+
 };
 
 #endif
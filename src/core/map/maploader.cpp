@@ -0,0 +1,345 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <SDL.h>
+
+#include "compiledmap.h"
+#include "map.h"
+#include "maploader.h"
+
+#include "../log.h"
+#include "../resourcemanager.h"
+
+#include "../image/image.h"
+
+#include "../utils/dtor.h"
+
+MapLoader::MapLoader():
+    mQueued(SDL_CreateSemaphore(0)),
+    mThread(NULL),
+    mQuit(false)
+{
+    mThread = SDL_CreateThread(MapLoader::workerThread, this);
+
+    if (!mThread)
+        logger->log("Unable to create map loading thread, maps will be "
+                    "loaded on demand");
+}
+
+MapLoader::~MapLoader()
+{
+    if (mThread)
+    {
+        mQuit = true;
+        SDL_SemPost(mQueued);
+        SDL_WaitThread(mThread, NULL);
+    }
+
+    for (Jobs::iterator i = mJobs.begin(); i != mJobs.end(); ++i)
+        deleteJob(*i);
+
+    SDL_DestroySemaphore(mQueued);
+}
+
+void MapLoader::load(const std::string &path)
+{
+    mMutex.lock();
+    Job *job = findJob(path);
+
+    // A failed map is tried again, since the problem may have been fixed
+    if (job && job->state == FAILED)
+    {
+        mJobs.remove(job);
+        deleteJob(job);
+        job = NULL;
+    }
+
+    // Only one map is needed right away, a map that was needed before is
+    // kept around as if it was prefetched
+    for (Jobs::iterator i = mJobs.begin(); i != mJobs.end(); ++i)
+        (*i)->prefetched = true;
+
+    if (!job)
+        job = addJob(path, false);
+
+    job->prefetched = false;
+    dropPrefetched();
+    mMutex.unlock();
+
+    // Without a worker thread, the map has to be read right away
+    if (!mThread && job->state == QUEUED)
+        read(job);
+}
+
+void MapLoader::prefetch(const std::string &path)
+{
+    if (!mThread)
+        return;
+
+    MutexLocker lock(&mMutex);
+
+    if (findJob(path))
+        return;
+
+    logger->log("Prefetching map %s", path.c_str());
+    addJob(path, true);
+    dropPrefetched();
+}
+
+bool MapLoader::isDone(const std::string &path)
+{
+    MutexLocker lock(&mMutex);
+    Job *job = findJob(path);
+
+    return job && (job->state == DONE || job->state == FAILED);
+}
+
+Map *MapLoader::take(const std::string &path)
+{
+    MutexLocker lock(&mMutex);
+    Job *job = findJob(path);
+
+    if (!job || (job->state != DONE && job->state != FAILED))
+        return NULL;
+
+    Map *map = job->map;
+    job->map = NULL;
+
+    mJobs.remove(job);
+    deleteJob(job);
+
+    return map;
+}
+
+void MapLoader::logic()
+{
+    Job *job = NULL;
+
+    // Finish the maps which are needed right away first
+    mMutex.lock();
+    for (Jobs::iterator i = mJobs.begin(); i != mJobs.end(); ++i)
+    {
+        if ((*i)->state == READ && (!job || (job->prefetched &&
+                                             !(*i)->prefetched)))
+        {
+            job = *i;
+        }
+    }
+    mMutex.unlock();
+
+    if (!job)
+        return;
+
+    // Images can only be created on the main thread, and creating them takes
+    // time, so only a few of them are created each frame
+    ResourceManager *resman = ResourceManager::getInstance();
+
+    for (unsigned int n = 0; n < IMAGES_PER_FRAME &&
+         job->created < job->surfaces.size(); n++)
+    {
+        std::pair<std::string, SDL_Surface*> &surface =
+            job->surfaces[job->created++];
+
+        Image *image = resman->getImage(surface.first, surface.second);
+
+        if (image)
+            job->images.push_back(image);
+
+        if (surface.second)
+        {
+            SDL_FreeSurface(surface.second);
+            surface.second = NULL;
+        }
+    }
+
+    if (job->created < job->surfaces.size())
+        return;
+
+    // The cache lives in the write directory, which is only touched from
+    // the main thread
+    if (job->compiledNow)
+        MapReader::storeMap(job->path, *job->compiled, job->checksum);
+
+    // With all tileset images loaded, creating the map only sets the tiles
+    Map *map = job->compiled->createMap();
+
+    for (std::vector<Image*>::iterator i = job->images.begin();
+         i != job->images.end(); ++i)
+    {
+        (*i)->decRef();
+    }
+
+    job->images.clear();
+    job->surfaces.clear();
+    destroy(job->compiled);
+
+    MutexLocker lock(&mMutex);
+    job->map = map;
+    job->state = DONE;
+}
+
+int MapLoader::workerThread(void *data)
+{
+    static_cast<MapLoader*>(data)->work();
+    return 0;
+}
+
+void MapLoader::work()
+{
+    while (true)
+    {
+        SDL_SemWait(mQueued);
+
+        if (mQuit)
+            return;
+
+        Job *job = NULL;
+
+        // Maps needed right away go before prefetched ones
+        mMutex.lock();
+        for (Jobs::iterator i = mJobs.begin(); i != mJobs.end(); ++i)
+        {
+            if ((*i)->state == QUEUED && (!job || (job->prefetched &&
+                                                   !(*i)->prefetched)))
+            {
+                job = *i;
+            }
+        }
+
+        if (job)
+            job->state = READING;
+        mMutex.unlock();
+
+        if (job)
+            read(job);
+    }
+}
+
+void MapLoader::read(Job *job)
+{
+    CompiledMap *compiled = new CompiledMap;
+    Surfaces surfaces;
+    bool compiledNow = false;
+    uint32_t checksum = 0;
+
+    // The settings were taken when the job was queued, so they need no lock
+    const bool success = MapReader::readMap(job->path, job->settings,
+                                            *compiled, compiledNow, checksum);
+
+    if (success)
+    {
+        ResourceManager *resman = ResourceManager::getInstance();
+        const std::vector<CompiledMap::TilesetData> &tilesets =
+            compiled->getTilesets();
+
+        for (unsigned int i = 0; i < tilesets.size(); i++)
+        {
+            SDL_Surface *surface = resman->loadSDLSurface(tilesets[i].image);
+            surfaces.push_back(std::make_pair(tilesets[i].image, surface));
+        }
+    }
+    else
+        destroy(compiled);
+
+    MutexLocker lock(&mMutex);
+    job->compiled = compiled;
+    job->compiledNow = success && compiledNow;
+    job->checksum = checksum;
+    job->surfaces = surfaces;
+    job->state = success ? READ : FAILED;
+}
+
+MapLoader::Job *MapLoader::findJob(const std::string &path)
+{
+    for (Jobs::iterator i = mJobs.begin(); i != mJobs.end(); ++i)
+    {
+        if ((*i)->path == path)
+            return *i;
+    }
+
+    return NULL;
+}
+
+MapLoader::Job *MapLoader::addJob(const std::string &path,
+                                  const bool prefetched)
+{
+    Job *job = new Job;
+    job->path = path;
+    job->state = QUEUED;
+    job->prefetched = prefetched;
+    job->compiled = NULL;
+    job->compiledNow = false;
+    job->checksum = 0;
+    job->created = 0;
+    job->map = NULL;
+    mJobs.push_back(job);
+
+    if (mThread)
+        SDL_SemPost(mQueued);
+
+    return job;
+}
+
+void MapLoader::dropPrefetched()
+{
+    unsigned int prefetched = 0;
+
+    for (Jobs::iterator i = mJobs.begin(); i != mJobs.end(); ++i)
+    {
+        if ((*i)->prefetched)
+            prefetched++;
+    }
+
+    // The worker thread is using the job it's reading, so that one stays
+    Jobs::iterator i = mJobs.begin();
+    while (prefetched > MAX_PREFETCHED && i != mJobs.end())
+    {
+        if ((*i)->prefetched && (*i)->state != READING)
+        {
+            logger->log("Dropping prefetched map %s", (*i)->path.c_str());
+            deleteJob(*i);
+            i = mJobs.erase(i);
+            prefetched--;
+        }
+        else
+            ++i;
+    }
+}
+
+void MapLoader::deleteJob(Job *job)
+{
+    for (Surfaces::iterator i = job->surfaces.begin();
+         i != job->surfaces.end(); ++i)
+    {
+        if (i->second)
+            SDL_FreeSurface(i->second);
+    }
+
+    for (std::vector<Image*>::iterator i = job->images.begin();
+         i != job->images.end(); ++i)
+    {
+        (*i)->decRef();
+    }
+
+    destroy(job->compiled);
+    destroy(job->map);
+    delete job;
+}
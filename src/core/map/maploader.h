@@ -0,0 +1,174 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MAPLOADER_H
+#define MAPLOADER_H
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapreader.h"
+
+#include "../utils/mutex.h"
+
+class CompiledMap;
+class Image;
+class Map;
+
+struct SDL_Surface;
+
+/**
+ * Loads maps in the background. A worker thread reads and decodes the map
+ * files and their tileset images, after which logic() turns them into images
+ * and maps on the main thread, a few images per frame.
+ *
+ * Besides maps which are needed right away, maps which are likely to be
+ * needed soon can be prefetched. Prefetched maps are kept around until they
+ * are taken, or until too many other maps were prefetched.
+ */
+class MapLoader
+{
+    public:
+        /**
+         * Constructor, starts the worker thread.
+         */
+        MapLoader();
+
+        /**
+         * Destructor, waits for the worker thread to finish the map it is
+         * working on and throws away all maps which weren't taken.
+         */
+        ~MapLoader();
+
+        /**
+         * Starts loading the given map file, before any prefetched maps. A map
+         * which was loaded for an earlier call is treated as prefetched from
+         * then on.
+         */
+        void load(const std::string &path);
+
+        /**
+         * Starts loading the given map file when there is nothing else to do.
+         * Does nothing when the map is already being loaded.
+         */
+        void prefetch(const std::string &path);
+
+        /**
+         * Returns whether loading the given map file has finished, either
+         * successfully or not.
+         */
+        bool isDone(const std::string &path);
+
+        /**
+         * Returns the loaded map for the given map file and forgets about it,
+         * or NULL when loading failed or hasn't finished yet.
+         */
+        Map *take(const std::string &path);
+
+        /**
+         * Creates the images and maps of the loaded map files. Should be
+         * called once per frame.
+         */
+        void logic();
+
+    private:
+        enum JobState
+        {
+            QUEUED,         /**< Waiting for the worker thread */
+            READING,        /**< Being read by the worker thread */
+            READ,           /**< Waiting for images to be created */
+            DONE,           /**< Map was created */
+            FAILED          /**< Map couldn't be read */
+        };
+
+        typedef std::vector<std::pair<std::string, SDL_Surface*> > Surfaces;
+
+        struct Job
+        {
+            std::string path;
+            JobState state;
+            bool prefetched;
+            MapReader::Settings settings;   /**< Taken when queued */
+            CompiledMap *compiled;
+            bool compiledNow;           /**< Compiled map needs storing */
+            uint32_t checksum;          /**< Of the map file */
+            Surfaces surfaces;          /**< Loaded tileset images */
+            unsigned int created;       /**< Number of images created */
+            std::vector<Image*> images;
+            Map *map;
+        };
+
+        typedef std::list<Job*> Jobs;
+
+        /**
+         * Entry point of the worker thread.
+         */
+        static int workerThread(void *data);
+
+        /**
+         * Reads queued map files until the loader is destroyed.
+         */
+        void work();
+
+        /**
+         * Reads the map file and tileset images of a job.
+         */
+        void read(Job *job);
+
+        /**
+         * Returns the job for the given map file, or NULL if there is none.
+         * The mutex needs to be locked.
+         */
+        Job *findJob(const std::string &path);
+
+        /**
+         * Adds a job for the given map file, taking the settings for reading
+         * it from the configuration. The mutex needs to be locked.
+         */
+        Job *addJob(const std::string &path, const bool prefetched);
+
+        /**
+         * Throws away the oldest prefetched maps, keeping at most
+         * MAX_PREFETCHED. The mutex needs to be locked.
+         */
+        void dropPrefetched();
+
+        /**
+         * Frees everything a job holds, and the job itself.
+         */
+        static void deleteJob(Job *job);
+
+        /** Maximum number of prefetched maps kept around. */
+        static const unsigned int MAX_PREFETCHED = 3;
+
+        /** Maximum number of tileset images created per frame. */
+        static const unsigned int IMAGES_PER_FRAME = 2;
+
+        Mutex mMutex;
+        SDL_sem *mQueued;           /**< Counts the queued jobs */
+        SDL_Thread *mThread;
+        volatile bool mQuit;
+        Jobs mJobs;
+};
+
+#endif
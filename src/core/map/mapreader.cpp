@@ -20,20 +20,21 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <zlib.h>
 
+#include "compiledmap.h"
+#include "layerdecoder.h"
 #include "map.h"
 #include "mapreader.h"
-#include "tileset.h"
 
+#include "../configuration.h"
 #include "../log.h"
 #include "../resourcemanager.h"
 
-#include "../image/animation.h"
-#include "../image/image.h"
-
 #include "../utils/base64.h"
 #include "../utils/dtor.h"
 #include "../utils/stringutils.h"
@@ -44,19 +45,69 @@
 const unsigned int DEFAULT_TILE_WIDTH = 32;
 const unsigned int DEFAULT_TILE_HEIGHT = 32;
 
+/**
+ * A layer which was read, but whose tile data may still need decoding.
+ */
+struct MapReader::PendingLayer
+{
+    CompiledMap::LayerData layer;
+    int decoderIndex;        /**< Index in the layer decoder, or -1 */
+    bool isCollisionLayer;
+};
+
+MapReader::Settings::Settings():
+    useCache(config.getValue("mapCache", 1) == 1)
+{
+}
+
 Map *MapReader::readMap(const std::string &filename)
+{
+    const Settings settings;
+    CompiledMap compiled;
+    bool compiledNow = false;
+    uint32_t checksum = 0;
+
+    if (!readMap(filename, settings, compiled, compiledNow, checksum))
+        return NULL;
+
+    if (compiledNow)
+        storeMap(filename, compiled, checksum);
+
+    return compiled.createMap();
+}
+
+bool MapReader::readMap(const std::string &filename, const Settings &settings,
+                        CompiledMap &compiled, bool &compiledNow,
+                        uint32_t &checksum)
 {
     logger->log("Attempting to read map %s", filename.c_str());
     // Load the file through resource manager
     ResourceManager *resman = ResourceManager::getInstance();
     int fileSize;
     void *buffer = resman->loadFile(filename, fileSize);
-    Map *map = NULL;
+    bool success = false;
+
+    compiledNow = false;
 
     if (buffer == NULL)
     {
         logger->log("Map file not found (%s)", filename.c_str());
-        return NULL;
+        return false;
+    }
+
+    // Skip parsing and decoding when the map was compiled before. The
+    // compiled map is only used as long as the map file doesn't change.
+    const std::string cacheFile = CompiledMap::getCacheFile(filename);
+    checksum = adler32(adler32(0L, Z_NULL, 0), (const Bytef*) buffer,
+                       fileSize);
+
+    if (settings.useCache && compiled.load(cacheFile, checksum))
+    {
+        free(buffer);
+        logger->log("Using compiled map %s", cacheFile.c_str());
+
+        compiled.setProperty("_filename", filename);
+        return true;
     }
 
     unsigned char *inflated;
@@ -64,16 +115,31 @@ Map *MapReader::readMap(const std::string &filename)
 
     if (filename.find(".gz", filename.length() - 3) != std::string::npos)
     {
-        // Inflate the gzipped map data
+        // Inflate the gzipped map data. The gzip trailer holds the inflated
+        // size, which is only trusted when deflate could have produced it.
+        const unsigned char *bytes = (const unsigned char*) buffer;
+        unsigned int expectedSize = 0;
+
+        if (fileSize >= 18 && bytes[0] == 0x1f && bytes[1] == 0x8b)
+        {
+            expectedSize = bytes[fileSize - 4] |
+                           bytes[fileSize - 3] << 8 |
+                           bytes[fileSize - 2] << 16 |
+                           bytes[fileSize - 1] << 24;
+
+            if (expectedSize / 1032 > (unsigned int) fileSize)
+                expectedSize = 0;
+        }
+
         inflatedSize = inflateMemory((unsigned char*) buffer, fileSize,
-                                     inflated);
+                                     inflated, expectedSize);
         free(buffer);
 
         if (inflated == NULL)
         {
             logger->log("Could not decompress map file (%s)",
                     filename.c_str());
-            return NULL;
+            return false;
         }
     }
     else
@@ -93,18 +159,42 @@ Map *MapReader::readMap(const std::string &filename)
         if (!xmlStrEqual(node->name, BAD_CAST "map"))
             logger->log("Error: Not a map file (%s)!", filename.c_str());
         else
-            map = readMap(node, filename);
+        {
+            readMap(node, filename, compiled);
+
+            compiledNow = settings.useCache;
+            success = true;
+        }
     }
     else
         logger->log("Error while parsing map file (%s)!", filename.c_str());
 
-    if (map)
-        map->setProperty("_filename", filename);
+    if (success)
+        compiled.setProperty("_filename", filename);
 
-    return map;
+    return success;
+}
+
+void MapReader::storeMap(const std::string &filename,
+                         const CompiledMap &compiled, const uint32_t checksum)
+{
+    const std::string cacheFile = CompiledMap::getCacheFile(filename);
+
+    if (!compiled.save(cacheFile, checksum))
+        logger->log("Warning: Could not store compiled map %s",
+                    cacheFile.c_str());
 }
 
 Map *MapReader::readMap(const xmlNodePtr &node, const std::string &path)
+{
+    CompiledMap compiled;
+    readMap(node, path, compiled);
+
+    return compiled.createMap();
+}
+
+void MapReader::readMap(const xmlNodePtr &node, const std::string &path,
+                        CompiledMap &compiled)
 {
     // Take the filename off the path
     const std::string pathDir = path.substr(0, path.rfind("/") + 1);
@@ -113,21 +203,19 @@ Map *MapReader::readMap(const xmlNodePtr &node, const std::string &path)
     const int h = XML::getProperty(node, "height", 0);
     const int tilew = XML::getProperty(node, "tilewidth", DEFAULT_TILE_WIDTH);
     const int tileh = XML::getProperty(node, "tileheight", DEFAULT_TILE_HEIGHT);
-    Map *map = new Map(w, h, tilew, tileh);
+    compiled = CompiledMap(w, h, tilew, tileh);
+
+    LayerDecoder decoder;
+    PendingLayers layers;
 
     for_each_xml_child_node(childNode, node)
     {
         if (xmlStrEqual(childNode->name, BAD_CAST "tileset"))
-        {
-            Tileset *tileset = readTileset(childNode, pathDir, map);
-
-            if (tileset)
-                map->addTileset(tileset);
-        }
+            readTileset(childNode, pathDir, compiled);
         else if (xmlStrEqual(childNode->name, BAD_CAST "layer"))
-            readLayer(childNode, map);
+            readLayer(childNode, compiled, decoder, layers);
         else if (xmlStrEqual(childNode->name, BAD_CAST "properties"))
-            readProperties(childNode, map);
+            readProperties(childNode, &compiled);
         else if (xmlStrEqual(childNode->name, BAD_CAST "objectgroup"))
         {
             // The object group offset is applied to each object individually
@@ -143,8 +231,16 @@ Map *MapReader::readMap(const xmlNodePtr &node, const std::string &path)
                     const std::string objType =
                         XML::getProperty(objectNode, "type", "");
 
-                    if (objType == "WARP" || objType == "NPC" ||
-                        objType == "SCRIPT" || objType == "SPAWN")
+                    if (objType == "WARP")
+                    {
+                        // Remember where warps lead, so that the maps can be
+                        // loaded before the player gets there
+                        readWarp(objectNode, offsetX, offsetY, compiled);
+                        continue;
+                    }
+
+                    if (objType == "NPC" || objType == "SCRIPT" ||
+                        objType == "SPAWN")
                     {
                         // Silently skip server-side objects.
                         continue;
@@ -167,9 +263,11 @@ Map *MapReader::readMap(const xmlNodePtr &node, const std::string &path)
                             continue;
                         }
 
-                        map->addParticleEffect(objName,
-                                               objX + offsetX,
-                                               objY + offsetY);
+                        CompiledMap::EffectData effect;
+                        effect.file = objName;
+                        effect.x = objX + offsetX;
+                        effect.y = objY + offsetY;
+                        compiled.mEffects.push_back(effect);
                     }
                     else
                         logger->log("   Warning: Unknown object type");
@@ -178,9 +276,10 @@ Map *MapReader::readMap(const xmlNodePtr &node, const std::string &path)
         }
     }
 
-    map->initializeAmbientLayers();
-
-    return map;
+    // Decode the layers concurrently, but fill in their tiles here, in the
+    // order in which they were read
+    decoder.decode();
+    addLayers(layers, decoder, compiled);
 }
 
 void MapReader::readProperties(const xmlNodePtr &node, Properties *props)
@@ -199,51 +298,77 @@ void MapReader::readProperties(const xmlNodePtr &node, Properties *props)
     }
 }
 
-static void setTile(Map *map, MapLayer *layer, const int x,
-                    const int y, const int gid)
+void MapReader::readWarp(const xmlNodePtr &node, const int offsetX,
+                         const int offsetY, CompiledMap &compiled)
 {
-    const Tileset* set = map->getTilesetWithGid(gid);
-    if (layer)
-    {
-        // Set regular tile on a layer
-        Image* img = set ? set->get(gid - set->getFirstGid()) : 0;
-        layer->setTile(x, y, img);
-    }
-    else
+    CompiledMap::WarpData warp;
+
+    for_each_xml_child_node(childNode, node)
     {
-        // Set collision tile
-        map->setWalk(x, y, (!set || (gid - set->getFirstGid() == 0)));
+        if (!xmlStrEqual(childNode->name, BAD_CAST "properties"))
+            continue;
+
+        for_each_xml_child_node(propertyNode, childNode)
+        {
+            if (!xmlStrEqual(propertyNode->name, BAD_CAST "property"))
+                continue;
+
+            std::string name = XML::getProperty(propertyNode, "name", "");
+
+            if (toLower(name) == "dest_map")
+                warp.destination = XML::getProperty(propertyNode, "value", "");
+        }
     }
+
+    if (warp.destination.empty())
+        return;
+
+    // Objects are placed in pixels, warps are kept in tiles
+    const int tileWidth = std::max(compiled.mTileWidth, 1);
+    const int tileHeight = std::max(compiled.mTileHeight, 1);
+    const int x = XML::getProperty(node, "x", 0) + offsetX;
+    const int y = XML::getProperty(node, "y", 0) + offsetY;
+    const int width = XML::getProperty(node, "width", 0);
+    const int height = XML::getProperty(node, "height", 0);
+
+    warp.x = x / tileWidth;
+    warp.y = y / tileHeight;
+    warp.width = std::max((x + width) / tileWidth - warp.x, 1);
+    warp.height = std::max((y + height) / tileHeight - warp.y, 1);
+    compiled.mWarps.push_back(warp);
 }
 
-void MapReader::readLayer(const xmlNodePtr &node, Map *map)
+void MapReader::readLayer(const xmlNodePtr &node,
+                          const CompiledMap &compiled,
+                          LayerDecoder &decoder, PendingLayers &layers)
 {
     // Layers are not necessarily the same size as the map
-    const int w = XML::getProperty(node, "width", map->getWidth());
-    const int h = XML::getProperty(node, "height", map->getHeight());
-    const int tw = XML::getProperty(node, "tilewidth", map->getTileWidth());
-    const int th = XML::getProperty(node, "tileheight", map->getTileHeight());
+    const int w = XML::getProperty(node, "width", compiled.mWidth);
+    const int h = XML::getProperty(node, "height", compiled.mHeight);
+    const int tw = XML::getProperty(node, "tilewidth", compiled.mTileWidth);
+    const int th = XML::getProperty(node, "tileheight", compiled.mTileHeight);
     const int offsetX = XML::getProperty(node, "x", 0);
     const int offsetY = XML::getProperty(node, "y", 0);
     std::string name = XML::getProperty(node, "name", "");
     name = toLower(name);
 
-    const bool isFringeLayer = (name.substr(0,6) == "fringe");
-    const bool isCollisionLayer = (name.substr(0,9) == "collision");
-    const bool isVisible = XML::getProperty(node, "visible", 1);
-
-    MapLayer *layer = NULL;
-
-    if (!isCollisionLayer)
-    {
-        layer = new MapLayer(offsetX, offsetY, w, h, tw, th, isFringeLayer,
-                             isVisible);
-        map->addLayer(layer);
-    }
+    layers.push_back(PendingLayer());
+    PendingLayer &pending = layers.back();
+    pending.decoderIndex = -1;
+    pending.isCollisionLayer = (name.substr(0,9) == "collision");
+
+    CompiledMap::LayerData &layer = pending.layer;
+    layer.x = offsetX;
+    layer.y = offsetY;
+    layer.width = w;
+    layer.height = h;
+    layer.tileWidth = tw;
+    layer.tileHeight = th;
+    layer.isFringeLayer = (name.substr(0,6) == "fringe");
+    layer.isVisible = XML::getProperty(node, "visible", 1);
+    layer.gids.resize(w * h, 0);
 
     logger->log("- Loading layer \"%s\"", name.c_str());
-    int x = 0;
-    int y = 0;
 
     // Load the tile data
     for_each_xml_child_node(childNode, node)
@@ -261,93 +386,31 @@ void MapReader::readLayer(const xmlNodePtr &node, Map *map)
             if (!compression.empty() && compression != "gzip")
             {
                 logger->log("Warning: only gzip layer compression supported!");
-                return;
+                break;
             }
 
-            // Read base64 encoded map file
+            // Base64 encoded data is decoded along with the other layers
             xmlNodePtr dataChild = childNode->xmlChildrenNode;
-            if (!dataChild)
-                continue;
- 
-            const int len = strlen((const char*)dataChild->content) + 1;
-            unsigned char *charData = new unsigned char[len + 1];
-            const char *charStart = (const char*)dataChild->content;
-            unsigned char *charIndex = charData;
- 
-            while (*charStart)
+            if (dataChild && dataChild->content)
             {
-                if (*charStart != ' ' && *charStart != '\t' &&
-                    *charStart != '\n')
-                {
-                    *charIndex = *charStart;
-                    charIndex++;
-                }
-                charStart++;
-            }
-            *charIndex = '\0';
-
-            int binLen;
-            unsigned char *binData =
-                php3_base64_decode(charData, strlen((char*) charData), &binLen);
-
-            delete[] charData;
-
-            if (binData)
-            {
-                if (compression == "gzip")
-                {
-                    // Inflate the gzipped layer data
-                    unsigned char *inflated;
-                    unsigned int inflatedSize = inflateMemory(binData, binLen,
-                                                              inflated);
-
-                    free(binData);
-                    binData = inflated;
-                    binLen = inflatedSize;
-
-                    if (!inflated)
-                    {
-                        logger->log("Error: Could not decompress layer!");
-                        return;
-                    }
-                }
-
-                for (int i = 0; i < binLen - 3; i += 4)
-                 {
-                    const int gid = binData[i] |
-                                    binData[i + 1] << 8 |
-                                    binData[i + 2] << 16 |
-                                    binData[i + 3] << 24;
-
-                    setTile(map, layer, x, y, gid);
-
-                    TileAnimation* ani = map->getAnimationForGid(gid);
-                    if (ani)
-                        ani->addAffectedTile(layer, x + y * w);
-
-                    x++;
-                    if (x == w)
-                    {
-                        x = 0; y++;
-
-                        // When we're done, don't crash on too much data
-                        if (y == h)
-                            break;
-                    }
-                }
-                free(binData);
+                pending.decoderIndex =
+                    decoder.add((const char*) dataChild->content,
+                                compression == "gzip", w * h * 4);
             }
         }
         else
         {
+            int x = 0;
+            int y = 0;
+
              // Read plain XML map file
             for_each_xml_child_node(childNode2, childNode)
             {
                 if (!xmlStrEqual(childNode2->name, BAD_CAST "tile"))
                     continue;
 
-                const int gid = XML::getProperty(childNode2, "gid", -1);
-                setTile(map, layer, x, y, gid);
+                layer.gids[x + y * w] = XML::getProperty(childNode2, "gid",
+                                                         -1);
 
                 x++;
                 if (x == w)
@@ -357,22 +420,64 @@ void MapReader::readLayer(const xmlNodePtr &node, Map *map)
                         break;
                 }
             }
+
+            if (y < h || x)
+                std::cerr << "TOO SMALL!\n";
         }
- 
-        if (y < h || x)
-            std::cerr << "TOO SMALL!\n";
- 
+
         // There can be only one data element
         break;
     }
 }
 
-Tileset *MapReader::readTileset(xmlNodePtr node, const std::string &path,
-                                Map *map)
+void MapReader::addLayers(PendingLayers &layers,
+                          const LayerDecoder &decoder,
+                          CompiledMap &compiled)
 {
-    int firstGid = XML::getProperty(node, "firstgid", 0);
+    for (PendingLayers::iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        CompiledMap::LayerData &layer = i->layer;
+        const int tileCount = layer.width * layer.height;
+
+        if (i->decoderIndex != -1)
+        {
+            int binLen;
+            const unsigned char *binData = decoder.getData(i->decoderIndex,
+                                                           binLen);
+
+            // When we're done, don't crash on too much data
+            const int count = binData ? std::min(binLen / 4, tileCount) : 0;
+
+            for (int j = 0; j < count; j++)
+            {
+                layer.gids[j] = binData[j * 4] |
+                                binData[j * 4 + 1] << 8 |
+                                binData[j * 4 + 2] << 16 |
+                                binData[j * 4 + 3] << 24;
+            }
+
+            if (binData && count < tileCount)
+                std::cerr << "TOO SMALL!\n";
+        }
+
+        if (!i->isCollisionLayer)
+        {
+            compiled.mLayers.push_back(layer);
+            continue;
+        }
+
+        for (int j = 0; j < tileCount; j++)
+            compiled.setCollision(j % layer.width, j / layer.width,
+                                  layer.gids[j]);
+    }
+}
+
+void MapReader::readTileset(xmlNodePtr node, const std::string &path,
+                            CompiledMap &compiled)
+{
+    CompiledMap::TilesetData set;
+    set.firstGid = XML::getProperty(node, "firstgid", 0);
     XML::Document* doc = NULL;
-    Tileset *set = NULL;
 
     if (xmlHasProp(node, BAD_CAST "source"))
     {
@@ -381,11 +486,12 @@ Tileset *MapReader::readTileset(xmlNodePtr node, const std::string &path,
                filename.erase(0, 3);  // Remove "../"
         doc = new XML::Document(filename);
         node = doc->rootNode();
-        firstGid += XML::getProperty(node, "firstgid", 0);
+        set.firstGid += XML::getProperty(node, "firstgid", 0);
     }
 
-    const int tw = XML::getProperty(node, "tilewidth", map->getTileWidth());
-    const int th = XML::getProperty(node, "tileheight", map->getTileHeight());
+    set.tileWidth = XML::getProperty(node, "tilewidth", compiled.mTileWidth);
+    set.tileHeight = XML::getProperty(node, "tileheight",
+                                      compiled.mTileHeight);
 
     for_each_xml_child_node(childNode, node)
     {
@@ -395,20 +501,8 @@ Tileset *MapReader::readTileset(xmlNodePtr node, const std::string &path,
 
             if (!source.empty())
             {
-                std::string sourceStr = source;
-                sourceStr.erase(0, 3);  // Remove "../"
-
-                ResourceManager *resman = ResourceManager::getInstance();
-                Image* tilebmp = resman->getImage(sourceStr);
-
-                if (tilebmp)
-                {
-                    set = new Tileset(tilebmp, tw, th, firstGid);
-                    tilebmp->decRef();
-                }
-                else
-                    logger->log("Warning: Failed to load tileset (%s)",
-                                source.c_str());
+                set.image = source;
+                set.image.erase(0, 3);  // Remove "../"
             }
         }
         else if (xmlStrEqual(childNode->name, BAD_CAST "tile"))
@@ -417,7 +511,7 @@ Tileset *MapReader::readTileset(xmlNodePtr node, const std::string &path,
             {
                 if (!xmlStrEqual(tileNode->name, BAD_CAST "properties")) continue;
 
-                int tileGID = firstGid + XML::getProperty(childNode, "id", 0);
+                int tileGID = set.firstGid + XML::getProperty(childNode, "id", 0);
 
                 // read tile properties to a map for simpler handling
                 std::map<std::string, int> tileProperties;
@@ -432,11 +526,9 @@ Tileset *MapReader::readTileset(xmlNodePtr node, const std::string &path,
                     logger->log("Tile Prop of %d \"%s\" = \"%d\"", tileGID, name.c_str(), value);
                 }
 
-                // create animation
-                if (!set)
-                    continue;
-
-                Animation *ani = new Animation();
+                // collect the animation frames
+                CompiledMap::AnimationData ani;
+                ani.gid = tileGID;
                 for (int i = 0; ;i++)
                 {
                     std::map<std::string, int>::iterator iFrame, iDelay;
@@ -444,23 +536,22 @@ Tileset *MapReader::readTileset(xmlNodePtr node, const std::string &path,
                     iDelay = tileProperties.find("animation-delay" + toString(i));
 
                     if (iFrame != tileProperties.end() && iDelay != tileProperties.end())
-                        ani->addFrame(set->get(iFrame->second), iDelay->second, 0, 0);
+                        ani.frames.push_back(std::make_pair(iFrame->second,
+                                                            iDelay->second));
                     else
                         break;
                 }
 
-                if (ani->getLength() > 0)
-                {
-                    map->addAnimation(tileGID, new TileAnimation(ani));
-                    logger->log("Animation length: %d", ani->getLength());
-                }
-                else
-                    destroy(ani);
+                if (!ani.frames.empty())
+                    set.animations.push_back(ani);
             }
         }
     }
 
     destroy(doc);
 
-    return set;
+    if (set.image.empty())
+        return;
+
+    compiled.mTilesets.push_back(set);
 }
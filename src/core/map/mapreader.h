@@ -25,21 +25,70 @@
 
 #include <libxml/tree.h>
 
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class CompiledMap;
+class LayerDecoder;
 class Map;
 class Properties;
-class Tileset;
 
 /**
- * Reader for XML map files (*.tmx)
+ * Reader for XML map files (*.tmx). Maps are compiled into a binary format
+ * the first time they are read, which is stored in the write directory and
+ * used instead of the map file until the map file changes.
  */
 class MapReader
 {
     public:
+        /**
+         * The settings for reading maps. The configuration may only be used
+         * on the main thread, so they are taken from it there and handed to
+         * the thread reading the map.
+         */
+        struct Settings
+        {
+            /**
+             * Constructor, takes the settings from the configuration.
+             */
+            Settings();
+
+            bool useCache;          /**< Whether compiled maps are used */
+        };
+
         /**
          * Read an XML map from a file.
          */
         static Map *readMap(const std::string &filename);
 
+        /**
+         * Read an XML map from a file into the given compiled map, without
+         * loading any of the resources it uses. Unlike the other methods, this
+         * may be called from any thread.
+         *
+         * A map which had to be compiled from the map file isn't stored in
+         * the cache here. Instead <code>checksum</code> is set to the
+         * checksum of the map file and <code>compiledNow</code> to
+         * <code>true</code>, after which storeMap() should be called on the
+         * main thread.
+         *
+         * @return <code>true</code> on success, <code>false</code> otherwise.
+         */
+        static bool readMap(const std::string &filename,
+                            const Settings &settings, CompiledMap &compiled,
+                            bool &compiledNow, uint32_t &checksum);
+
+        /**
+         * Stores a map compiled by readMap() in the cache, so that it doesn't
+         * need to be compiled again until the map file changes. Has to be
+         * called on the main thread.
+         */
+        static void storeMap(const std::string &filename,
+                             const CompiledMap &compiled,
+                             const uint32_t checksum);
+
         /**
          * Read an XML map from a parsed XML tree. The path is used to find the
          * location of referenced tileset images.
@@ -47,6 +96,12 @@ class MapReader
         static Map *readMap(const xmlNodePtr &node, const std::string &path);
 
     private:
+        /**
+         * Reads an XML map from a parsed XML tree into the given compiled map.
+         */
+        static void readMap(const xmlNodePtr &node, const std::string &path,
+                            CompiledMap &compiled);
+
         /**
          * Reads the properties element.
          *
@@ -57,15 +112,37 @@ class MapReader
         static void readProperties(const xmlNodePtr &node, Properties* props);
 
         /**
-         * Reads a map layer and adds it to the given map.
+         * Reads the destination and area of a warp object and adds it to the
+         * given compiled map.
+         */
+        static void readWarp(const xmlNodePtr &node, const int offsetX,
+                             const int offsetY, CompiledMap &compiled);
+
+        struct PendingLayer;
+        typedef std::vector<PendingLayer> PendingLayers;
+
+        /**
+         * Reads a map layer and adds it to the pending layers. Base64 encoded
+         * tile data is queued on the decoder instead of being decoded here.
+         */
+        static void readLayer(const xmlNodePtr &node,
+                              const CompiledMap &compiled,
+                              LayerDecoder &decoder, PendingLayers &layers);
+
+        /**
+         * Fills in the tiles of the pending layers from the decoded data and
+         * adds them to the given compiled map. Collision layers are stored as
+         * collision bits.
          */
-        static void readLayer(const xmlNodePtr &node, Map *map);
+        static void addLayers(PendingLayers &layers,
+                              const LayerDecoder &decoder,
+                              CompiledMap &compiled);
 
         /**
-         * Reads a tile set.
+         * Reads a tile set and adds it to the given compiled map.
          */
-        static Tileset *readTileset(xmlNodePtr node, const std::string &path,
-                                    Map *map);
+        static void readTileset(xmlNodePtr node, const std::string &path,
+                                CompiledMap &compiled);
 
         /**
          * Gets an integer property from an xmlNodePtr.
@@ -0,0 +1,433 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+
+#include "pathcache.h"
+#include "pathfinder.h"
+
+// Passed by reference to std::min, so it needs a definition
+const int PathCache::CLUSTER_SIZE;
+
+PathCache::PathCache(PathFinder *pathFinder):
+    mPathFinder(pathFinder),
+    mWidth(pathFinder->getWidth()),
+    mHeight(pathFinder->getHeight()),
+    mClustersX((mWidth + CLUSTER_SIZE - 1) / CLUSTER_SIZE),
+    mClustersY((mHeight + CLUSTER_SIZE - 1) / CLUSTER_SIZE),
+    mClusters(mClustersX * mClustersY),
+    mEntranceAt(mWidth * mHeight, -1),
+    mDirty(true),
+    mRouteNodes(mWidth * mHeight),
+    mCurrentSearch(0)
+{
+}
+
+void PathCache::invalidate(const int x, const int y)
+{
+    mClusters[getCluster(x + y * mWidth)].dirty = true;
+    mDirty = true;
+}
+
+void PathCache::update()
+{
+    if (!mDirty)
+        return;
+
+    // A changed cluster may also change the entrances of its neighbours
+    std::vector<bool> rebuildCluster(mClusters.size(), false);
+
+    for (int cy = 0; cy < mClustersY; cy++)
+    {
+        for (int cx = 0; cx < mClustersX; cx++)
+        {
+            if (!mClusters[cx + cy * mClustersX].dirty)
+                continue;
+
+            rebuildCluster[cx + cy * mClustersX] = true;
+            if (cx > 0)
+                rebuildCluster[cx - 1 + cy * mClustersX] = true;
+            if (cx + 1 < mClustersX)
+                rebuildCluster[cx + 1 + cy * mClustersX] = true;
+            if (cy > 0)
+                rebuildCluster[cx + (cy - 1) * mClustersX] = true;
+            if (cy + 1 < mClustersY)
+                rebuildCluster[cx + (cy + 1) * mClustersX] = true;
+        }
+    }
+
+    for (int cy = 0; cy < mClustersY; cy++)
+    {
+        for (int cx = 0; cx < mClustersX; cx++)
+        {
+            if (rebuildCluster[cx + cy * mClustersX])
+                rebuild(cx, cy);
+        }
+    }
+
+    mDirty = false;
+}
+
+int PathCache::getCluster(const int tile) const
+{
+    const int x = tile % mWidth;
+    const int y = tile / mWidth;
+    return x / CLUSTER_SIZE + (y / CLUSTER_SIZE) * mClustersX;
+}
+
+void PathCache::getTransitions(const int clusterX, const int clusterY,
+                               const bool vertical,
+                               std::vector<std::pair<int, int> > &transitions)
+                               const
+{
+    // First tile on this side of the border, the step along the border and
+    // the offset to the tile on the other side
+    int x, y, length, step, across;
+
+    if (vertical)
+    {
+        x = (clusterX + 1) * CLUSTER_SIZE - 1;
+        y = clusterY * CLUSTER_SIZE;
+        length = std::min(CLUSTER_SIZE, mHeight - y);
+        step = mWidth;
+        across = 1;
+    }
+    else
+    {
+        x = clusterX * CLUSTER_SIZE;
+        y = (clusterY + 1) * CLUSTER_SIZE - 1;
+        length = std::min(CLUSTER_SIZE, mWidth - x);
+        step = 1;
+        across = mWidth;
+    }
+
+    const int first = x + y * mWidth;
+    int runStart = -1;
+
+    for (int i = 0; i <= length; i++)
+    {
+        if (i < length)
+        {
+            const int tile = first + i * step;
+            const int other = tile + across;
+
+            if (mPathFinder->isWalkable(tile % mWidth, tile / mWidth) &&
+                mPathFinder->isWalkable(other % mWidth, other / mWidth))
+            {
+                if (runStart < 0)
+                    runStart = i;
+                continue;
+            }
+        }
+
+        if (runStart < 0)
+            continue;
+
+        // Narrow entrances get a transition in the middle, wide ones at
+        // both ends
+        const int runLength = i - runStart;
+
+        if (runLength < WIDE_ENTRANCE)
+        {
+            const int tile = first + (runStart + runLength / 2) * step;
+            transitions.push_back(std::make_pair(tile, tile + across));
+        }
+        else
+        {
+            const int startTile = first + runStart * step;
+            const int endTile = first + (i - 1) * step;
+            transitions.push_back(std::make_pair(startTile,
+                                                 startTile + across));
+            transitions.push_back(std::make_pair(endTile, endTile + across));
+        }
+
+        runStart = -1;
+    }
+}
+
+void PathCache::rebuild(const int clusterX, const int clusterY)
+{
+    const int index = clusterX + clusterY * mClustersX;
+    Cluster &cluster = mClusters[index];
+
+    for (Entrances::const_iterator i = cluster.entrances.begin();
+         i != cluster.entrances.end(); ++i)
+    {
+        mEntranceAt[i->tile] = -1;
+    }
+
+    cluster.entrances.clear();
+
+    // Collect the transitions on all four borders, with the tile inside this
+    // cluster first
+    std::vector<std::pair<int, int> > transitions;
+    std::vector<std::pair<int, int> > neighbourTransitions;
+
+    if (clusterX + 1 < mClustersX)
+        getTransitions(clusterX, clusterY, true, transitions);
+    if (clusterY + 1 < mClustersY)
+        getTransitions(clusterX, clusterY, false, transitions);
+    if (clusterX > 0)
+        getTransitions(clusterX - 1, clusterY, true, neighbourTransitions);
+    if (clusterY > 0)
+        getTransitions(clusterX, clusterY - 1, false, neighbourTransitions);
+
+    for (size_t i = 0; i < neighbourTransitions.size(); i++)
+    {
+        transitions.push_back(std::make_pair(neighbourTransitions[i].second,
+                                             neighbourTransitions[i].first));
+    }
+
+    for (size_t i = 0; i < transitions.size(); i++)
+    {
+        const int tile = transitions[i].first;
+
+        if (mEntranceAt[tile] < 0)
+        {
+            mEntranceAt[tile] = cluster.entrances.size();
+            cluster.entrances.push_back(Entrance(tile));
+        }
+
+        cluster.entrances[mEntranceAt[tile]].edges.push_back(
+                Edge(transitions[i].second, 10));
+    }
+
+    // Connect the entrances within the cluster
+    for (size_t i = 0; i < cluster.entrances.size(); i++)
+    {
+        for (size_t j = i + 1; j < cluster.entrances.size(); j++)
+        {
+            Entrance &a = cluster.entrances[i];
+            Entrance &b = cluster.entrances[j];
+            const int cost = getCost(index, a.tile, b.tile);
+
+            if (cost >= 0)
+            {
+                a.edges.push_back(Edge(b.tile, cost));
+                b.edges.push_back(Edge(a.tile, cost));
+            }
+        }
+    }
+
+    cluster.dirty = false;
+}
+
+Path PathCache::findLocalPath(const int cluster, const int from, const int to)
+{
+    const int areaX = (cluster % mClustersX) * CLUSTER_SIZE;
+    const int areaY = (cluster / mClustersX) * CLUSTER_SIZE;
+
+    return mPathFinder->findPath(from % mWidth, from / mWidth,
+                                 to % mWidth, to / mWidth,
+                                 areaX, areaY, CLUSTER_SIZE, CLUSTER_SIZE);
+}
+
+int PathCache::getCost(const int cluster, const int from, const int to)
+{
+    if (from == to)
+        return 0;
+
+    if (findLocalPath(cluster, from, to).empty())
+        return -1;
+
+    return mPathFinder->getCost(to % mWidth, to / mWidth);
+}
+
+const PathCache::Entrance *PathCache::getEntrance(const int tile) const
+{
+    const int entrance = mEntranceAt[tile];
+
+    if (entrance < 0)
+        return NULL;
+
+    return &mClusters[getCluster(tile)].entrances[entrance];
+}
+
+void PathCache::addRouteNode(const int tile, const int parent,
+                             const int Gcost, const int destX,
+                             const int destY)
+{
+    RouteNode &node = mRouteNodes[tile];
+
+    if (node.search == mCurrentSearch && (node.closed || node.Gcost <= Gcost))
+        return;
+
+    node.search = mCurrentSearch;
+    node.Gcost = Gcost;
+    node.parent = parent;
+    node.closed = false;
+
+    const int Fcost = Gcost + PathFinder::heuristic(tile % mWidth,
+                                                    tile / mWidth,
+                                                    destX, destY);
+    mOpenList.push(std::make_pair(-Fcost, tile));
+}
+
+bool PathCache::findRoute(const int start, const int dest,
+                          std::vector<int> &route)
+{
+    const int startCluster = getCluster(start);
+    const int destCluster = getCluster(dest);
+    const int destX = dest % mWidth;
+    const int destY = dest / mWidth;
+
+    // Connect the start and the destination to the entrances of their
+    // clusters
+    Edges startEdges;
+    std::vector<int> destCosts;
+
+    const Entrances &startEntrances = mClusters[startCluster].entrances;
+    for (Entrances::const_iterator i = startEntrances.begin();
+         i != startEntrances.end(); ++i)
+    {
+        const int cost = getCost(startCluster, start, i->tile);
+        if (cost > 0)
+            startEdges.push_back(Edge(i->tile, cost));
+    }
+
+    const Entrances &destEntrances = mClusters[destCluster].entrances;
+    bool reachable = false;
+    for (Entrances::const_iterator i = destEntrances.begin();
+         i != destEntrances.end(); ++i)
+    {
+        destCosts.push_back(getCost(destCluster, i->tile, dest));
+        reachable = reachable || destCosts.back() >= 0;
+    }
+
+    if (!reachable)
+        return false;
+
+    // A* over the entrance graph, the open list holds (-Fcost, tile) pairs
+    if (++mCurrentSearch == 0)
+    {
+        std::fill(mRouteNodes.begin(), mRouteNodes.end(), RouteNode());
+        mCurrentSearch = 1;
+    }
+
+    while (!mOpenList.empty())
+        mOpenList.pop();
+
+    addRouteNode(start, start, 0, destX, destY);
+
+    while (!mOpenList.empty())
+    {
+        const int tile = mOpenList.top().second;
+        mOpenList.pop();
+
+        RouteNode &node = mRouteNodes[tile];
+        if (node.closed)
+            continue;
+
+        node.closed = true;
+
+        if (tile == dest)
+        {
+            for (int t = dest; t != start; t = mRouteNodes[t].parent)
+                route.push_back(t);
+            route.push_back(start);
+            std::reverse(route.begin(), route.end());
+            return true;
+        }
+
+        if (tile == start)
+        {
+            for (Edges::const_iterator i = startEdges.begin();
+                 i != startEdges.end(); ++i)
+            {
+                addRouteNode(i->tile, tile, node.Gcost + i->cost, destX,
+                             destY);
+            }
+        }
+
+        const Entrance *entrance = getEntrance(tile);
+        if (!entrance)
+            continue;
+
+        for (Edges::const_iterator i = entrance->edges.begin();
+             i != entrance->edges.end(); ++i)
+        {
+            addRouteNode(i->tile, tile, node.Gcost + i->cost, destX, destY);
+        }
+
+        if (getCluster(tile) == destCluster)
+        {
+            const int cost = destCosts[mEntranceAt[tile]];
+            if (cost >= 0)
+                addRouteNode(dest, tile, node.Gcost + cost, destX, destY);
+        }
+    }
+
+    return false;
+}
+
+Path PathCache::findPath(const int startX, const int startY, const int destX,
+                         const int destY)
+{
+    update();
+
+    if (startX < 0 || startY < 0 || startX >= mWidth || startY >= mHeight ||
+        destX < 0 || destY < 0 || destX >= mWidth || destY >= mHeight)
+    {
+        return Path();
+    }
+
+    const int start = startX + startY * mWidth;
+    const int dest = destX + destY * mWidth;
+
+    // Short paths are cheaper to search directly
+    if (getCluster(start) == getCluster(dest) ||
+        PathFinder::heuristic(startX, startY, destX, destY) <
+        20 * CLUSTER_SIZE)
+    {
+        return mPathFinder->findPath(startX, startY, destX, destY);
+    }
+
+    std::vector<int> route;
+    if (!findRoute(start, dest, route))
+    {
+        // A blocked destination may only be reachable from a neighbouring
+        // cluster, which the entrance graph doesn't know about
+        if (!mPathFinder->isWalkable(destX, destY))
+            return mPathFinder->findPath(startX, startY, destX, destY);
+
+        return Path();
+    }
+
+    // Refine the route, each leg stays within a single cluster
+    Path path;
+
+    for (size_t i = 1; i < route.size(); i++)
+    {
+        const int from = route[i - 1];
+        const int to = route[i];
+
+        if (getCluster(from) != getCluster(to))
+        {
+            path.push_back(Position(to % mWidth, to / mWidth));
+            continue;
+        }
+
+        Path leg = findLocalPath(getCluster(from), from, to);
+        path.splice(path.end(), leg);
+    }
+
+    return path;
+}
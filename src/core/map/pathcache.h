@@ -0,0 +1,178 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <queue>
+#include <vector>
+
+#include "position.h"
+
+class PathFinder;
+
+/**
+ * Hierarchical path finding (HPA*). The map is divided into square clusters
+ * and the walkable connections between neighbouring clusters are turned into
+ * entrance nodes. The costs between the entrances of each cluster are
+ * precomputed, so a long path is found by searching the small graph of
+ * entrances first. Only the resulting legs, each of which stays within a
+ * single cluster, are then searched tile by tile.
+ *
+ * The paths found are close to, but not always exactly, the shortest ones.
+ */
+class PathCache
+{
+    public:
+        /**
+         * Constructor. The cache reads the walkability of the tiles from the
+         * given path finder, which it also uses to search within clusters.
+         */
+        PathCache(PathFinder *pathFinder);
+
+        /**
+         * Marks the cluster containing the given tile for rebuilding, after
+         * the walkability of the tile has changed.
+         */
+        void invalidate(const int x, const int y);
+
+        /**
+         * Rebuilds the entrances and costs of all changed clusters.
+         */
+        void update();
+
+        /**
+         * Finds a path from one location to the next. Short paths are passed
+         * straight on to the path finder.
+         */
+        Path findPath(const int startX, const int startY, const int destX,
+                      const int destY);
+
+    private:
+        struct Edge
+        {
+            Edge(int tile, int cost): tile(tile), cost(cost) {}
+
+            int tile;                /**< Tile of the connected entrance */
+            int cost;                /**< Cost of walking there */
+        };
+
+        typedef std::vector<Edge> Edges;
+
+        struct Entrance
+        {
+            Entrance(int tile): tile(tile) {}
+
+            int tile;
+            Edges edges;
+        };
+
+        typedef std::vector<Entrance> Entrances;
+
+        struct Cluster
+        {
+            Cluster(): dirty(true) {}
+
+            Entrances entrances;
+            bool dirty;
+        };
+
+        /**
+         * Returns the index of the cluster containing the given tile.
+         */
+        int getCluster(const int tile) const;
+
+        /**
+         * Adds the transitions on the border between a cluster and its right
+         * (<code>vertical</code> set) or lower neighbour. Each transition is
+         * a pair of tiles, the first on the side of the given cluster.
+         */
+        void getTransitions(const int clusterX, const int clusterY,
+                            const bool vertical,
+                            std::vector<std::pair<int, int> > &transitions)
+                            const;
+
+        /**
+         * Recomputes the entrances of a cluster and the edges between them.
+         */
+        void rebuild(const int clusterX, const int clusterY);
+
+        /**
+         * Returns the cost of walking between two tiles without leaving the
+         * cluster, or -1 if that's not possible.
+         */
+        int getCost(const int cluster, const int from, const int to);
+
+        /**
+         * Finds a path between two tiles without leaving the cluster.
+         */
+        Path findLocalPath(const int cluster, const int from, const int to);
+
+        /**
+         * Searches the entrance graph for a route between two tiles in
+         * different clusters. The route includes both the start and the
+         * destination tile.
+         */
+        bool findRoute(const int start, const int dest,
+                       std::vector<int> &route);
+
+        /**
+         * Returns the entrance at the given tile, or NULL if there is none.
+         */
+        const Entrance *getEntrance(const int tile) const;
+
+        /**
+         * Puts a node on the open list of the route search, unless it was
+         * already reached more cheaply.
+         */
+        void addRouteNode(const int tile, const int parent, const int Gcost,
+                          const int destX, const int destY);
+
+        /** Width and height of a cluster in tiles. */
+        static const int CLUSTER_SIZE = 10;
+
+        /** Entrances at least this wide get a transition at both ends. */
+        static const int WIDE_ENTRANCE = 6;
+
+        struct RouteNode
+        {
+            RouteNode(): search(0) {}
+
+            int Gcost;               /**< Cost from start to this node */
+            int parent;              /**< Tile of the previous node */
+            unsigned int search;     /**< Search the node belongs to */
+            bool closed;             /**< Whether it has been expanded */
+        };
+
+        PathFinder *mPathFinder;
+        int mWidth, mHeight;
+        int mClustersX, mClustersY;
+        std::vector<Cluster> mClusters;
+        std::vector<int> mEntranceAt;      /**< Entrance index, by tile */
+        bool mDirty;
+
+        // Route search state, indexed by tile
+        std::vector<RouteNode> mRouteNodes;
+        std::priority_queue<std::pair<int, int> > mOpenList;
+        unsigned int mCurrentSearch;
+};
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "pathfinder.h"
+
+PathFinder::PathFinder(const int width, const int height):
+    mWidth(width), mHeight(height),
+    mWalkable((width * height + 31) / 32, 0xFFFFFFFF),
+    mGcost(width * height),
+    mFcost(width * height),
+    mParent(width * height),
+    mHeapPos(width * height),
+    mSearch(width * height, 0),
+    mCurrentSearch(0),
+    mExpandedNodes(0)
+{
+}
+
+void PathFinder::setWalkable(const int x, const int y, const bool walkable)
+{
+    const int index = x + y * mWidth;
+
+    if (walkable)
+        mWalkable[index >> 5] |= 1u << (index & 31);
+    else
+        mWalkable[index >> 5] &= ~(1u << (index & 31));
+}
+
+int PathFinder::getCost(const int x, const int y) const
+{
+    if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
+        return -1;
+
+    const int tile = x + y * mWidth;
+    return mSearch[tile] == mCurrentSearch ? mGcost[tile] : -1;
+}
+
+int PathFinder::heuristic(const int x, const int y, const int destX,
+                          const int destY)
+{
+    // Octile distance: diagonal steps first, then straight ones
+    const int dx = abs(x - destX);
+    const int dy = abs(y - destY);
+    return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+}
+
+Path PathFinder::findPath(const int startX, const int startY, const int destX,
+                          const int destY)
+{
+    return findPath(startX, startY, destX, destY, 0, 0, mWidth, mHeight);
+}
+
+Path PathFinder::findPath(const int startX, const int startY, const int destX,
+                          const int destY, const int areaX, const int areaY,
+                          const int areaWidth, const int areaHeight)
+{
+    // Path to be built up (empty by default)
+    Path path;
+    mExpandedNodes = 0;
+
+    const int minX = std::max(areaX, 0);
+    const int minY = std::max(areaY, 0);
+    const int maxX = std::min(areaX + areaWidth, mWidth);
+    const int maxY = std::min(areaY + areaHeight, mHeight);
+
+    if (startX < minX || startY < minY || startX >= maxX || startY >= maxY ||
+        destX < minX || destY < minY || destX >= maxX || destY >= maxY)
+    {
+        return path;
+    }
+
+    // Tag the state of this search, so that the state of earlier searches is
+    // recognized as stale without having to clear it.
+    if (++mCurrentSearch == 0)
+    {
+        std::fill(mSearch.begin(), mSearch.end(), 0);
+        mCurrentSearch = 1;
+    }
+
+    mHeap.clear();
+
+    const int start = startX + startY * mWidth;
+    const int dest = destX + destY * mWidth;
+
+    mSearch[start] = mCurrentSearch;
+    mGcost[start] = 0;
+    mFcost[start] = heuristic(startX, startY, destX, destY);
+    mParent[start] = start;
+    heapPush(start);
+
+    bool foundPath = false;
+
+    while (!mHeap.empty())
+    {
+        const int curr = heapPop();
+        mHeapPos[curr] = CLOSED;
+
+        if (curr == dest)
+        {
+            foundPath = true;
+            break;
+        }
+
+        mExpandedNodes++;
+
+        const int currX = curr % mWidth;
+        const int currY = curr / mWidth;
+
+        // Check the adjacent tiles
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            const int y = currY + dy;
+            if (y < minY || y >= maxY)
+                continue;
+
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                const int x = currX + dx;
+                if ((dx == 0 && dy == 0) || x < minX || x >= maxX)
+                    continue;
+
+                const int tile = x + y * mWidth;
+                const bool visited = mSearch[tile] == mCurrentSearch;
+
+                // Skip if the tile is closed or collides, unless it is the
+                // destination tile
+                if ((visited && mHeapPos[tile] == CLOSED) ||
+                    (tile != dest && !isWalkable(x, y)))
+                {
+                    continue;
+                }
+
+                // When taking a diagonal step, verify that we can skip the
+                // corner. We allow skipping past beings but not past non-
+                // walkable tiles.
+                if (dx != 0 && dy != 0 &&
+                    !(isWalkable(currX, y) && isWalkable(x, currY)))
+                {
+                    continue;
+                }
+
+                const int Gcost = mGcost[curr] + ((dx == 0 || dy == 0) ? 10
+                                                                      : 14);
+
+                if (!visited)
+                {
+                    mSearch[tile] = mCurrentSearch;
+                    mGcost[tile] = Gcost;
+                    mFcost[tile] = Gcost + heuristic(x, y, destX, destY);
+                    mParent[tile] = curr;
+                    heapPush(tile);
+                }
+                else if (Gcost < mGcost[tile])
+                {
+                    // Found a shorter route to a tile on the open list
+                    mFcost[tile] -= mGcost[tile] - Gcost;
+                    mGcost[tile] = Gcost;
+                    mParent[tile] = curr;
+                    heapSiftUp(mHeapPos[tile]);
+                }
+            }
+        }
+    }
+
+    // If a path has been found, iterate backwards using the parent locations
+    // to extract it.
+    if (foundPath)
+    {
+        for (int tile = dest; tile != start; tile = mParent[tile])
+            path.push_front(Position(tile % mWidth, tile / mWidth));
+    }
+
+    return path;
+}
+
+void PathFinder::heapPush(const int tile)
+{
+    mHeapPos[tile] = mHeap.size();
+    mHeap.push_back(tile);
+    heapSiftUp(mHeap.size() - 1);
+}
+
+int PathFinder::heapPop()
+{
+    const int top = mHeap.front();
+
+    mHeap.front() = mHeap.back();
+    mHeapPos[mHeap.front()] = 0;
+    mHeap.pop_back();
+
+    if (!mHeap.empty())
+        heapSiftDown(0);
+
+    return top;
+}
+
+void PathFinder::heapSiftUp(int pos)
+{
+    const int tile = mHeap[pos];
+
+    while (pos > 0)
+    {
+        const int parent = (pos - 1) / 2;
+        if (!before(tile, mHeap[parent]))
+            break;
+
+        mHeap[pos] = mHeap[parent];
+        mHeapPos[mHeap[pos]] = pos;
+        pos = parent;
+    }
+
+    mHeap[pos] = tile;
+    mHeapPos[tile] = pos;
+}
+
+void PathFinder::heapSiftDown(int pos)
+{
+    const int size = mHeap.size();
+    const int tile = mHeap[pos];
+
+    for (;;)
+    {
+        int child = 2 * pos + 1;
+        if (child >= size)
+            break;
+
+        if (child + 1 < size && before(mHeap[child + 1], mHeap[child]))
+            child++;
+
+        if (!before(mHeap[child], tile))
+            break;
+
+        mHeap[pos] = mHeap[child];
+        mHeapPos[mHeap[pos]] = pos;
+        pos = child;
+    }
+
+    mHeap[pos] = tile;
+    mHeapPos[tile] = pos;
+}
@@ -0,0 +1,137 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "position.h"
+
+/**
+ * A* path finding on a tile grid. Walkability is stored as a packed bitset and
+ * the search state lives in separate per-tile arrays which are reused between
+ * searches, so a query doesn't need to allocate or clear anything.
+ *
+ * Moving straight costs 10 and moving diagonally costs 14. Diagonal moves are
+ * only allowed when both tiles next to the corner are walkable.
+ */
+class PathFinder
+{
+    public:
+        /**
+         * Constructor. All tiles start out walkable.
+         */
+        PathFinder(const int width, const int height);
+
+        /**
+         * Sets whether a tile can be walked on.
+         */
+        void setWalkable(const int x, const int y, const bool walkable);
+
+        /**
+         * Tells whether a tile can be walked on. The coordinates have to be
+         * inside the grid.
+         */
+        bool isWalkable(const int x, const int y) const
+        {
+            const int index = x + y * mWidth;
+            return (mWalkable[index >> 5] >> (index & 31)) & 1;
+        }
+
+        /**
+         * Finds the shortest path between two tiles. The destination tile
+         * doesn't need to be walkable itself. Returns an empty path when the
+         * destination can't be reached.
+         */
+        Path findPath(const int startX, const int startY, const int destX,
+                      const int destY);
+
+        /**
+         * Finds the shortest path between two tiles without leaving the given
+         * area of the grid.
+         */
+        Path findPath(const int startX, const int startY, const int destX,
+                      const int destY, const int areaX, const int areaY,
+                      const int areaWidth, const int areaHeight);
+
+        /**
+         * Returns the cost from the start to the given tile as found by the
+         * last search, or -1 if the last search didn't reach the tile.
+         */
+        int getCost(const int x, const int y) const;
+
+        /**
+         * Returns the number of tiles expanded by the last search.
+         */
+        int getExpandedNodes() const { return mExpandedNodes; }
+
+        /**
+         * Returns the width of the grid in tiles.
+         */
+        int getWidth() const { return mWidth; }
+
+        /**
+         * Returns the height of the grid in tiles.
+         */
+        int getHeight() const { return mHeight; }
+
+        /**
+         * Estimated cost between two tiles, assuming nothing is in the way.
+         */
+        static int heuristic(const int x, const int y, const int destX,
+                             const int destY);
+
+    private:
+        /**
+         * Tells whether tile a should be expanded before tile b.
+         */
+        bool before(const int a, const int b) const
+        {
+            return mFcost[a] < mFcost[b] ||
+                  (mFcost[a] == mFcost[b] && mGcost[a] > mGcost[b]);
+        }
+
+        void heapPush(const int tile);
+        int heapPop();
+        void heapSiftUp(int pos);
+        void heapSiftDown(int pos);
+
+        /** Heap position of tiles that have been expanded already. */
+        static const int CLOSED = -1;
+
+        int mWidth, mHeight;
+        std::vector<uint32_t> mWalkable;
+
+        // Search state, indexed by tile
+        std::vector<int> mGcost;
+        std::vector<int> mFcost;
+        std::vector<int> mParent;
+        std::vector<int> mHeapPos;         /**< Open list position or CLOSED */
+        std::vector<unsigned int> mSearch; /**< Search the state belongs to */
+
+        std::vector<int> mHeap;            /**< Open list, a binary heap */
+        unsigned int mCurrentSearch;
+        int mExpandedNodes;
+};
+
+#endif
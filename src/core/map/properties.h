@@ -33,6 +33,8 @@
 class Properties
 {
     public:
+        typedef std::map<std::string, std::string> PropertyMap;
+
         /**
          * Destructor.
          */
@@ -97,8 +99,15 @@ class Properties
             mProperties[name] = value;
         }
 
+        /**
+         * Returns all properties.
+         */
+        const PropertyMap &getProperties() const
+        {
+            return mProperties;
+        }
+
     private:
-        typedef std::map<std::string, std::string> PropertyMap;
         PropertyMap mProperties;
 };
 
@@ -48,6 +48,7 @@
 #include "../../../core/configuration.h"
 #include "../../../core/log.h"
 
+#include "../../../core/map/beinggrid.h"
 #include "../../../core/map/map.h"
 
 #include "../../../core/utils/dtor.h"
@@ -79,6 +80,7 @@ Being::Being(const int id, const int job, Map *map):
     mWalkSpeed(150),
     mDirection(DOWN),
     mMap(NULL),
+    mGridX(0), mGridY(0),
     mName(""),
     mEquippedWeapon(NULL),
     mHairStyle(1), mHairColor(0),
@@ -276,7 +278,10 @@ void Being::setMap(Map *map)
 {
     // Remove sprite from potential previous map
     if (mMap)
-        mMap->removeSprite(mSpriteIterator);
+    {
+        mMap->removeSprite(this);
+        mMap->getBeingGrid()->remove(this, mGridX, mGridY);
+    }
 
     mMap = map;
 
@@ -285,12 +290,30 @@ void Being::setMap(Map *map)
 
     // Add sprite to potential new map
     if (mMap)
-        mSpriteIterator = mMap->addSprite(this);
+    {
+        mMap->addSprite(this);
+        mMap->getBeingGrid()->add(this, mX, mY);
+        mGridX = mX;
+        mGridY = mY;
+    }
 
     // Clear particle effect list because child particles became invalid
     mChildParticleEffects.clear();
 }
 
+void Being::setTileCoords(const uint16_t x, const uint16_t y)
+{
+    mX = x;
+    mY = y;
+
+    if (mMap)
+    {
+        mMap->getBeingGrid()->move(this, mGridX, mGridY, mX, mY);
+        mGridX = mX;
+        mGridY = mY;
+    }
+}
+
 void Being::controlParticle(Particle *particle)
 {
     mChildParticleEffects.addLocally(particle);
@@ -404,8 +427,7 @@ void Being::nextStep()
         return;
     }
 
-    mX = pos.x;
-    mY = pos.y;
+    setTileCoords(pos.x, pos.y);
     setAction(WALK);
     mWalkTime += mWalkSpeed / 10;
 }
@@ -586,8 +608,8 @@ const int Being::getXOffset() const
     if (mAction != WALK || !(mDirection & (LEFT | RIGHT)))
         return 0;
 
-    int offset = (get_elapsed_time(mWalkTime) * mMap->getTileWidth()) /
-                 mWalkSpeed;
+    int offset = (int) (get_interpolated_time(mWalkTime) *
+                        mMap->getTileWidth() / mWalkSpeed);
 
     // We calculate the offset _from_ the _target_ location
     offset -= mMap->getTileWidth();
@@ -607,8 +629,8 @@ const int Being::getYOffset() const
     if (mAction != WALK || !(mDirection & (UP | DOWN)))
         return 0;
 
-    int offset = (get_elapsed_time(mWalkTime) * mMap->getTileHeight()) /
-                 mWalkSpeed;
+    int offset = (int) (get_interpolated_time(mWalkTime) *
+                        mMap->getTileHeight() / mWalkSpeed);
 
     // We calculate the offset _from_ the _target_ location
     offset -= mMap->getTileHeight();
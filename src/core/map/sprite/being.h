@@ -55,9 +55,6 @@ class SimpleAnimation;
 class SpeechBubble;
 class Text;
 
-typedef std::list<Sprite*> Sprites;
-typedef Sprites::iterator SpriteIterator;
-
 enum Gender
 {
     GENDER_MALE = 0,
@@ -308,6 +305,13 @@ class Being : public Sprite
          */
         virtual void setMap(Map *map);
 
+        /**
+         * Sets the tile the being is standing on. Always use this instead of
+         * changing mX and mY directly, so the map can keep track of where
+         * its beings are.
+         */
+        void setTileCoords(const uint16_t x, const uint16_t y);
+
         /**
          * Sets the current action.
          */
@@ -420,8 +424,8 @@ class Being : public Sprite
         uint16_t mWalkSpeed;              /**< Walking speed */
         uint8_t mDirection;               /**< Facing direction */
         Map *mMap;                      /**< Map on which this being resides */
+        uint16_t mGridX, mGridY;        /**< Tile known to the being grid */
         std::string mName;              /**< Name of character */
-        SpriteIterator mSpriteIterator;
 
         /** Engine-related infos about weapon. */
         const ItemInfo* mEquippedWeapon;
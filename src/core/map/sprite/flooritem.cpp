@@ -41,13 +41,13 @@ FloorItem::FloorItem(const int id, const int itemId, const int x,
     mItem = new Item(itemId);
 
     // Add ourselves to the map
-    mSpriteIterator = mMap->addSprite(this);
+    mMap->addSprite(this);
 }
 
 FloorItem::~FloorItem()
 {
     // Remove ourselves from the map
-    mMap->removeSprite(mSpriteIterator);
+    mMap->removeSprite(this);
 
     destroy(mItem);
 }
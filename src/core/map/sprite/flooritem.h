@@ -23,8 +23,6 @@
 #ifndef FLOORITEM_H
 #define FLOORITEM_H
 
-#include <list>
-
 #include "sprite.h"
 
 #include "../map.h"
@@ -33,8 +31,6 @@ class Graphics;
 class Image;
 class Item;
 
-typedef std::list<Sprite*> Sprites;
-
 /**
  * An item lying on the floor.
  */
@@ -97,7 +93,6 @@ class FloorItem : public Sprite
         int mId;
         int mX, mY;
         Item *mItem;
-        Sprites::iterator mSpriteIterator;
         Map *mMap;
 };
 
@@ -32,6 +32,11 @@ class Graphics;
 class Sprite
 {
     public:
+        /**
+         * Constructor.
+         */
+        Sprite(): mOrderRow(-1), mOrderIndex(-1) {}
+
         /**
          * Destructor.
          */
@@ -63,6 +68,12 @@ class Sprite
          * Returns the pixel Y coordinate of the sprite.
          */
         virtual const int getPixelY() const = 0;
+
+    private:
+        friend class SpriteOrder;
+
+        int mOrderRow;      /**< Row of the sprite in the map's sprite order */
+        int mOrderIndex;    /**< Position of the sprite within that row */
 };
 
 #endif
@@ -0,0 +1,169 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstddef>
+
+#include "spriteorder.h"
+
+#include "sprite/sprite.h"
+
+void SpriteOrder::const_iterator::skipEmpty()
+{
+    while (mRow < mRows->size())
+    {
+        const Row &row = (*mRows)[mRow];
+
+        if (mIndex >= row.size())
+        {
+            mRow++;
+            mIndex = 0;
+        }
+        else if (!row[mIndex].sprite)
+            mIndex++;
+        else
+            break;
+    }
+}
+
+SpriteOrder::SpriteOrder(const int height, const int tileHeight):
+    mTileHeight(tileHeight > 0 ? tileHeight : 1),
+    mRows(height > 0 ? height + 1 : 1)
+{
+}
+
+void SpriteOrder::add(Sprite *sprite)
+{
+    remove(sprite);
+
+    Entry entry;
+    entry.sprite = sprite;
+    entry.y = sprite->getPixelY();
+
+    const unsigned int row = getRow(entry.y);
+    Row &entries = mRows[row];
+
+    // Keep the row sorted, behind sprites at the same coordinate
+    unsigned int index = entries.size();
+    while (index > 0 && (!entries[index - 1].sprite ||
+                         entries[index - 1].y > entry.y))
+    {
+        index--;
+    }
+
+    entries.insert(entries.begin() + index, entry);
+    renumber(row, index);
+}
+
+void SpriteOrder::remove(Sprite *sprite)
+{
+    const int row = sprite->mOrderRow;
+    const int index = sprite->mOrderIndex;
+
+    if (row < 0 || row >= (int) mRows.size() ||
+        index >= (int) mRows[row].size() ||
+        mRows[row][index].sprite != sprite)
+    {
+        return;
+    }
+
+    // Leave a hole, it is closed by the next update
+    mRows[row][index].sprite = NULL;
+    sprite->mOrderRow = -1;
+    sprite->mOrderIndex = -1;
+}
+
+void SpriteOrder::update()
+{
+    mMoved.clear();
+
+    // Refresh the coordinates, dropping holes and sprites which changed rows
+    for (unsigned int row = 0; row < mRows.size(); row++)
+    {
+        Row &entries = mRows[row];
+        unsigned int kept = 0;
+
+        for (unsigned int i = 0; i < entries.size(); i++)
+        {
+            Entry entry = entries[i];
+
+            if (!entry.sprite)
+                continue;
+
+            entry.y = entry.sprite->getPixelY();
+
+            if (getRow(entry.y) == row)
+                entries[kept++] = entry;
+            else
+                mMoved.push_back(entry);
+        }
+
+        entries.resize(kept);
+    }
+
+    for (Row::const_iterator i = mMoved.begin(); i != mMoved.end(); ++i)
+        mRows[getRow(i->y)].push_back(*i);
+
+    // Insertion sort, which is close to linear on nearly sorted rows and keeps
+    // sprites at the same coordinate in the same order
+    for (unsigned int row = 0; row < mRows.size(); row++)
+    {
+        Row &entries = mRows[row];
+
+        for (unsigned int i = 1; i < entries.size(); i++)
+        {
+            const Entry entry = entries[i];
+            unsigned int j = i;
+
+            while (j > 0 && entries[j - 1].y > entry.y)
+            {
+                entries[j] = entries[j - 1];
+                j--;
+            }
+
+            entries[j] = entry;
+        }
+
+        renumber(row, 0);
+    }
+}
+
+unsigned int SpriteOrder::getRow(const int y) const
+{
+    if (y < 0)
+        return 0;
+
+    const unsigned int row = y / mTileHeight;
+    return row < mRows.size() ? row : mRows.size() - 1;
+}
+
+void SpriteOrder::renumber(const unsigned int row, const unsigned int start)
+{
+    Row &entries = mRows[row];
+
+    for (unsigned int i = start; i < entries.size(); i++)
+    {
+        if (entries[i].sprite)
+        {
+            entries[i].sprite->mOrderRow = row;
+            entries[i].sprite->mOrderIndex = i;
+        }
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SPRITEORDER_H
+#define SPRITEORDER_H
+
+#include <vector>
+
+class Sprite;
+
+/**
+ * Keeps the sprites of a map ordered ascending by their pixel Y coordinate,
+ * which is the order they have to be drawn in to overlap correctly.
+ *
+ * Instead of sorting all sprites every frame, the sprites are kept in rows
+ * one tile high. Each frame, update() moves the sprites which walked into
+ * another row and insertion sorts the rows, which is cheap since few sprites
+ * change their order from one frame to the next.
+ */
+class SpriteOrder
+{
+    public:
+        /**
+         * A sprite together with the pixel Y coordinate it was sorted by.
+         */
+        struct Entry
+        {
+            Sprite *sprite;
+            int y;
+        };
+
+        typedef std::vector<Entry> Row;
+        typedef std::vector<Row> Rows;
+
+        /**
+         * Walks the sprites in drawing order.
+         */
+        class const_iterator
+        {
+            public:
+                const Entry &operator*() const
+                { return (*mRows)[mRow][mIndex]; }
+
+                const Entry *operator->() const
+                { return &(*mRows)[mRow][mIndex]; }
+
+                const_iterator &operator++()
+                { mIndex++; skipEmpty(); return *this; }
+
+                bool operator==(const const_iterator &other) const
+                { return mRow == other.mRow && mIndex == other.mIndex; }
+
+                bool operator!=(const const_iterator &other) const
+                { return !(*this == other); }
+
+            private:
+                friend class SpriteOrder;
+
+                const_iterator(const Rows *rows, const unsigned int row):
+                    mRows(rows), mRow(row), mIndex(0)
+                { skipEmpty(); }
+
+                /**
+                 * Skips removed sprites and the ends of rows.
+                 */
+                void skipEmpty();
+
+                const Rows *mRows;
+                unsigned int mRow;
+                unsigned int mIndex;
+        };
+
+        /**
+         * Constructor, taking the map height in tiles and the height of a
+         * tile in pixels.
+         */
+        SpriteOrder(const int height, const int tileHeight);
+
+        /**
+         * Adds a sprite. A sprite can only be part of one sprite order at a
+         * time.
+         */
+        void add(Sprite *sprite);
+
+        /**
+         * Removes a sprite. Removing a sprite which isn't part of this sprite
+         * order does nothing.
+         */
+        void remove(Sprite *sprite);
+
+        /**
+         * Brings the order up to date with the current pixel Y coordinates of
+         * the sprites. Should be called once per frame before drawing.
+         */
+        void update();
+
+        const_iterator begin() const { return const_iterator(&mRows, 0); }
+
+        const_iterator end() const
+        { return const_iterator(&mRows, mRows.size()); }
+
+    private:
+        /**
+         * Returns the row keeping sprites at the given pixel Y coordinate.
+         * Sprites above or below the map are kept in the first or last row.
+         */
+        unsigned int getRow(const int y) const;
+
+        /**
+         * Tells the sprites in a row about their position, starting at the
+         * given index.
+         */
+        void renumber(const unsigned int row, const unsigned int start);
+
+        int mTileHeight;
+        Rows mRows;
+        Row mMoved;         /**< Sprites changing rows during an update */
+};
+
+#endif
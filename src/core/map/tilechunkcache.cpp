@@ -0,0 +1,238 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+
+#include <SDL.h>
+
+#include "map.h"
+#include "tilechunkcache.h"
+
+#include "../log.h"
+#include "../resourcemanager.h"
+
+#include "../image/image.h"
+
+#include "../utils/dtor.h"
+
+/**
+ * Composites a straight alpha RGBA pixel over another one.
+ */
+static inline uint32_t blendPixel(const uint32_t dst, const uint32_t src)
+{
+    const unsigned int srcAlpha = src & 0xFF;
+    const unsigned int dstAlpha = dst & 0xFF;
+
+    if (srcAlpha == 0)
+        return dst;
+
+    if (srcAlpha == 255 || dstAlpha == 0)
+        return src;
+
+    const unsigned int rest = dstAlpha * (255 - srcAlpha) / 255;
+    const unsigned int alpha = srcAlpha + rest;
+    uint32_t result = alpha;
+
+    for (int shift = 8; shift < 32; shift += 8)
+    {
+        const unsigned int s = (src >> shift) & 0xFF;
+        const unsigned int d = (dst >> shift) & 0xFF;
+        result |= ((s * srcAlpha + d * rest) / alpha) << shift;
+    }
+
+    return result;
+}
+
+/**
+ * Creates a zeroed 32-bit surface with the alpha channel in the lowest byte.
+ */
+static SDL_Surface *createRGBASurface(const int width, const int height)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                                32, 0xFF000000, 0x00FF0000,
+                                                0x0000FF00, 0x000000FF);
+    if (surface)
+        SDL_FillRect(surface, NULL, 0);
+
+    return surface;
+}
+
+TileChunkCache::TileChunkCache():
+    mBakesLeft(BAKES_PER_FRAME)
+{
+}
+
+TileChunkCache::~TileChunkCache()
+{
+    for (Sources::iterator i = mSources.begin(); i != mSources.end(); ++i)
+    {
+        if (i->second)
+            SDL_FreeSurface(i->second);
+    }
+}
+
+SDL_Surface *TileChunkCache::getSource(Image *tile)
+{
+    SubImage *subImage = dynamic_cast<SubImage*>(tile);
+    Image *parent = subImage ? subImage->getParent() : tile;
+
+    Sources::iterator i = mSources.find(parent);
+    if (i != mSources.end())
+        return i->second;
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    SDL_Surface *tmpImage = resman->loadSDLSurface(parent->getIdPath());
+    SDL_Surface *source = NULL;
+
+    if (tmpImage)
+    {
+        source = createRGBASurface(tmpImage->w, tmpImage->h);
+
+        if (source)
+        {
+            // Make sure the alpha channel is copied, not blended
+            SDL_SetAlpha(tmpImage, 0, SDL_ALPHA_OPAQUE);
+            SDL_BlitSurface(tmpImage, NULL, source, NULL);
+        }
+
+        SDL_FreeSurface(tmpImage);
+    }
+
+    if (!source)
+    {
+        logger->log("Warning: Tile chunk cache could not load %s",
+                    parent->getIdPath().c_str());
+    }
+
+    mSources[parent] = source;
+
+    return source;
+}
+
+bool TileChunkCache::bake(const MapLayer *layer, const int chunkX,
+                          const int chunkY, TileChunk &chunk)
+{
+    if (mBakesLeft <= 0)
+        return false;
+
+    mBakesLeft--;
+
+    const int tileWidth = layer->mTileWidth;
+    const int tileHeight = layer->mTileHeight;
+    const int startX = chunkX * TILE_CHUNK_SIZE;
+    const int startY = chunkY * TILE_CHUNK_SIZE;
+    const int endX = std::min(startX + TILE_CHUNK_SIZE, layer->mWidth);
+    const int endY = std::min(startY + TILE_CHUNK_SIZE, layer->mHeight);
+
+    // Find out how far the tiles of this chunk reach beyond the tile grid
+    int overhangX = 0;
+    int overhangY = 0;
+    bool empty = true;
+
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
+        {
+            const Image *img = layer->getTile(x, y);
+            if (!img)
+                continue;
+
+            empty = false;
+            overhangX = std::max(overhangX, img->getWidth() - tileWidth);
+            overhangY = std::max(overhangY, img->getHeight() - tileHeight);
+        }
+    }
+
+    destroy(chunk.image);
+    chunk.offsetY = overhangY;
+    chunk.dirty = false;
+
+    if (empty)
+        return true;
+
+    SDL_Surface *surface = createRGBASurface((endX - startX) * tileWidth +
+                                             overhangX, (endY - startY) *
+                                             tileHeight + overhangY);
+
+    if (!surface)
+    {
+        logger->log("Warning: Could not create tile chunk: %s",
+                    SDL_GetError());
+        chunk.invalidations = TILE_CHUNK_MAX_INVALIDATIONS;
+        chunk.dirty = true;
+        return true;
+    }
+
+    uint32_t *pixels = static_cast<uint32_t*>(surface->pixels);
+    const int pitch = surface->pitch / 4;
+
+    // Composite the tiles in the same order the layer would draw them
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
+        {
+            Image *img = layer->getTile(x, y);
+            if (!img)
+                continue;
+
+            // Rather than leaving the tile out, the chunk is drawn a tile
+            // at a time
+            const SDL_Surface *source = getSource(img);
+            if (!source)
+            {
+                chunk.invalidations = TILE_CHUNK_MAX_INVALIDATIONS;
+                chunk.dirty = true;
+                SDL_FreeSurface(surface);
+                return true;
+            }
+
+            const SDL_Rect &bounds = img->getBounds();
+            const int width = std::min((int) bounds.w, source->w - bounds.x);
+            const int height = std::min((int) bounds.h, source->h - bounds.y);
+            const int sourcePitch = source->pitch / 4;
+            const int dstX = (x - startX) * tileWidth;
+            const int dstY = (y - startY) * tileHeight + overhangY +
+                             tileHeight - bounds.h;
+
+            for (int py = 0; py < height; py++)
+            {
+                const uint32_t *src = static_cast<const uint32_t*>(
+                        source->pixels) + (bounds.y + py) * sourcePitch +
+                        bounds.x;
+                uint32_t *dst = pixels + (dstY + py) * pitch + dstX;
+
+                for (int px = 0; px < width; px++)
+                    dst[px] = blendPixel(dst[px], src[px]);
+            }
+        }
+    }
+
+    chunk.image = Image::load(surface);
+    SDL_FreeSurface(surface);
+
+    if (!chunk.image)
+    {
+        chunk.invalidations = TILE_CHUNK_MAX_INVALIDATIONS;
+        chunk.dirty = true;
+    }
+
+    return true;
+}
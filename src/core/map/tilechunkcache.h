@@ -0,0 +1,93 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TILECHUNKCACHE_H
+#define TILECHUNKCACHE_H
+
+#include <map>
+
+class Image;
+class MapLayer;
+
+struct SDL_Surface;
+struct TileChunk;
+
+/**
+ * Width and height in tiles of a pre-rendered layer chunk.
+ */
+const int TILE_CHUNK_SIZE = 16;
+
+/**
+ * Number of times a chunk may be invalidated by tile animations before it
+ * stops being cached and its tiles are drawn one by one again.
+ */
+const int TILE_CHUNK_MAX_INVALIDATIONS = 3;
+
+/**
+ * Bakes blocks of static layer tiles into single images, so that a layer can
+ * be drawn with a handful of blits instead of one blit per tile. The tileset
+ * pixel data needed for baking is kept around for the lifetime of the cache,
+ * so chunks that get invalidated can be rebaked without touching the disk.
+ */
+class TileChunkCache
+{
+    public:
+        /**
+         * Constructor.
+         */
+        TileChunkCache();
+
+        /**
+         * Destructor. Frees the cached tileset surfaces.
+         */
+        ~TileChunkCache();
+
+        /**
+         * Resets the number of chunks that may be baked during this frame.
+         */
+        void newFrame() { mBakesLeft = BAKES_PER_FRAME; }
+
+        /**
+         * Renders the given chunk of the layer into a single image.
+         *
+         * @return <code>false</code> when the bake budget for this frame has
+         *         been used up, <code>true</code> otherwise. An empty chunk
+         *         is baked successfully but gets no image.
+         */
+        bool bake(const MapLayer *layer, const int chunkX, const int chunkY,
+                  TileChunk &chunk);
+
+    private:
+        /**
+         * Returns the 32-bit RGBA pixel data of the image the given tile was
+         * cut from, loading it when needed.
+         */
+        SDL_Surface *getSource(Image *tile);
+
+        /** Maximum number of chunks baked during a single frame. */
+        static const int BAKES_PER_FRAME = 4;
+
+        typedef std::map<Image*, SDL_Surface*> Sources;
+        Sources mSources;
+        int mBakesLeft;
+};
+
+#endif
@@ -21,6 +21,7 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
 #include <cassert>
 #include <physfs.h>
 #include <SDL_image.h>
@@ -28,6 +29,7 @@
 
 #include <sys/time.h>
 
+#include "configuration.h"
 #include "log.h"
 #include "resourcemanager.h"
 
@@ -35,27 +37,48 @@
 #include "image/image.h"
 #include "image/imageset.h"
 
+#ifdef USE_OPENGL
+#include "image/textureatlas.h"
+#endif
+
+#include "image/particle/particleeffect.h"
+
 #include "map/sprite/spritedef.h"
 
 #include "sound/music.h"
 #include "sound/soundeffect.h"
 
 #include "utils/dtor.h"
+#include "utils/profiler.h"
 
 #include "../bindings/guichan/truetypefont.h"
 
 #include "../bindings/physfs/physfsrwops.h"
 
+/**
+ * The most pixels the decoded images kept for dyeing may take up together.
+ */
+#define MAX_DYE_SOURCE_PIXELS (4 * 1024 * 1024)
+
 ResourceManager *ResourceManager::instance = NULL;
 
 ResourceManager::ResourceManager()
-  : mOldestOrphan(0)
+  : mOldestOrphan(0),
+    mAtlas(NULL),
+    mDyeSourcePixels(0)
 {
     logger->log("Initializing resource manager...");
 }
 
 ResourceManager::~ResourceManager()
 {
+#ifdef USE_OPENGL
+    // Let go of the page the atlas was still packing into
+    destroy(mAtlas);
+#endif
+
+    clearDyeSources();
+
     mResources.insert(mOrphanedResources.begin(), mOrphanedResources.end());
 
     // Release any remaining spritedefs first because they depend on image sets
@@ -92,6 +115,23 @@ ResourceManager::~ResourceManager()
         }
     }
 
+    // Release images cut from atlas pages before the pages themselves
+    iter = mResources.begin();
+    while (iter != mResources.end())
+    {
+        if (dynamic_cast<SubImage*>(iter->second) != 0)
+        {
+            cleanUp(iter->second);
+            ResourceIterator toErase = iter;
+            ++iter;
+            mResources.erase(toErase);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
     // Release remaining resources, logging the number of dangling references.
     iter = mResources.begin();
     while (iter != mResources.end())
@@ -242,7 +282,12 @@ Resource *ResourceManager::get(const std::string &idPath, generator fun,
         return res;
     }
 
-    Resource *resource = fun(data);
+    Resource *resource;
+
+    {
+        ProfileScope scope("ResourceManager::load");
+        resource = fun(data);
+    }
 
     if (resource)
     {
@@ -329,15 +374,19 @@ struct DyedImageLoader
             d = new Dye(path.substr(p + 1));
             path = path.substr(0, p);
         }
-        SDL_RWops *rw = PHYSFSRWOPS_openRead(path.c_str());
-        if (!rw)
+        TextureAtlas *atlas = l->manager->getAtlas();
+        if (d)
         {
+            // The dyes of an image share the decoded file
+            SDL_Surface *source = l->manager->getDyeSource(path);
+            Resource *res = source ? Image::load(source, *d, atlas) : NULL;
             destroy(d);
-            return NULL;
+            return res;
         }
-        Resource *res = d ? Image::load(rw, *d) : Image::load(rw);
-        destroy(d);
-        return res;
+        SDL_RWops *rw = PHYSFSRWOPS_openRead(path.c_str());
+        if (!rw)
+            return NULL;
+        return Image::load(rw, atlas);
     }
 };
 
@@ -347,6 +396,25 @@ Image *ResourceManager::getImage(const std::string &idPath)
     return static_cast<Image*>(get(idPath, DyedImageLoader::load, &l));
 }
 
+struct SurfaceImageLoader
+{
+    ResourceManager *manager;
+    SDL_Surface *surface;
+    static Resource *load(void *v)
+    {
+        SurfaceImageLoader *l = static_cast< SurfaceImageLoader * >(v);
+        return l->surface ?
+            Image::load(l->surface, l->manager->getAtlas()) : NULL;
+    }
+};
+
+Image *ResourceManager::getImage(const std::string &idPath,
+                                 SDL_Surface *surface)
+{
+    SurfaceImageLoader l = { this, surface };
+    return static_cast<Image*>(get(idPath, SurfaceImageLoader::load, &l));
+}
+
 struct ResizedImageLoader
 {
     ResourceManager *manager;
@@ -422,6 +490,28 @@ SpriteDef *ResourceManager::getSprite(const std::string &path,
     return static_cast<SpriteDef*>(get(ss.str(), SpriteDefLoader::load, &l));
 }
 
+struct ParticleEffectLoader
+{
+    std::string path;
+    int tileWidth, tileHeight;
+    static Resource *load(void *v)
+    {
+        ParticleEffectLoader *l = static_cast< ParticleEffectLoader * >(v);
+        return ParticleEffect::load(l->path, l->tileWidth, l->tileHeight);
+    }
+};
+
+ParticleEffect *ResourceManager::getParticleEffect(const std::string &path,
+                                                   const int tileWidth,
+                                                   const int tileHeight)
+{
+    ParticleEffectLoader l = { path, tileWidth, tileHeight };
+    std::stringstream ss;
+    ss << path << "[" << tileWidth << "x" << tileHeight << "]";
+    return static_cast<ParticleEffect*>(get(ss.str(),
+                                            ParticleEffectLoader::load, &l));
+}
+
 void ResourceManager::release(Resource *res)
 {
     ResourceIterator resIter = mResources.find(res->mIdPath);
@@ -442,6 +532,21 @@ void ResourceManager::release(Resource *res)
     mResources.erase(resIter);
 }
 
+TextureAtlas *ResourceManager::getAtlas()
+{
+#ifdef USE_OPENGL
+    // The texture size is only known once the video mode is set
+    if (!mAtlas && Image::getLoadAsOpenGL() && Image::getTextureSize() > 0 &&
+        config.getValue("textureAtlas", 1) == 1)
+    {
+        const int size = config.getValue("textureAtlasSize", 1024);
+        mAtlas = new TextureAtlas(std::min(size, Image::getTextureSize()));
+    }
+#endif
+
+    return mAtlas;
+}
+
 ResourceManager *ResourceManager::getInstance()
 {
     // Create a new instance if necessary.
@@ -486,6 +591,25 @@ void *ResourceManager::loadFile(const std::string &fileName, int &fileSize)
     return buffer;
 }
 
+bool ResourceManager::saveFile(const std::string &fileName, const void *data,
+                               const int size)
+{
+    PHYSFS_file *file = PHYSFS_openWrite(fileName.c_str());
+    if (!file)
+    {
+        logger->log("Write error: %s", PHYSFS_getLastError());
+        return false;
+    }
+
+    const bool written = PHYSFS_write(file, data, 1, size) == size;
+
+    if (!written)
+        logger->log("Write error: %s", PHYSFS_getLastError());
+
+    PHYSFS_close(file);
+    return written;
+}
+
 bool ResourceManager::copyFile(const std::string &src, const std::string &dst)
 {
     PHYSFS_file *srcFile = PHYSFS_openRead(src.c_str());
@@ -543,3 +667,41 @@ SDL_Surface *ResourceManager::loadSDLSurface(const std::string& filename)
         surface = IMG_Load_RW(rw, 1);
     return surface;
 }
+
+SDL_Surface *ResourceManager::getDyeSource(const std::string &path)
+{
+    Surfaces::iterator i = mDyeSources.find(path);
+    if (i != mDyeSources.end())
+        return i->second;
+
+    SDL_Surface *tmpImage = loadSDLSurface(path);
+    if (!tmpImage)
+    {
+        logger->log("Error, image load failed: %s", IMG_GetError());
+        return NULL;
+    }
+
+    SDL_Surface *source = Image::convertToRGBA(tmpImage);
+    SDL_FreeSurface(tmpImage);
+
+    if (!source)
+        return NULL;
+
+    // Start over when the kept images grow too large
+    if (mDyeSourcePixels + source->w * source->h > MAX_DYE_SOURCE_PIXELS)
+        clearDyeSources();
+
+    mDyeSources[path] = source;
+    mDyeSourcePixels += source->w * source->h;
+
+    return source;
+}
+
+void ResourceManager::clearDyeSources()
+{
+    for (Surfaces::iterator i = mDyeSources.begin(); i != mDyeSources.end(); ++i)
+        SDL_FreeSurface(i->second);
+
+    mDyeSources.clear();
+    mDyeSourcePixels = 0;
+}
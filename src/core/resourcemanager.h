@@ -35,9 +35,11 @@
 class Image;
 class ImageSet;
 class Music;
+class ParticleEffect;
 class Resource;
 class SoundEffect;
 class SpriteDef;
+class TextureAtlas;
 class TrueTypeFont;
 
 struct SDL_Surface;
@@ -152,6 +154,14 @@ class ResourceManager
          */
         Image *getImage(const std::string &idPath);
 
+        /**
+         * Convenience wrapper around ResourceManager::get for creating images
+         * from surfaces which were already loaded, for example by another
+         * thread. The surface is only used when the image isn't loaded yet,
+         * and is still to be freed by the caller.
+         */
+        Image *getImage(const std::string &idPath, SDL_Surface *surface);
+
         /**
          * Convenience wrapper around ResourceManager::get for loading
          * resized images.
@@ -190,11 +200,25 @@ class ResourceManager
          */
         SpriteDef *getSprite(const std::string &path, const int variant = 0);
 
+        /**
+         * Creates a particle effect based on a given path and the tile size
+         * of the map it is used on.
+         */
+        ParticleEffect *getParticleEffect(const std::string &path,
+                                          const int tileWidth,
+                                          const int tileHeight);
+
         /**
          * Releases a resource, placing it in the set of orphaned resources.
          */
         void release(Resource *);
 
+        /**
+         * Returns the atlas small images are packed into, or
+         * <code>NULL</code> when images get a texture of their own.
+         */
+        TextureAtlas *getAtlas();
+
         /**
          * Allocates data into a buffer pointer for raw data loading. The
          * returned data is expected to be freed using <code>free()</code>.
@@ -207,6 +231,15 @@ class ResourceManager
          */
         void *loadFile(const std::string &fileName, int &fileSize);
 
+        /**
+         * Writes a buffer to a file in the write directory, replacing the
+         * file if it already exists.
+         *
+         * @return <code>true</code> on success, <code>false</code> otherwise.
+         */
+        bool saveFile(const std::string &fileName, const void *data,
+                      const int size);
+
         /**
          * Retrieves the contents of a text file.
          */
@@ -218,6 +251,14 @@ class ResourceManager
          */
         SDL_Surface *loadSDLSurface(const std::string& filename);
 
+        /**
+         * Returns the given image file as an RGBA surface, ready to be dyed.
+         * The file is only decoded once for all the dyes applied to it. The
+         * surface is owned by the resource manager and stays valid until the
+         * next call.
+         */
+        SDL_Surface *getDyeSource(const std::string &path);
+
         /**
          * Returns an instance of the class, creating one if it does not
          * already exist.
@@ -237,12 +278,22 @@ class ResourceManager
 
         void cleanOrphans();
 
+        /**
+         * Frees the decoded images kept for dyeing.
+         */
+        void clearDyeSources();
+
         static ResourceManager *instance;
         typedef std::map<std::string, Resource*> Resources;
         typedef Resources::iterator ResourceIterator;
         Resources mResources;
         Resources mOrphanedResources;
         time_t mOldestOrphan;
+        TextureAtlas *mAtlas;
+
+        typedef std::map<std::string, SDL_Surface*> Surfaces;
+        Surfaces mDyeSources;
+        int mDyeSourcePixels;
 };
 
 #endif
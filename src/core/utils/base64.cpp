@@ -30,6 +30,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BASE64_BLOCK 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BASE64_BLOCK 16
+#endif
+
 #include "base64.h"
 
 static char base64_table[] =
@@ -42,6 +50,27 @@ static char base64_table[] =
 };
 static char base64_pad = '=';
 
+/* the value of each character, or -1 when it isn't part of the alphabet */
+static const signed char base64_values[256] =
+{
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
 unsigned char *php3_base64_encode(const unsigned char *string, int length, int *ret_length) {
     const unsigned char *current = string;
     int i = 0;
@@ -146,3 +175,197 @@ unsigned char *php3_base64_decode(const unsigned char *string, int length, int *
     result[k] = '\0';
     return result;
 }
+
+#ifdef BASE64_BLOCK
+/* Stores the three bytes in the low end of each 32 bit lane, which hold the
+   decoded data in big endian order, next to each other. Writes 13 bytes. */
+static void base64_store_lanes(__m128i lanes, unsigned char *result) {
+    int i, word;
+
+    for (i = 0; i < 4; i++) {
+        word = _mm_cvtsi128_si32(lanes);
+        memcpy(result + i * 3, &word, 4);
+        lanes = _mm_srli_si128(lanes, 4);
+    }
+}
+#endif
+
+#if defined(__AVX2__)
+/* Decodes 32 characters into 24 bytes, writing up to 25 bytes. Returns 0
+   without decoding anything when they aren't all part of the alphabet. */
+static int base64_decode_block(const unsigned char *string,
+                               unsigned char *result) {
+    const __m256i c = _mm256_loadu_si256((const __m256i *) string);
+
+    /* characters above 127 are negative and end up in none of the ranges */
+    const __m256i upper = _mm256_and_si256(
+        _mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+    const __m256i lower = _mm256_and_si256(
+        _mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+    const __m256i digit = _mm256_and_si256(
+        _mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+    const __m256i plus = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('+'));
+    const __m256i slash = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/'));
+
+    const __m256i valid = _mm256_or_si256(
+        _mm256_or_si256(upper, lower),
+        _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+
+    if (_mm256_movemask_epi8(valid) != -1) {
+        return 0;
+    }
+
+    /* turn the characters into their 6 bit values */
+    const __m256i offset = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_and_si256(upper, _mm256_set1_epi8(-'A')),
+            _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+        _mm256_or_si256(
+            _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+            _mm256_or_si256(
+                _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')),
+                _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')))));
+    const __m256i values = _mm256_add_epi8(c, offset);
+
+    /* merge pairs of values into 12 bits, and pairs of those into 24 bits */
+    const __m256i pairs = _mm256_or_si256(
+        _mm256_slli_epi16(_mm256_and_si256(values, _mm256_set1_epi16(0xff)), 6),
+        _mm256_srli_epi16(values, 8));
+    const __m256i quads = _mm256_or_si256(
+        _mm256_slli_epi32(_mm256_and_si256(pairs, _mm256_set1_epi32(0xffff)), 12),
+        _mm256_srli_epi32(pairs, 16));
+
+    /* swap the first and third byte to get big endian order */
+    const __m256i swapped = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_and_si256(_mm256_srli_epi32(quads, 16),
+                             _mm256_set1_epi32(0xff)),
+            _mm256_and_si256(quads, _mm256_set1_epi32(0xff00))),
+        _mm256_slli_epi32(_mm256_and_si256(quads, _mm256_set1_epi32(0xff)), 16));
+
+    base64_store_lanes(_mm256_castsi256_si128(swapped), result);
+    base64_store_lanes(_mm256_extracti128_si256(swapped, 1), result + 12);
+    return 1;
+}
+#elif defined(__SSE2__)
+/* Decodes 16 characters into 12 bytes, writing up to 13 bytes. Returns 0
+   without decoding anything when they aren't all part of the alphabet. */
+static int base64_decode_block(const unsigned char *string,
+                               unsigned char *result) {
+    const __m128i c = _mm_loadu_si128((const __m128i *) string);
+
+    /* characters above 127 are negative and end up in none of the ranges */
+    const __m128i upper = _mm_and_si128(
+        _mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+        _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+    const __m128i lower = _mm_and_si128(
+        _mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)),
+        _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+    const __m128i digit = _mm_and_si128(
+        _mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+        _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    const __m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+    const __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+
+    const __m128i valid = _mm_or_si128(
+        _mm_or_si128(upper, lower),
+        _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+
+    if (_mm_movemask_epi8(valid) != 0xffff) {
+        return 0;
+    }
+
+    /* turn the characters into their 6 bit values */
+    const __m128i offset = _mm_or_si128(
+        _mm_or_si128(
+            _mm_and_si128(upper, _mm_set1_epi8(-'A')),
+            _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+        _mm_or_si128(
+            _mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+            _mm_or_si128(
+                _mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+    const __m128i values = _mm_add_epi8(c, offset);
+
+    /* merge pairs of values into 12 bits, and pairs of those into 24 bits */
+    const __m128i pairs = _mm_or_si128(
+        _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0xff)), 6),
+        _mm_srli_epi16(values, 8));
+    const __m128i quads = _mm_or_si128(
+        _mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0xffff)), 12),
+        _mm_srli_epi32(pairs, 16));
+
+    /* swap the first and third byte to get big endian order */
+    const __m128i swapped = _mm_or_si128(
+        _mm_or_si128(
+            _mm_and_si128(_mm_srli_epi32(quads, 16), _mm_set1_epi32(0xff)),
+            _mm_and_si128(quads, _mm_set1_epi32(0xff00))),
+        _mm_slli_epi32(_mm_and_si128(quads, _mm_set1_epi32(0xff)), 16));
+
+    base64_store_lanes(swapped, result);
+    return 1;
+}
+#endif
+
+int base64_decode_into(const unsigned char *string, int length,
+                       unsigned char *result, int result_length) {
+    const unsigned char *current = string;
+    const unsigned char *end = string + length;
+#ifdef BASE64_BLOCK
+    const unsigned char *next_block = string;
+#endif
+    unsigned int bits = 0;
+    int ch, value, count = 0, j = 0;
+
+    while (current < end) {
+#ifdef BASE64_BLOCK
+        /* decode whole blocks at once, as long as they contain no whitespace;
+           the block decoders write a little past the bytes they decode */
+        if (count == 0 && current >= next_block &&
+            end - current >= BASE64_BLOCK &&
+            result_length - j >= BASE64_BLOCK) {
+            if (base64_decode_block(current, result + j)) {
+                current += BASE64_BLOCK;
+                j += BASE64_BLOCK / 4 * 3;
+                continue;
+            }
+            /* don't try again before getting past whatever stopped it */
+            next_block = current + BASE64_BLOCK;
+        }
+#endif
+        ch = *current++;
+        if (ch == base64_pad) break;
+
+        value = base64_values[ch];
+        if (value < 0) continue;
+
+        bits = (bits << 6) | value;
+        if (++count < 4) continue;
+
+        if (result_length - j < 3) {
+            /* fill up what's left of the buffer and ignore the rest */
+            if (j < result_length) result[j++] = bits >> 16;
+            if (j < result_length) result[j++] = bits >> 8;
+            return j;
+        }
+
+        result[j++] = bits >> 16;
+        result[j++] = bits >> 8;
+        result[j++] = bits;
+        bits = 0;
+        count = 0;
+    }
+
+    /* two or three characters left make up one or two more bytes */
+    if (count >= 2 && j < result_length) {
+        result[j++] = bits >> (count * 6 - 8);
+    }
+    if (count == 3 && j < result_length) {
+        result[j++] = bits >> 2;
+    }
+
+    return j;
+}
@@ -33,4 +33,11 @@
 extern unsigned char *php3_base64_encode(const unsigned char *, int, int *);
 extern unsigned char *php3_base64_decode(const unsigned char *, int, int *);
 
+/* Decodes base64 data into a buffer provided by the caller, without making a
+ * copy first. Whitespace and other characters which aren't part of the base64
+ * alphabet are skipped, and decoding stops at the first padding character or
+ * when the buffer is full. Returns the number of bytes decoded. At most
+ * length * 3 / 4 bytes are decoded. */
+extern int base64_decode_into(const unsigned char *, int, unsigned char *, int);
+
 #endif /* BASE64_H */
@@ -0,0 +1,175 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cmath>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#include <SDL.h>
+
+#include "frameclock.h"
+
+/**
+ * The time slept away in small slices before a frame deadline, as sleeping
+ * longer may overshoot by about a millisecond.
+ */
+#define SPIN_TIME 1000
+
+FrameClock::FrameClock():
+    mFramePeriod(1000000 / 60)
+{
+    reset();
+}
+
+void FrameClock::reset()
+{
+    mLastStep = now();
+    mLastFrame = mLastStep;
+    mFrameDeadline = mLastStep + mFramePeriod;
+    mStepFraction = 0.0f;
+    mFrameIndex = 0;
+    mFrameCount = 0;
+}
+
+int FrameClock::advance()
+{
+    const uint64_t time = now();
+    const uint64_t stepTime = STEP_TIME * 1000;
+    const int steps = (int) ((time - mLastStep) / stepTime);
+
+    mLastStep += steps * stepTime;
+    mStepFraction = (float) (time - mLastStep) / stepTime;
+
+    return steps;
+}
+
+void FrameClock::setFrameRate(const int fps)
+{
+    mFramePeriod = 1000000 / (fps > 0 ? fps : 60);
+    mFrameDeadline = now() + mFramePeriod;
+}
+
+void FrameClock::waitForFrame()
+{
+    uint64_t time = now();
+
+    if (time < mFrameDeadline)
+    {
+        while (mFrameDeadline - time > SPIN_TIME)
+        {
+            SDL_Delay((Uint32) ((mFrameDeadline - time - SPIN_TIME) / 1000));
+            time = now();
+        }
+
+        while (time < mFrameDeadline)
+        {
+            SDL_Delay(0);
+            time = now();
+        }
+
+        mFrameDeadline += mFramePeriod;
+    }
+    else if (time - mFrameDeadline < mFramePeriod)
+    {
+        mFrameDeadline += mFramePeriod;
+    }
+    else
+    {
+        // Too far behind to catch up, start over from now
+        mFrameDeadline = time + mFramePeriod;
+    }
+
+    mFrameTimes[mFrameIndex] = (time - mLastFrame) / 1000.0;
+    mFrameIndex = (mFrameIndex + 1) % FRAME_HISTORY;
+    if (mFrameCount < FRAME_HISTORY)
+        mFrameCount++;
+
+    mLastFrame = time;
+}
+
+double FrameClock::getAverageFrameTime() const
+{
+    double sum = 0.0;
+    for (int i = 0; i < mFrameCount; i++)
+        sum += mFrameTimes[i];
+
+    return mFrameCount > 0 ? sum / mFrameCount : 0.0;
+}
+
+double FrameClock::getFrameTimeDeviation() const
+{
+    if (mFrameCount < 2)
+        return 0.0;
+
+    const double average = getAverageFrameTime();
+    double sum = 0.0;
+    for (int i = 0; i < mFrameCount; i++)
+    {
+        const double difference = mFrameTimes[i] - average;
+        sum += difference * difference;
+    }
+
+    return std::sqrt(sum / (mFrameCount - 1));
+}
+
+double FrameClock::getLongestFrameTime() const
+{
+    double longest = 0.0;
+    for (int i = 0; i < mFrameCount; i++)
+    {
+        if (mFrameTimes[i] > longest)
+            longest = mFrameTimes[i];
+    }
+
+    return longest;
+}
+
+uint64_t FrameClock::now()
+{
+#ifdef WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart * 1000000 +
+                       counter.QuadPart % frequency.QuadPart * 1000000 /
+                       frequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    // Not monotonic, but the best there is without CLOCK_MONOTONIC
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
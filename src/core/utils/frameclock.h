@@ -0,0 +1,112 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FRAMECLOCK_H
+#define FRAMECLOCK_H
+
+#include <stdint.h>
+
+/**
+ * Drives the main loop from a monotonic, high resolution clock. Game logic
+ * advances in fixed steps, while frames are drawn at their own rate,
+ * anywhere in between two steps. The part of the next step which passed
+ * already lets drawing place moving things where they are right now.
+ *
+ * Frames are paced by sleeping until the deadline of the next frame, which
+ * moves by a fixed period, so that small delays don't add up.
+ */
+class FrameClock
+{
+    public:
+        /**
+         * The length of a logic step in milliseconds.
+         */
+        static const int STEP_TIME = 10;
+
+        /**
+         * Constructor.
+         */
+        FrameClock();
+
+        /**
+         * Restarts the clock, with no logic steps or frames passed.
+         */
+        void reset();
+
+        /**
+         * Returns the number of logic steps which passed since the last call,
+         * and moves on by that many steps.
+         */
+        int advance();
+
+        /**
+         * Returns the part of the next logic step which passed when the clock
+         * was last advanced, between 0 and 1.
+         */
+        float getStepFraction() const { return mStepFraction; }
+
+        /**
+         * Sets the number of frames per second to pace the loop at.
+         */
+        void setFrameRate(const int fps);
+
+        /**
+         * Sleeps until the next frame is due, and records how long the frame
+         * took.
+         */
+        void waitForFrame();
+
+        /**
+         * Returns the average time between the recent frames in milliseconds.
+         */
+        double getAverageFrameTime() const;
+
+        /**
+         * Returns the standard deviation of the recent frame times in
+         * milliseconds.
+         */
+        double getFrameTimeDeviation() const;
+
+        /**
+         * Returns the longest of the recent frame times in milliseconds.
+         */
+        double getLongestFrameTime() const;
+
+        /**
+         * Returns the current time of the monotonic clock in microseconds.
+         */
+        static uint64_t now();
+
+    private:
+        enum { FRAME_HISTORY = 120 };
+
+        uint64_t mLastStep;          /**< Time of the last logic step */
+        uint64_t mLastFrame;         /**< Time the last frame ended */
+        uint64_t mFrameDeadline;     /**< Time the next frame is due */
+        uint64_t mFramePeriod;       /**< Time between frames */
+        float mStepFraction;
+
+        double mFrameTimes[FRAME_HISTORY]; /**< Recent frame times */
+        int mFrameIndex;
+        int mFrameCount;
+};
+
+#endif
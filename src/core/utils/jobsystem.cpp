@@ -0,0 +1,261 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "jobsystem.h"
+
+#include "dtor.h"
+
+JobSystem *JobSystem::instance = NULL;
+
+JobSystem::JobSystem(int workers):
+    mFunction(NULL),
+    mData(NULL),
+    mMutex(SDL_CreateMutex()),
+    mWake(SDL_CreateCond()),
+    mDone(SDL_CreateCond()),
+    mGeneration(0),
+    mPending(0),
+    mBusy(false),
+    mQuit(false)
+{
+    if (workers <= 0)
+        workers = getProcessorCount();
+
+    for (int i = 0; i < workers; i++)
+    {
+        Worker *worker = new Worker;
+        worker->system = this;
+        worker->index = i;
+        worker->thread = NULL;
+        worker->mutex = SDL_CreateMutex();
+        mWorkers.push_back(worker);
+    }
+
+    // The calling thread is the first worker
+    for (unsigned int i = 1; i < mWorkers.size(); i++)
+        mWorkers[i]->thread = SDL_CreateThread(workerThread, mWorkers[i]);
+}
+
+JobSystem::~JobSystem()
+{
+    SDL_mutexP(mMutex);
+    mQuit = true;
+    SDL_CondBroadcast(mWake);
+    SDL_mutexV(mMutex);
+
+    for (unsigned int i = 0; i < mWorkers.size(); i++)
+    {
+        if (mWorkers[i]->thread)
+            SDL_WaitThread(mWorkers[i]->thread, NULL);
+
+        SDL_DestroyMutex(mWorkers[i]->mutex);
+        delete mWorkers[i];
+    }
+
+    SDL_DestroyCond(mDone);
+    SDL_DestroyCond(mWake);
+    SDL_DestroyMutex(mMutex);
+}
+
+void JobSystem::parallelFor(JobFunction function, void *data, const int count,
+                            const int grain)
+{
+    if (count <= 0)
+        return;
+
+    const int jobSize = grain > 0 ? grain : count;
+    const int jobCount = (count + jobSize - 1) / jobSize;
+
+    // Not worth waking anyone up for. Neither is waiting for the work of
+    // another thread to be done.
+    bool alone = mWorkers.size() == 1 || jobCount == 1;
+
+    if (!alone)
+    {
+        SDL_mutexP(mMutex);
+        alone = mBusy;
+        if (!mBusy)
+        {
+            mBusy = true;
+            mPending = jobCount;
+        }
+        SDL_mutexV(mMutex);
+    }
+
+    if (alone)
+    {
+        for (int begin = 0; begin < count; begin += jobSize)
+            function(data, begin, std::min(begin + jobSize, count), 0);
+        return;
+    }
+
+    mFunction = function;
+    mData = data;
+
+    for (int i = 0; i < jobCount; i++)
+    {
+        Job job;
+        job.begin = i * jobSize;
+        job.end = std::min(job.begin + jobSize, count);
+
+        Worker *worker = mWorkers[i % mWorkers.size()];
+        SDL_mutexP(worker->mutex);
+        worker->jobs.push_back(job);
+        SDL_mutexV(worker->mutex);
+    }
+
+    SDL_mutexP(mMutex);
+    mGeneration++;
+    SDL_CondBroadcast(mWake);
+    SDL_mutexV(mMutex);
+
+    runJobs(mWorkers[0]);
+
+    SDL_mutexP(mMutex);
+    while (mPending > 0)
+        SDL_CondWait(mDone, mMutex);
+    mBusy = false;
+    SDL_mutexV(mMutex);
+}
+
+int JobSystem::getProcessorCount()
+{
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const int count = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    const int count = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    const int count = 1;
+#endif
+
+    return count > 0 ? count : 1;
+}
+
+void JobSystem::createInstance(const int workers)
+{
+    if (!instance)
+        instance = new JobSystem(workers);
+}
+
+JobSystem *JobSystem::getInstance()
+{
+    if (!instance)
+        instance = new JobSystem(0);
+
+    return instance;
+}
+
+void JobSystem::deleteInstance()
+{
+    destroy(instance);
+}
+
+int JobSystem::workerThread(void *worker)
+{
+    Worker *self = static_cast<Worker*>(worker);
+    self->system->work(self);
+    return 0;
+}
+
+void JobSystem::work(Worker *worker)
+{
+    int generation = 0;
+
+    SDL_mutexP(mMutex);
+    for (;;)
+    {
+        while (!mQuit && generation == mGeneration)
+            SDL_CondWait(mWake, mMutex);
+
+        if (mQuit)
+            break;
+
+        generation = mGeneration;
+
+        SDL_mutexV(mMutex);
+        runJobs(worker);
+        SDL_mutexP(mMutex);
+    }
+    SDL_mutexV(mMutex);
+}
+
+void JobSystem::runJobs(Worker *worker)
+{
+    Job job;
+    int done = 0;
+
+    while (takeJob(worker, job))
+    {
+        mFunction(mData, job.begin, job.end, worker->index);
+        done++;
+    }
+
+    if (done == 0)
+        return;
+
+    SDL_mutexP(mMutex);
+    mPending -= done;
+    if (mPending == 0)
+        SDL_CondSignal(mDone);
+    SDL_mutexV(mMutex);
+}
+
+bool JobSystem::takeJob(Worker *worker, Job &job)
+{
+    // Own jobs are taken from the back, stolen ones from the front
+    for (unsigned int i = 0; i < mWorkers.size(); i++)
+    {
+        Worker *victim = mWorkers[(worker->index + i) % mWorkers.size()];
+        bool found = false;
+
+        SDL_mutexP(victim->mutex);
+        if (!victim->jobs.empty())
+        {
+            if (victim == worker)
+            {
+                job = victim->jobs.back();
+                victim->jobs.pop_back();
+            }
+            else
+            {
+                job = victim->jobs.front();
+                victim->jobs.pop_front();
+            }
+            found = true;
+        }
+        SDL_mutexV(victim->mutex);
+
+        if (found)
+            return true;
+    }
+
+    return false;
+}
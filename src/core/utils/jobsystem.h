@@ -0,0 +1,161 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <deque>
+#include <vector>
+
+#include <SDL_thread.h>
+
+/**
+ * Runs the iterations of a loop on several threads. The iterations are
+ * split into jobs, which are queued evenly over the workers. A worker which
+ * runs out of jobs steals from the other queues, so the work stays balanced
+ * even when some jobs take longer than others.
+ *
+ * The calling thread is the first worker, the others are helper threads
+ * which sleep while there is nothing to do. Only one thread hands out work
+ * at a time, any other thread calling in meanwhile runs its jobs by itself.
+ *
+ * The engine shares a single job system between everything running in
+ * parallel, see getInstance().
+ */
+class JobSystem
+{
+    public:
+        /**
+         * A job, running the iterations from begin up to, but not including,
+         * end on the worker with the given index.
+         */
+        typedef void (*JobFunction)(void *data, const int begin,
+                                    const int end, const int worker);
+
+        /**
+         * Constructor. Starts the given number of workers, including the
+         * calling thread, or one per processor when it isn't positive.
+         */
+        JobSystem(int workers);
+
+        /**
+         * Destructor, stops the helper threads.
+         */
+        ~JobSystem();
+
+        /**
+         * Runs the function for the iterations from 0 up to count, split
+         * into jobs of the given number of iterations. Returns when all jobs
+         * are done.
+         *
+         * The jobs don't depend on the number of workers, so a function which
+         * only uses the iterations it is given produces the same results no
+         * matter how many threads run it.
+         *
+         * While another thread is handing out work, the calling thread runs
+         * all jobs by itself as worker 0, rather than waiting for the others
+         * to finish.
+         */
+        void parallelFor(JobFunction function, void *data, const int count,
+                         const int grain);
+
+        /**
+         * Returns the number of workers, including the calling thread.
+         */
+        int getWorkerCount() const { return mWorkers.size(); }
+
+        /**
+         * Returns the number of processors available, or 1 when unknown.
+         */
+        static int getProcessorCount();
+
+        /**
+         * Starts the job system shared by the engine with the given number
+         * of workers, or one per processor when it isn't positive. Has to be
+         * called on the main thread, before other threads use it.
+         */
+        static void createInstance(const int workers);
+
+        /**
+         * Returns the job system shared by the engine, starting it with one
+         * worker per processor if createInstance() wasn't called.
+         */
+        static JobSystem *getInstance();
+
+        /**
+         * Stops the shared job system if it was started.
+         */
+        static void deleteInstance();
+
+    private:
+        JobSystem(const JobSystem&);  // prevent copying
+        JobSystem& operator=(const JobSystem&);
+
+        struct Job
+        {
+            int begin;
+            int end;
+        };
+
+        struct Worker
+        {
+            JobSystem *system;
+            int index;
+            SDL_Thread *thread;
+            SDL_mutex *mutex;       /**< Guards the jobs */
+            std::deque<Job> jobs;
+        };
+
+        static int workerThread(void *worker);
+
+        /**
+         * Waits for and runs jobs until the job system is destroyed.
+         */
+        void work(Worker *worker);
+
+        /**
+         * Runs jobs on the given worker until none are left anywhere.
+         */
+        void runJobs(Worker *worker);
+
+        /**
+         * Takes the next job from the queue of the worker, or steals one
+         * from another worker. Returns false when all queues are empty.
+         */
+        bool takeJob(Worker *worker, Job &job);
+
+        std::vector<Worker*> mWorkers;
+
+        JobFunction mFunction;
+        void *mData;
+
+        SDL_mutex *mMutex;          /**< Guards the members below */
+        SDL_cond *mWake;            /**< Signalled when jobs are queued */
+        SDL_cond *mDone;            /**< Signalled when the last job is done */
+        int mGeneration;            /**< Number of times jobs were queued */
+        int mPending;               /**< Jobs not done yet */
+        bool mBusy;                 /**< A thread is handing out work */
+        bool mQuit;
+
+        static JobSystem *instance;
+};
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <SDL_thread.h>
+
+#include "frameclock.h"
+#include "profiler.h"
+
+#include "../log.h"
+
+bool Profiler::mEnabled = false;
+bool Profiler::mStarting = false;
+uint32_t Profiler::mThread = 0;
+std::vector<Profiler::Node> Profiler::mNodes;
+std::vector<Profiler::Open> Profiler::mOpen;
+std::vector<Profiler::TraceEvent> Profiler::mTrace;
+int Profiler::mTraceNext = 0;
+uint64_t Profiler::mFrameStart = 0;
+int Profiler::mFrameIndex = 0;
+int Profiler::mFrameCount = 0;
+
+void Profiler::setEnabled(const bool enabled)
+{
+    // Sections already entered in this frame weren't timed, so the frame is
+    // left to finish first
+    mStarting = enabled && !mEnabled;
+
+    if (!enabled)
+        mEnabled = false;
+}
+
+void Profiler::start()
+{
+    // The root of the tree stands for the whole frame
+    if (mNodes.empty())
+    {
+        Node root;
+        root.name = "Frame";
+        root.parent = -1;
+        root.depth = 0;
+        for (int i = 0; i < FRAME_HISTORY; i++)
+            root.frameTimes[i] = 0.0;
+        mNodes.push_back(root);
+    }
+
+    // The sections of before keep their place in the tree, the ones which
+    // aren't entered anymore are pruned after the first frame
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        mNodes[i].calls = 0;
+        mNodes[i].time = 0;
+        mNodes[i].lastCalls = 0;
+    }
+
+    mThread = SDL_ThreadID();
+    mTrace.clear();
+    mTraceNext = 0;
+    mFrameStart = FrameClock::now();
+    mFrameIndex = 0;
+    mFrameCount = 0;
+    mStarting = false;
+    mEnabled = true;
+}
+
+void Profiler::prune()
+{
+    // Entered sections are kept along with the sections enclosing them,
+    // which were entered as well. Nodes come after their parents, so the
+    // new index of a parent is known before its children get there.
+    std::vector<int> newIndex(mNodes.size(), -1);
+    std::vector<Node> nodes;
+
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        const Node &node = mNodes[i];
+
+        if (i > 0 && (node.lastCalls == 0 || newIndex[node.parent] < 0))
+            continue;
+
+        newIndex[i] = nodes.size();
+        nodes.push_back(node);
+        nodes.back().children.clear();
+
+        if (i > 0)
+        {
+            nodes.back().parent = newIndex[node.parent];
+            nodes[newIndex[node.parent]].children.push_back(newIndex[i]);
+        }
+    }
+
+    mNodes.swap(nodes);
+}
+
+bool Profiler::saveTrace(const std::string &fileName)
+{
+    FILE *file = fopen(fileName.c_str(), "w");
+
+    if (!file)
+    {
+        logger->log("Profiler::saveTrace(): Couldn't open %s for writing",
+                    fileName.c_str());
+        return false;
+    }
+
+    // Sections are recorded when they are left, so the enclosing ones come
+    // after the sections they started before
+    uint64_t traceStart = mFrameStart;
+    for (size_t i = 0; i < mTrace.size(); i++)
+    {
+        if (mTrace[i].start < traceStart)
+            traceStart = mTrace[i].start;
+    }
+
+    fputs("{\"traceEvents\":[\n", file);
+
+    // Once the ring is full, the oldest event is the next to be replaced
+    for (size_t i = 0; i < mTrace.size(); i++)
+    {
+        const TraceEvent &event = mTrace[(mTraceNext + i) % mTrace.size()];
+
+        fputs(i > 0 ? ",\n{\"name\":\"" : "{\"name\":\"", file);
+        for (const char *c = event.name; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                fputc('\\', file);
+            fputc(*c, file);
+        }
+        fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                      "\"ts\":%llu,\"dur\":%llu}",
+                (unsigned long long) (event.start - traceStart),
+                (unsigned long long) event.duration);
+    }
+
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file);
+
+    const bool written = !ferror(file);
+    fclose(file);
+
+    if (written)
+        logger->log("Saved %d profiled sections to %s", (int) mTrace.size(),
+                    fileName.c_str());
+    else
+        logger->log("Profiler::saveTrace(): Couldn't write %s",
+                    fileName.c_str());
+
+    return written;
+}
+
+bool Profiler::enter(const char *name)
+{
+    // Other threads would need a tree of their own
+    if (SDL_ThreadID() != mThread)
+        return false;
+
+    const int parent = mOpen.empty() ? 0 : mOpen.back().node;
+    const std::vector<int> &children = mNodes[parent].children;
+    int node = -1;
+
+    // Names are usually string literals, so comparing the pointers is
+    // enough most of the time
+    for (size_t i = 0; i < children.size() && node < 0; i++)
+    {
+        const char *childName = mNodes[children[i]].name;
+        if (childName == name || strcmp(childName, name) == 0)
+            node = children[i];
+    }
+
+    if (node < 0)
+    {
+        Node child;
+        child.name = name;
+        child.parent = parent;
+        child.depth = mNodes[parent].depth + 1;
+        child.calls = 0;
+        child.time = 0;
+        child.lastCalls = 0;
+        for (int i = 0; i < FRAME_HISTORY; i++)
+            child.frameTimes[i] = 0.0;
+
+        node = mNodes.size();
+        mNodes.push_back(child);
+        mNodes[parent].children.push_back(node);
+    }
+
+    Open open;
+    open.node = node;
+    open.start = FrameClock::now();
+    mOpen.push_back(open);
+
+    return true;
+}
+
+void Profiler::leave()
+{
+    const Open open = mOpen.back();
+    mOpen.pop_back();
+
+    const uint64_t duration = FrameClock::now() - open.start;
+    Node &node = mNodes[open.node];
+
+    node.calls++;
+    node.time += duration;
+
+    record(node.name, open.start, duration);
+}
+
+void Profiler::endFrame()
+{
+    if (mStarting)
+    {
+        start();
+        return;
+    }
+
+    if (!mEnabled)
+        return;
+
+    const uint64_t time = FrameClock::now();
+    Node &root = mNodes[0];
+
+    root.calls = 1;
+    root.time = time - mFrameStart;
+    record(root.name, mFrameStart, root.time);
+    mFrameStart = time;
+
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        Node &node = mNodes[i];
+        node.frameTimes[mFrameIndex] = node.time / 1000.0;
+        node.lastCalls = node.calls;
+        node.calls = 0;
+        node.time = 0;
+    }
+
+    mFrameIndex = (mFrameIndex + 1) % FRAME_HISTORY;
+    if (mFrameCount < FRAME_HISTORY)
+        mFrameCount++;
+
+    if (mFrameCount == 1)
+        prune();
+}
+
+void Profiler::getSections(std::vector<Section> &sections)
+{
+    sections.clear();
+
+    if (!mNodes.empty())
+        addSections(0, sections);
+}
+
+void Profiler::addSections(const int index, std::vector<Section> &sections)
+{
+    const Node &node = mNodes[index];
+    Section section;
+
+    section.name = node.name;
+    section.depth = node.depth;
+    section.calls = node.lastCalls;
+    section.frameTime = 0.0;
+    section.averageTime = 0.0;
+    section.longestTime = 0.0;
+
+    if (mFrameCount > 0)
+    {
+        const int last = (mFrameIndex + FRAME_HISTORY - 1) % FRAME_HISTORY;
+        section.frameTime = node.frameTimes[last];
+
+        for (int i = 0; i < mFrameCount; i++)
+        {
+            section.averageTime += node.frameTimes[i];
+            if (node.frameTimes[i] > section.longestTime)
+                section.longestTime = node.frameTimes[i];
+        }
+        section.averageTime /= mFrameCount;
+    }
+
+    sections.push_back(section);
+
+    for (size_t i = 0; i < node.children.size(); i++)
+        addSections(node.children[i], sections);
+}
+
+void Profiler::record(const char *name, const uint64_t start,
+                      const uint64_t duration)
+{
+    TraceEvent event;
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+
+    if ((int) mTrace.size() < MAX_TRACE_EVENTS)
+    {
+        mTrace.push_back(event);
+    }
+    else
+    {
+        mTrace[mTraceNext] = event;
+        mTraceNext = (mTraceNext + 1) % MAX_TRACE_EVENTS;
+    }
+}
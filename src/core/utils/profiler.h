@@ -0,0 +1,182 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * Times named sections of the main loop, nested the way they are entered,
+ * so that a slow frame can be traced back to the part of the engine which
+ * caused it. The sections are marked with a ProfileScope.
+ *
+ * Only the main thread is timed, sections entered by other threads are
+ * skipped. While the profiler is disabled, entering a section only costs
+ * checking a flag.
+ *
+ * Besides the statistics, the profiler records the sections it timed most
+ * recently, which can be saved as a Chrome trace (chrome://tracing).
+ */
+class Profiler
+{
+    public:
+        /**
+         * The statistics of a section, at the place it has in the tree of
+         * sections.
+         */
+        struct Section
+        {
+            const char *name;
+            int depth;              /**< Number of enclosing sections */
+            int calls;              /**< Times entered in the last frame */
+            double frameTime;       /**< Time spent in the last frame */
+            double averageTime;     /**< Average time per recent frame */
+            double longestTime;     /**< Longest time of recent frames */
+        };
+
+        /**
+         * Starts or stops timing. Since this is usually called in the middle
+         * of a frame, timing starts with the next frame, when endFrame() is
+         * called. Starting makes the calling thread the one which is timed,
+         * and discards the statistics and trace of before.
+         */
+        static void setEnabled(const bool enabled);
+
+        static bool isEnabled() { return mEnabled; }
+
+        /**
+         * Saves the sections recorded for the trace in the Chrome trace
+         * format. Returns whether the file was written.
+         */
+        static bool saveTrace(const std::string &fileName);
+
+        /**
+         * Enters a section. Returns false when the section isn't timed,
+         * in which case it must not be left.
+         */
+        static bool enter(const char *name);
+
+        /**
+         * Leaves the section entered last.
+         */
+        static void leave();
+
+        /**
+         * Ends the current frame, adding the time spent in each section to
+         * the recent statistics. Called once per frame, outside of any
+         * section.
+         */
+        static void endFrame();
+
+        /**
+         * Returns the statistics of all sections, each followed by the
+         * sections it encloses.
+         */
+        static void getSections(std::vector<Section> &sections);
+
+    private:
+        enum { FRAME_HISTORY = 120 };
+
+        /** Sections kept for the trace, the oldest are dropped first */
+        enum { MAX_TRACE_EVENTS = 200000 };
+
+        struct Node
+        {
+            const char *name;
+            int parent;
+            int depth;
+            std::vector<int> children;
+            int calls;
+            uint64_t time;                  /**< Time in the current frame */
+            int lastCalls;
+            double frameTimes[FRAME_HISTORY];
+        };
+
+        struct Open
+        {
+            int node;
+            uint64_t start;
+        };
+
+        struct TraceEvent
+        {
+            const char *name;
+            uint64_t start;
+            uint64_t duration;
+        };
+
+        /**
+         * Starts timing, at the end of the frame timing was enabled in.
+         */
+        static void start();
+
+        /**
+         * Removes the sections which weren't entered in the last frame.
+         */
+        static void prune();
+
+        static void addSections(const int node, std::vector<Section> &sections);
+
+        static void record(const char *name, const uint64_t start,
+                           const uint64_t duration);
+
+        static bool mEnabled;
+        static bool mStarting;              /**< Enabled from the next frame */
+        static uint32_t mThread;            /**< The thread which is timed */
+        static std::vector<Node> mNodes;    /**< The tree, rooted at node 0 */
+        static std::vector<Open> mOpen;     /**< Entered, innermost last */
+        static std::vector<TraceEvent> mTrace;
+        static int mTraceNext;              /**< Oldest event, once full */
+        static uint64_t mFrameStart;
+        static int mFrameIndex;
+        static int mFrameCount;
+};
+
+/**
+ * Times the section which it lives in, from its construction until it goes
+ * out of scope. The name has to stay valid as long as the profiler runs,
+ * so usually it is a string literal.
+ */
+class ProfileScope
+{
+    public:
+        ProfileScope(const char *name):
+            mEntered(Profiler::isEnabled() && Profiler::enter(name))
+        {}
+
+        ~ProfileScope()
+        {
+            if (mEntered)
+                Profiler::leave();
+        }
+
+    private:
+        ProfileScope(const ProfileScope&);  // prevent copying
+        ProfileScope& operator=(const ProfileScope&);
+
+        const bool mEntered;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+/**
+ * A small and fast pseudo random number generator (Marsaglia's xorshift128).
+ * Unlike rand(), every generator has its own state, so a sequence can be
+ * reproduced by seeding a generator with the same value again.
+ */
+class Random
+{
+    public:
+        /**
+         * Constructor.
+         */
+        Random(const unsigned int seed = 1) { setSeed(seed); }
+
+        /**
+         * Restarts the sequence for the given seed.
+         */
+        void setSeed(unsigned int seed)
+        {
+            // Spread the seed over the state, which may never be all zero
+            for (int i = 0; i < 4; i++)
+            {
+                seed = seed * 1812433253U + 0x9e3779b9U;
+                mState[i] = seed ^ (seed >> 15);
+            }
+
+            if (!(mState[0] | mState[1] | mState[2] | mState[3]))
+                mState[0] = 1;
+        }
+
+        /**
+         * Returns the next 32 random bits.
+         */
+        unsigned int next()
+        {
+            unsigned int t = mState[3];
+            t ^= t << 11;
+            t ^= t >> 8;
+            mState[3] = mState[2];
+            mState[2] = mState[1];
+            mState[1] = mState[0];
+            mState[0] ^= (mState[0] >> 19) ^ t;
+            return mState[0];
+        }
+
+        /**
+         * Returns a number from 0 up to, but not including, the given range,
+         * which has to be positive.
+         */
+        int nextInt(const int range) { return (int) (next() % range); }
+
+        /**
+         * Returns a number from 0 up to, but not including, 1.
+         */
+        double nextDouble() { return next() * (1.0 / 4294967296.0); }
+
+    private:
+        unsigned int mState[4];
+};
+
+#endif
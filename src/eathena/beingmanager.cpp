@@ -25,6 +25,9 @@
 #include "net/messageout.h"
 #include "net/protocol.h"
 
+#include "../core/map/beinggrid.h"
+#include "../core/map/map.h"
+
 #include "../core/map/sprite/localplayer.h"
 #include "../core/map/sprite/monster.h"
 #include "../core/map/sprite/npc.h"
@@ -48,7 +51,29 @@ class FindBeingFunctor
         Being::Type type;
 } beingFinder;
 
-BeingManager::BeingManager()
+class FindBeingByPixelFunctor
+{
+    public:
+        bool operator() (Being *being)
+        {
+            const int xtol = being->getWidth();
+            const int uptol = being->getHeight() / 2;
+
+            return ((being->mAction != Being::DEAD) &&
+                    (being != player_node) &&
+                    (being->getPixelX() <= x) &&
+                    (being->getPixelX() + xtol >= x) &&
+                    (being->getPixelY() - uptol <= y) &&
+                    (being->getPixelY() + uptol >= y));
+        }
+
+        int x, y;
+} pixelFinder;
+
+BeingManager::BeingManager():
+    mMap(NULL),
+    mMaxBeingWidth(0),
+    mMaxBeingHeight(0)
 {
 }
 
@@ -129,6 +154,10 @@ Being *BeingManager::findBeing(int x, int y, Being::Type type) const
     beingFinder.y = y;
     beingFinder.type = type;
 
+    // NPCs are also found from the tile below them
+    if (mMap)
+        return mMap->getBeingGrid()->find(x, y, x, y + 1, beingFinder);
+
     Beings::const_iterator i = find_if(mBeings.begin(), mBeings.end(),
                                        beingFinder);
 
@@ -137,28 +166,28 @@ Being *BeingManager::findBeing(int x, int y, Being::Type type) const
 
 Being *BeingManager::findBeingByPixel(int x, int y) const
 {
-    Beings::const_iterator itr = mBeings.begin();
-    Beings::const_iterator itr_end = mBeings.end();
+    pixelFinder.x = x;
+    pixelFinder.y = y;
 
-    for (; itr != itr_end; ++itr)
+    if (mMap)
     {
-        Being *being = (*itr);
-
-        int xtol = being->getWidth();
-        int uptol = being->getHeight() / 2;
-
-        if ((being->mAction != Being::DEAD) &&
-            (being != player_node) &&
-            (being->getPixelX() <= x) &&
-            (being->getPixelX() + xtol >= x) &&
-            (being->getPixelY() - uptol <= y) &&
-            (being->getPixelY() + uptol >= y))
-        {
-            return being;
-        }
+        // Beings are drawn up to a tile away from their position while
+        // walking, and may be larger than a tile
+        const int tileWidth = mMap->getTileWidth();
+        const int tileHeight = mMap->getTileHeight();
+        const int minX = (x - mMaxBeingWidth) / tileWidth - 2;
+        const int minY = (y - mMaxBeingHeight / 2) / tileHeight - 2;
+        const int maxX = x / tileWidth + 2;
+        const int maxY = (y + mMaxBeingHeight / 2) / tileHeight + 2;
+
+        return mMap->getBeingGrid()->find(minX, minY, maxX, maxY,
+                                          pixelFinder);
     }
 
-    return NULL;
+    Beings::const_iterator i = find_if(mBeings.begin(), mBeings.end(),
+                                       pixelFinder);
+
+    return (i == mBeings.end()) ? NULL : *i;
 }
 
 Being *BeingManager::findBeingByName(const std::string &name,
@@ -189,6 +218,10 @@ void BeingManager::logic()
 
         being->logic();
 
+        // Keep track of the largest being for the pixel lookups
+        mMaxBeingWidth = std::max(mMaxBeingWidth, being->getWidth());
+        mMaxBeingHeight = std::max(mMaxBeingHeight, being->getHeight());
+
         if (being->mAction == Being::DEAD && being->mFrame >= 20)
         {
             destroy(being);
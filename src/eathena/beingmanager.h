@@ -128,6 +128,9 @@ class BeingManager
     protected:
         Beings mBeings;
         Map *mMap;
+
+        int mMaxBeingWidth;     /**< Largest being width seen, in pixels */
+        int mMaxBeingHeight;    /**< Largest being height seen, in pixels */
 };
 
 extern BeingManager *beingManager;
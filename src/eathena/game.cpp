@@ -90,10 +90,12 @@
 #include "../core/log.h"
 
 #include "../core/image/particle/particle.h"
+#include "../core/image/particle/particlescheduler.h"
 
 #include "../core/map/sprite/localplayer.h"
 
 #include "../core/utils/dtor.h"
+#include "../core/utils/profiler.h"
 
 EmoteShortcut *emoteShortcut = NULL;
 ItemShortcut *itemShortcut = NULL;
@@ -244,6 +246,7 @@ Game::Game():
 
     particleEngine = new Particle(NULL);
     particleEngine->setupEngine();
+    mParticleScheduler = new ParticleScheduler(particleEngine);
 
     // Create the viewport
     viewport = new Viewport();
@@ -279,6 +282,7 @@ Game::~Game()
     destroy(beingManager);
     destroy(floorItemManager);
     destroy(player_node);
+    destroy(mParticleScheduler);
     destroy(particleEngine);
     destroy(viewport);
 
@@ -297,16 +301,12 @@ Game::~Game()
 
 void Game::logic()
 {
+    ProfileScope scope("Game::logic");
+
     beingManager->logic();
 
-    // Update the particle engine
-    // TODO: Modify the particle engine to be able to update asynchronously
-    //       based on the ticks elapsed since the last update.
-    while (get_elapsed_time(mGameTime) > 0)
-    {
-        particleEngine->update();
-        mGameTime++;
-    }
+    // Update the particle engine, within its time budget
+    mParticleScheduler->update(get_elapsed_time(mGameTime) / 10);
 
     if (!network->isConnected())
         network->interrupt();
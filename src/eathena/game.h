@@ -27,6 +27,7 @@
 #include <string>
 
 class MessageHandler;
+class ParticleScheduler;
 
 class Game
 {
@@ -38,6 +39,7 @@ class Game
 
     private:
         int mGameTime;
+        ParticleScheduler *mParticleScheduler;
 
         typedef const std::auto_ptr<MessageHandler> MessageHandlerPtr;
         MessageHandlerPtr mBeingHandler;
@@ -20,23 +20,45 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "../../../config.h"
+#endif
+
+#include <ctime>
+
 #include "debugwindow.h"
 #include "viewport.h"
 
 #include "../../bindings/guichan/gui.h"
 #include "../../bindings/guichan/layout.h"
 
+#include "../../bindings/guichan/widgets/button.h"
+#include "../../bindings/guichan/widgets/checkbox.h"
 #include "../../bindings/guichan/widgets/label.h"
+#include "../../bindings/guichan/widgets/scrollarea.h"
+#include "../../bindings/guichan/widgets/textbox.h"
+
+#ifdef USE_OPENGL
+#include "../../bindings/guichan/opengl/openglgraphics.h"
+#endif
 
 #include "../../bindings/sdl/sound.h"
 
+#include "../../core/image/image.h"
+
 #include "../../core/image/particle/particle.h"
 
 #include "../../core/map/map.h"
 
 #include "../../core/utils/gettext.h"
+#include "../../core/utils/profiler.h"
 #include "../../core/utils/stringutils.h"
 
+#include "../../engine.h"
+
+/** Frames between updates of the profiler statistics */
+const int PROFILE_INTERVAL = 30;
+
 DebugWindow::DebugWindow():
     Window(_("Debug"))
 {
@@ -45,7 +67,7 @@ DebugWindow::DebugWindow():
 
     setResizable(true);
     setCloseButton(true);
-    setDefaultSize(400, 100, ImageRect::CENTER);
+    setDefaultSize(400, 300, ImageRect::CENTER);
 
     mFPSLabel = new Label(strprintf(_("%d FPS"), 0));
     mMusicFileLabel = new Label(strprintf(_("Music: %s"), ""));
@@ -53,6 +75,27 @@ DebugWindow::DebugWindow():
     mMiniMapLabel = new Label(strprintf(_("Minimap: %s"), ""));
     mTileMouseLabel = new Label(strprintf(_("Cursor: (%d, %d)"), 0, 0));
     mParticleCountLabel = new Label(strprintf(_("Particle count: %d"), 0));
+    mDrawCallLabel = new Label(strprintf(_("Draw calls: %d, texture binds: %d"),
+                                         0, 0));
+    mFrameTimeLabel = new Label(strprintf(_("Frame time: %.1f ms, "
+                                            "deviation: %.2f ms, "
+                                            "longest: %.1f ms"),
+                                          0.0, 0.0, 0.0));
+
+    mProfileCheckBox = new CheckBox(_("Profile"), Profiler::isEnabled());
+    mProfileCheckBox->setActionEventId("profile");
+    mProfileCheckBox->addActionListener(this);
+
+    mSaveTraceButton = new Button(_("Save trace"), "trace", this);
+    mSaveTraceButton->setEnabled(Profiler::isEnabled());
+
+    mProfileBox = new TextBox();
+
+    mProfileScrollArea = new ScrollArea(mProfileBox);
+    mProfileScrollArea->setHorizontalScrollPolicy(gcn::ScrollArea::SHOW_AUTO);
+    mProfileScrollArea->setVerticalScrollPolicy(gcn::ScrollArea::SHOW_ALWAYS);
+
+    mProfileFrames = 0;
 
     fontChanged();
     loadWindowState();
@@ -74,6 +117,14 @@ void DebugWindow::fontChanged()
     place(3, 1, mParticleCountLabel);
     place(0, 2, mMapLabel, 4);
     place(0, 3, mMiniMapLabel, 4);
+    place(0, 4, mDrawCallLabel, 4);
+    place(0, 5, mFrameTimeLabel, 4);
+    place(0, 6, mProfileCheckBox, 3);
+    place(3, 6, mSaveTraceButton);
+    place(0, 7, mProfileScrollArea, 4).setPadding(3);
+
+    Layout &layout = getLayout();
+    layout.setRowHeight(7, Layout::AUTO_SET);
 
     restoreFocus();
 }
@@ -97,6 +148,33 @@ void DebugWindow::logic()
         return;
 
     mFPSLabel->setCaption(strprintf(_("%d FPS"), fps));
+    mFrameTimeLabel->setCaption(strprintf(_("Frame time: %.1f ms, "
+                                            "deviation: %.2f ms, "
+                                            "longest: %.1f ms"),
+                                          frameClock.getAverageFrameTime(),
+                                          frameClock.getFrameTimeDeviation(),
+                                          frameClock.getLongestFrameTime()));
+
+#ifdef USE_OPENGL
+    // Only OpenGL has draw calls and textures to switch between
+    if (Image::getLoadAsOpenGL())
+    {
+        mDrawCallLabel->setCaption(strprintf(
+            _("Draw calls: %d, texture binds: %d"),
+            OpenGLGraphics::getDrawCallCount(),
+            OpenGLGraphics::getBindCount()));
+    }
+    else
+#endif
+        mDrawCallLabel->setCaption("");
+
+    // Rebuilding the text every frame would cost more than what it shows
+    if (Profiler::isEnabled() && --mProfileFrames <= 0)
+    {
+        updateProfile();
+        mProfileFrames = PROFILE_INTERVAL;
+    }
+
     mMusicFileLabel->setCaption(strprintf(_("Music: %s"),
                                           sound.getCurrentTrack().c_str()));
 
@@ -105,17 +183,17 @@ void DebugWindow::logic()
 
     Map *currentMap = viewport->getMap();
 
-    // Get the current mouse position
-    const int mouseTileX = (gui->getMouseX() + viewport->getCameraX()) /
-                            currentMap->getTileWidth();
-    const int mouseTileY = (gui->getMouseY() + viewport->getCameraY()) /
-                            currentMap->getTileHeight();
-
-    mTileMouseLabel->setCaption(strprintf(_("Cursor: (%d, %d)"), mouseTileX,
-                                            mouseTileY));
-
+    // The map is still being loaded right after logging in
     if (currentMap)
     {
+        // Get the current mouse position
+        const int mouseTileX = (gui->getMouseX() + viewport->getCameraX()) /
+                                currentMap->getTileWidth();
+        const int mouseTileY = (gui->getMouseY() + viewport->getCameraY()) /
+                                currentMap->getTileHeight();
+
+        mTileMouseLabel->setCaption(strprintf(_("Cursor: (%d, %d)"),
+                                              mouseTileX, mouseTileY));
         mMiniMapLabel->setCaption(strprintf(_("Minimap: %s"),
                                             currentMap->getProperty("minimap").c_str()));
         mMapLabel->setCaption(strprintf(_("Map: %s"),
@@ -125,3 +203,49 @@ void DebugWindow::logic()
     mParticleCountLabel->setCaption(strprintf(_("Particle count: %d"),
                                                  Particle::particleCount));
 }
+
+void DebugWindow::action(const gcn::ActionEvent &event)
+{
+    if (event.getId() == "profile")
+    {
+        const bool enabled = mProfileCheckBox->isSelected();
+
+        Profiler::setEnabled(enabled);
+        mSaveTraceButton->setEnabled(enabled);
+        mProfileFrames = 0;
+
+        if (!enabled)
+            mProfileBox->setText("");
+    }
+    else if (event.getId() == "trace")
+    {
+        const std::string fileName = engine->getHomeDir() +
+            strprintf("/trace-%ld.json", (long) time(NULL));
+
+        Profiler::saveTrace(fileName);
+    }
+}
+
+void DebugWindow::updateProfile()
+{
+    std::vector<Profiler::Section> sections;
+    Profiler::getSections(sections);
+
+    std::string text;
+
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        const Profiler::Section &section = sections[i];
+
+        if (i > 0)
+            text += "\n";
+
+        text += std::string(section.depth * 4, ' ') +
+                strprintf(_("%s: %.2f ms, average %.2f ms, longest %.2f ms, "
+                            "%d calls"), section.name, section.frameTime,
+                          section.averageTime, section.longestTime,
+                          section.calls);
+    }
+
+    mProfileBox->setText(text);
+}
@@ -25,6 +25,11 @@
 
 #include "../../bindings/guichan/widgets/window.h"
 
+class Button;
+class CheckBox;
+class ScrollArea;
+class TextBox;
+
 /**
  * The debug window.
  *
@@ -49,11 +54,28 @@ class DebugWindow : public Window
          */
         void widgetShown(const gcn::Event& event);
 
+        /**
+         * Called when receiving actions from the widgets.
+         */
+        void action(const gcn::ActionEvent &event);
+
         void fontChanged();
     private:
+        /**
+         * Shows the sections timed by the profiler.
+         */
+        void updateProfile();
+
         gcn::Label *mMusicFileLabel, *mMapLabel, *mMiniMapLabel;
         gcn::Label *mTileMouseLabel, *mFPSLabel;
         gcn::Label *mParticleCountLabel;
+        gcn::Label *mDrawCallLabel;
+        gcn::Label *mFrameTimeLabel;
+        CheckBox *mProfileCheckBox;
+        Button *mSaveTraceButton;
+        TextBox *mProfileBox;
+        ScrollArea *mProfileScrollArea;
+        int mProfileFrames;           /**< Frames until the next update */
 };
 
 extern DebugWindow *debugWindow;
@@ -50,7 +50,8 @@
 #include "../../core/image/particle/particle.h"
 
 #include "../../core/map/map.h"
-#include "../../core/map/mapreader.h"
+#include "../../core/map/maploader.h"
+#include "../../core/map/pathfinder.h"
 
 #include "../../core/map/sprite/localplayer.h"
 #include "../../core/map/sprite/npc.h"
@@ -62,9 +63,13 @@
 Viewport::Viewport():
     mCurrentMap(NULL),
     mMapName(""),
+    mMapLoader(new MapLoader),
+    mLastPrefetch(tick_time),
     mLastTick(tick_time),
     mPixelViewX(0.0f),
     mPixelViewY(0.0f),
+    mDrawnViewX(0),
+    mDrawnViewY(0),
     mTileViewX(0),
     mTileViewY(0),
     mShowDebugPath(false),
@@ -124,6 +129,7 @@ Viewport::Viewport():
 Viewport::~Viewport()
 {
     destroy(mCurrentMap);
+    destroy(mMapLoader);
     destroy(mPopupMenu);
 }
 
@@ -134,14 +140,29 @@ void Viewport::setMap(Map *map)
 
 std::string Viewport::getMapPath()
 {
-    return mCurrentMap->getProperty("_filename");
+    return mCurrentMap ? mCurrentMap->getProperty("_filename") : "";
+}
+
+/**
+ * Returns how far lazy scrolling moves the camera towards the target in one
+ * logic step.
+ */
+static float scrollStep(const int target, const float view, const int radius,
+                        const int laziness)
+{
+    if (target > view + radius)
+        return (target - view - radius) / laziness;
+    if (target < view - radius)
+        return (target - view + radius) / laziness;
+
+    return 0.0f;
 }
 
 void Viewport::draw(gcn::Graphics *graphics)
 {
     static int lastTick = tick_time;
 
-    if (!mCurrentMap || !player_node)
+    if (!mCurrentMap || !player_node || !mPendingMap.empty())
     {
         graphics->setColor(gcn::Color(64, 64, 64));
         graphics->fillRectangle(gcn::Rectangle(0, 0, getWidth(), getHeight()));
@@ -183,26 +204,10 @@ void Viewport::draw(gcn::Graphics *graphics)
     // Apply lazy scrolling
     while (lastTick < tick_time)
     {
-        if (player_x > mPixelViewX + xScrollRadius)
-        {
-            mPixelViewX += (player_x - mPixelViewX - xScrollRadius) /
-                            xScrollLaziness;
-        }
-        if (player_x < mPixelViewX - xScrollRadius)
-        {
-            mPixelViewX += (player_x - mPixelViewX + xScrollRadius) /
-                            xScrollLaziness;
-        }
-        if (player_y > mPixelViewY + yScrollRadius)
-        {
-            mPixelViewY += (player_y - mPixelViewY - yScrollRadius) /
-                            yScrollLaziness;
-        }
-        if (player_y < mPixelViewY - yScrollRadius)
-        {
-            mPixelViewY += (player_y - mPixelViewY + yScrollRadius) /
-                            yScrollLaziness;
-        }
+        mPixelViewX += scrollStep(player_x, mPixelViewX, xScrollRadius,
+                                  xScrollLaziness);
+        mPixelViewY += scrollStep(player_y, mPixelViewY, yScrollRadius,
+                                  yScrollLaziness);
 
         // manage shake effect
         for (ShakeEffects::iterator i = mShakeEffects.begin();
@@ -251,10 +256,42 @@ void Viewport::draw(gcn::Graphics *graphics)
     mTileViewX = (int) (mPixelViewX + (tileWidth / 2)) / tileWidth;
     mTileViewY = (int) (mPixelViewY + (tileHeight / 2)) / tileHeight;
 
+    // Draw the camera part of the way to where the next logic step moves it,
+    // like the beings which are drawn between their steps as well
+    const float fraction = frameClock.getStepFraction();
+    float viewX = mPixelViewX + fraction * scrollStep(player_x, mPixelViewX,
+                                                      xScrollRadius,
+                                                      xScrollLaziness);
+    float viewY = mPixelViewY + fraction * scrollStep(player_y, mPixelViewY,
+                                                      yScrollRadius,
+                                                      yScrollLaziness);
+
+    if (viewX < 0)
+        viewX = 0;
+    if (viewY < 0)
+        viewY = 0;
+    if (viewX > viewXmax)
+        viewX = viewXmax;
+    if (viewY > viewYmax)
+        viewY = viewYmax;
+
+    // Everything on the map moves when the camera scrolls, so there is no
+    // point in looking for the changed areas of the frame
+    if ((int) viewX != mDrawnViewX || (int) viewY != mDrawnViewY)
+    {
+        g->invalidate();
+        mDrawnViewX = (int) viewX;
+        mDrawnViewY = (int) viewY;
+    }
+
+    // Emitters far off screen can sleep
+    Particle::setActiveArea(mDrawnViewX, mDrawnViewY,
+                            g->getWidth(), g->getHeight());
+
     // Draw tiles and sprites
     if (mCurrentMap)
     {
-        mCurrentMap->draw(g, (int) mPixelViewX, (int) mPixelViewY);
+        mCurrentMap->draw(g, mDrawnViewX, mDrawnViewY);
 
         // Find a path from the player to the mouse, and draw it. This is for
         // debug purposes.
@@ -266,19 +303,24 @@ void Viewport::draw(gcn::Graphics *graphics)
             const int mouseTileX = mouseX / tileWidth + mTileViewX;
             const int mouseTileY = mouseY / tileHeight + mTileViewY;
 
-            Path debugPath = mCurrentMap->findPath(player_node->mX, player_node->mY,
-                                            mouseTileX, mouseTileY);
+            // The costs shown are those of the search, which the path cache
+            // would split into legs or skip altogether
+            Path debugPath = mCurrentMap->findExactPath(player_node->mX,
+                                                        player_node->mY,
+                                                        mouseTileX, mouseTileY);
+
+            const PathFinder *pathFinder = mCurrentMap->getPathFinder();
 
             g->setColor(gcn::Color(255, 0, 0));
             for (PathIterator i = debugPath.begin(); i != debugPath.end(); i++)
             {
-                const int squareX = i->x * tileWidth - (int) mPixelViewX + 
+                const int squareX = i->x * tileWidth - mDrawnViewX +
                                     (tileWidth / 2) - 4;
-                const int squareY = i->y * tileHeight - (int) mPixelViewY +
+                const int squareY = i->y * tileHeight - mDrawnViewY +
                                     (tileHeight / 2) - 4;
 
                 g->fillRectangle(gcn::Rectangle(squareX, squareY, 8, 8));
-                g->drawText(toString(mCurrentMap->getMetaTile(i->x, i->y)->Gcost),
+                g->drawText(toString(pathFinder->getCost(i->x, i->y)),
                                    squareX + 4, squareY + (tileHeight / 2) - 4,
                                    gcn::Graphics::CENTER);
             }
@@ -293,15 +335,15 @@ void Viewport::draw(gcn::Graphics *graphics)
 
     // Draw text
     if (textManager)
-        textManager->draw(g, (int) mPixelViewX, (int) mPixelViewY);
+        textManager->draw(g, mDrawnViewX, mDrawnViewY);
 
     // Draw player names, speech, and emotion sprite as needed
     const Beings &beings = beingManager->getAll();
     for (Beings::const_iterator i = beings.begin(), i_end = beings.end();
          i != i_end; ++i)
     {
-        (*i)->drawSpeech((int) mPixelViewX, (int) mPixelViewY);
-        (*i)->drawEmotion(g, (int) mPixelViewX, (int) mPixelViewY);
+        (*i)->drawSpeech(mDrawnViewX, mDrawnViewY);
+        (*i)->drawEmotion(g, mDrawnViewX, mDrawnViewY);
     }
 
     drawChildren(g);
@@ -326,15 +368,26 @@ void Viewport::logic()
 {
     Container::logic();
 
+    mMapLoader->logic();
+
+    if (!mPendingMap.empty() && mMapLoader->isDone(mPendingMap))
+        finishMapChange();
+
+    if (!mCurrentMap || !player_node || !mPendingMap.empty())
+        return;
+
+    if (get_elapsed_time(mLastPrefetch) > 500)
+    {
+        prefetchWarps();
+        mLastPrefetch = tick_time;
+    }
+
     const int mouseX = gui->getMouseX();
     const int mouseY = gui->getMouseY();
     const int tileWidth = mCurrentMap->getTileWidth();
     const int tileHeight = mCurrentMap->getTileHeight();
     const uint8_t button = gui->getButtonState();
 
-    if (!mCurrentMap || !player_node)
-        return;
-
     if (mPlayerFollowMouse && button & SDL_BUTTON(1) &&
         mWalkTime != player_node->mWalkTime)
     {
@@ -359,8 +412,8 @@ void Viewport::mousePressed(gcn::MouseEvent &event)
     const int tileHeight = mCurrentMap->getTileHeight();
     const int tilex = event.getX() / tileWidth + mTileViewX;
     const int tiley = event.getY() / tileHeight + mTileViewY;
-    const int x = (int)((float) event.getX() + mPixelViewX);
-    const int y = (int)((float) event.getY() + mPixelViewY);
+    const int x = event.getX() + mDrawnViewX;
+    const int y = event.getY() + mDrawnViewY;
 
     // Right click might open a popup
     if (event.getButton() == gcn::MouseEvent::RIGHT)
@@ -478,6 +531,9 @@ void Viewport::closePopupMenu()
 
 void Viewport::scrollBy(int x, int y)
 {
+    if (!mCurrentMap)
+        return;
+
     mPixelViewX += (float) (x * mCurrentMap->getTileWidth());
     mPixelViewY += (float) (y * mCurrentMap->getTileHeight());
 }
@@ -501,14 +557,19 @@ bool Viewport::changeMap(const std::string &path)
 
     mMapName = path.substr(0, path.rfind("."));
 
-    // Store full map path in global var
-    std::string mapPath = "maps/" + mMapName + ".tmx";
-    ResourceManager *resman = ResourceManager::getInstance();
-    if (!resman->exists(mapPath))
-        mapPath += ".gz";
+    // Start loading the new map, which is picked up by logic() once it's done
+    mPendingMap = findMapFile(mMapName);
+    mMapLoader->load(mPendingMap);
+
+    return true;
+}
+
+void Viewport::finishMapChange()
+{
+    const std::string mapPath = mPendingMap;
+    mPendingMap.clear();
 
-    // Attempt to load the new map
-    Map *newMap = MapReader::readMap(mapPath);
+    Map *newMap = mMapLoader->take(mapPath);
 
     if (!newMap)
     {
@@ -522,6 +583,9 @@ bool Viewport::changeMap(const std::string &path)
     beingManager->setMap(newMap);
     particleEngine->setMap(newMap);
 
+    // Emitters on the new map aren't judged by the area of the old one
+    Particle::clearActiveArea();
+
     keyboard.refreshActiveKeys();
 
     // Initialize map-based particle effects
@@ -545,6 +609,34 @@ bool Viewport::changeMap(const std::string &path)
 
     setMap(newMap);
     MessageOut outMsg(CMSG_MAP_LOADED);
+}
 
-    return true;
+void Viewport::prefetchWarps()
+{
+    // Warps closer than this many tiles may be taken soon
+    const int distance = 15;
+
+    const MapWarps &warps = mCurrentMap->getWarps();
+
+    for (MapWarps::const_iterator i = warps.begin(); i != warps.end(); ++i)
+    {
+        if (player_node->mX >= i->x - distance &&
+            player_node->mY >= i->y - distance &&
+            player_node->mX < i->x + i->width + distance &&
+            player_node->mY < i->y + i->height + distance)
+        {
+            mMapLoader->prefetch(findMapFile(i->destination));
+        }
+    }
+}
+
+std::string Viewport::findMapFile(const std::string &mapName)
+{
+    std::string mapPath = "maps/" + mapName + ".tmx";
+    ResourceManager *resman = ResourceManager::getInstance();
+
+    if (!resman->exists(mapPath))
+        mapPath += ".gz";
+
+    return mapPath;
 }
@@ -37,6 +37,7 @@ class Graphics;
 class ImageSet;
 class Item;
 class Map;
+class MapLoader;
 class PopupMenu;
 
 /**
@@ -126,12 +127,12 @@ class Viewport : public Container, public gcn::MouseListener
         /**
          * Returns camera x offset in pixels.
          */
-        int getCameraX() const { return (int) mPixelViewX; }
+        int getCameraX() const { return mDrawnViewX; }
 
         /**
          * Returns camera y offset in pixels.
          */
-        int getCameraY() const { return (int) mPixelViewY; }
+        int getCameraY() const { return mDrawnViewY; }
 
         /**
          * Changes viewpoint by tile coordinates.
@@ -139,7 +140,8 @@ class Viewport : public Container, public gcn::MouseListener
         void scrollBy(int x, int y);
 
         /**
-         * Sets the currently active map.
+         * Sets the currently active map. The map is loaded in the background,
+         * and replaces the current map once it's done.
          */
         bool changeMap(const std::string &mapName);
 
@@ -164,8 +166,26 @@ class Viewport : public Container, public gcn::MouseListener
          */
         void setMap(Map *map);
 
+        /**
+         * Switches to the map which was being loaded.
+         */
+        void finishMapChange();
+
+        /**
+         * Starts loading the maps that warps near the player lead to.
+         */
+        void prefetchWarps();
+
+        /**
+         * Returns the map file for the given map name.
+         */
+        static std::string findMapFile(const std::string &mapName);
+
         Map *mCurrentMap;            /**< The current map. */
         std::string mMapName;
+        MapLoader *mMapLoader;
+        std::string mPendingMap;     /**< Map file being switched to. */
+        int mLastPrefetch;           /**< Last time warps were checked. */
 
         int mLastTick;
         float mScrollRadius;
@@ -174,6 +194,8 @@ class Viewport : public Container, public gcn::MouseListener
         float mScrollHeightOffset;   /**< In # of tiles */
         float mPixelViewX;           /**< Current viewpoint in pixels. */
         float mPixelViewY;           /**< Current viewpoint in pixels. */
+        int mDrawnViewX;             /**< Viewpoint of the last frame. */
+        int mDrawnViewY;             /**< Viewpoint of the last frame. */
         int mTileViewX;              /**< Current viewpoint in tiles. */
         int mTileViewY;              /**< Current viewpoint in tiles. */
         bool mShowDebugPath;         /**< Show a path from player to pointer. */
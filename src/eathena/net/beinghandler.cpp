@@ -153,14 +153,15 @@ void BeingHandler::handleMessage(MessageIn *msg)
                 uint16_t srcX, srcY, dstX, dstY;
                 msg->readCoordinatePair(srcX, srcY, dstX, dstY);
                 dstBeing->setAction(Being::STAND);
-                dstBeing->mX = srcX;
-                dstBeing->mY = srcY;
+                dstBeing->setTileCoords(srcX, srcY);
                 dstBeing->setDestination(dstX, dstY);
             }
             else
             {
                 uint8_t dir;
-                msg->readCoordinates(dstBeing->mX, dstBeing->mY, dir);
+                uint16_t x, y;
+                msg->readCoordinates(x, y, dir);
+                dstBeing->setTileCoords(x, y);
                 dstBeing->setDirection(dir);
             }
 
@@ -190,8 +191,7 @@ void BeingHandler::handleMessage(MessageIn *msg)
             if (dstBeing)
             {
                 dstBeing->setAction(Being::STAND);
-                dstBeing->mX = srcX;
-                dstBeing->mY = srcY;
+                dstBeing->setTileCoords(srcX, srcY);
                 dstBeing->setDestination(dstX, dstY);
             }
 
@@ -439,14 +439,15 @@ void BeingHandler::handleMessage(MessageIn *msg)
             {
                 uint16_t srcX, srcY, dstX, dstY;
                 msg->readCoordinatePair(srcX, srcY, dstX, dstY);
-                dstBeing->mX = srcX;
-                dstBeing->mY = srcY;
+                dstBeing->setTileCoords(srcX, srcY);
                 dstBeing->setDestination(dstX, dstY);
             }
             else
             {
                 uint8_t dir;
-                msg->readCoordinates(dstBeing->mX, dstBeing->mY, dir);
+                uint16_t x, y;
+                msg->readCoordinates(x, y, dir);
+                dstBeing->setTileCoords(x, y);
                 dstBeing->setDirection(dir);
             }
 
@@ -492,8 +493,9 @@ void BeingHandler::handleMessage(MessageIn *msg)
                 dstBeing = beingManager->findBeing(id);
                 if (dstBeing)
                 {
-                    dstBeing->mX = msg->readInt16();
-                    dstBeing->mY = msg->readInt16();
+                    const uint16_t x = msg->readInt16();
+                    const uint16_t y = msg->readInt16();
+                    dstBeing->setTileCoords(x, y);
                     if (dstBeing->mAction == Being::WALK)
                     {
                         dstBeing->mFrame = 0;
@@ -30,6 +30,7 @@
 #include "../../core/log.h"
 
 #include "../../core/utils/gettext.h"
+#include "../../core/utils/profiler.h"
 #include "../../core/utils/stringutils.h"
 
 /** Warning: buffers and other variables are shared,
@@ -195,6 +196,8 @@ void Network::clearHandlers()
 
 void Network::dispatchMessages()
 {
+    ProfileScope scope("Network::dispatchMessages");
+
     while (messageReady())
     {
         MessageIn msg = getNextMessage();
@@ -212,8 +212,7 @@ void PlayerHandler::handleMessage(MessageIn *msg)
 
                 player_node->setAction(Being::STAND);
                 player_node->mFrame = 0;
-                player_node->mX = x;
-                player_node->mY = y;
+                player_node->setTileCoords(x, y);
 
                 logger->log("Adjust scrolling by (%d, %d) tiles", scrollOffsetX,
                             scrollOffsetY);
@@ -69,6 +69,7 @@
 
 #include "../core/utils/dtor.h"
 #include "../core/utils/gettext.h"
+#include "../core/utils/profiler.h"
 #include "../core/utils/stringutils.h"
 
 #include "../main.h"
@@ -454,6 +455,8 @@ void StateManager::setState(const State state)
 
 void StateManager::logic()
 {
+    ProfileScope scope("StateManager::logic");
+
     if (game)
         game->logic();
 
@@ -461,7 +464,10 @@ void StateManager::logic()
     inputManager->handleInput();
     gui->logic();
 
-    sound.logic();
+    {
+        ProfileScope soundScope("Sound::logic");
+        sound.logic();
+    }
 
     if (network)
     {
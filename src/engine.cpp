@@ -20,6 +20,7 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <cstdlib>
 #include <physfs.h>
 
 #ifdef WIN32
@@ -48,6 +49,8 @@
 
 #include "bindings/guichan/dialogs/okdialog.h"
 
+#include "bindings/guichan/null/nullgraphics.h"
+
 #ifdef USE_OPENGL
 #include "bindings/guichan/opengl/openglgraphics.h"
 #endif
@@ -65,6 +68,7 @@
 
 #include "core/utils/dtor.h"
 #include "core/utils/gettext.h"
+#include "core/utils/jobsystem.h"
 #include "core/utils/stringutils.h"
 
 Graphics *graphics = NULL;
@@ -89,6 +93,10 @@ Engine::Engine(const char *prog)
     logger = new Logger();
     logger->setLogFile(homeDir + std::string("/runtime.log"));
 
+    // Headless runs are scripted, so show their results on the console too
+    if (options.headless)
+        logger->setLogToStandardOut(true);
+
 #ifdef PACKAGE_VERSION
     logger->log("Starting Aethyra Version %s.", PACKAGE_VERSION);
 #else
@@ -107,6 +115,11 @@ Engine::Engine(const char *prog)
     initSDL();
     initResman();
     initConfig();
+
+    // Particles and map layers share the worker threads, which need to be
+    // running before the map loader thread uses them
+    JobSystem::createInstance(config.getValue("jobThreads", 0));
+
     initWindow();
     initSound();
 
@@ -116,6 +129,10 @@ Engine::Engine(const char *prog)
 
 Engine::~Engine()
 {
+    // Report what a headless run would have drawn
+    if (options.headless)
+        static_cast<NullGraphics*>(graphics)->logCounters();
+
     destroy(gui);
     config.write();
 
@@ -129,6 +146,7 @@ Engine::~Engine()
     sound.close();
 
     ResourceManager::deleteInstance();
+    JobSystem::deleteInstance();
 
     destroy(logger);
 
@@ -160,6 +178,12 @@ void Engine::initInternationalization()
 void Engine::initSDL()
 {
     logger->log("Initializing SDL...");
+
+    // SDL's dummy video driver lets the engine run on machines without a
+    // display. Leave any driver the user asked for alone.
+    if (options.headless && !getenv("SDL_VIDEODRIVER"))
+        putenv(const_cast<char*>("SDL_VIDEODRIVER=dummy"));
+
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
         logger->error(strprintf(_("Could not initialize SDL: %s"), SDL_GetError()));
 
@@ -257,17 +281,23 @@ void Engine::initWindow()
 #endif
 
 #ifdef USE_OPENGL
-    options.promptForGraphicsMode = !config.keyExists("opengl");
-    bool useOpenGL = !options.noOpenGL && (config.getValue("opengl", 0) == 1);
+    options.promptForGraphicsMode = !options.headless &&
+                                    !config.keyExists("opengl");
+    const bool useOpenGL = !options.noOpenGL && !options.headless &&
+                           (config.getValue("opengl", 0) == 1);
 
     // Setup image loading for the right image format
     Image::setLoadAsOpenGL(useOpenGL);
+#endif
 
     // Create the graphics context
-    if (useOpenGL)
+    if (options.headless)
+        graphics = new NullGraphics();
+#ifdef USE_OPENGL
+    else if (useOpenGL)
         graphics = new OpenGLGraphics();
-    else
 #endif
+    else
         graphics = new SDLGraphics();
 
     const int width = config.getValue("screenwidth", defaultScreenWidth);
@@ -292,7 +322,7 @@ void Engine::initSound()
     logger->log("Initializing sound for playback...");
     try
     {
-        if (config.getValue("sound", 1) == 1)
+        if (config.getValue("sound", 1) == 1 && !options.headless)
             sound.init();
     }
     catch (const char *err)
@@ -0,0 +1,203 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <SDL.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "options.h"
+
+#include "core/image/particle/particle.h"
+#include "core/image/particle/particlepool.h"
+
+#include "core/utils/dtor.h"
+#include "core/utils/jobsystem.h"
+#include "core/utils/random.h"
+
+class Engine;
+class StateManager;
+
+Engine *engine = NULL;
+Options options;
+StateManager *stateManager = NULL;
+
+namespace
+{
+
+/** Number of particles the particles of every run are attracted to */
+const int TARGET_COUNT = 8;
+
+void printUsage()
+{
+    std::cerr<<"Usage: jobsystembench [-t ticks] [-w workers]"<<std::endl
+             <<"    -t number of ticks simulated per run (default 1000)"<<std::endl
+             <<"    -w highest number of workers to try (default: number of "
+               "processors)"<<std::endl;
+}
+
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/**
+ * Fills the pool with particles flying around the targets. Half of them are
+ * attracted to a target and die when they get close to it, the others bounce
+ * on the floor and move randomly, so that every part of the simulation is
+ * used. None of them run out of lifetime.
+ */
+void spawn(ParticlePool &pool, Particle *owner,
+           const std::vector<Particle*> &targets, const int count)
+{
+    Random random(1);
+
+    for (int i = 0; i < count; i++)
+    {
+        ParticlePool::Properties properties;
+        properties.position = Vector(random.nextInt(800) - 400.0f,
+                                     random.nextInt(600) - 300.0f,
+                                     random.nextInt(100));
+        properties.velocity = Vector((random.nextInt(200) - 100) / 100.0f,
+                                     (random.nextInt(200) - 100) / 100.0f,
+                                     random.nextInt(200) / 100.0f);
+        properties.gravity = 0.05f;
+        properties.randomness = (i % 2) ? 10 : 0;
+        properties.bounce = 0.7f;
+        properties.follow = false;
+        properties.target = (i % 2) ? NULL : targets[i % TARGET_COUNT];
+        properties.acceleration = properties.target ? 0.05f : 0.0f;
+        properties.momentum = 0.99f;
+        properties.dieDistance = properties.target ? 8.0f : -1.0f;
+        properties.lifetime = -1;
+        properties.fadeOut = 0;
+        properties.fadeIn = 0;
+        properties.alpha = 1.0f;
+        properties.image = NULL;
+        properties.animation = NULL;
+        properties.rotational = false;
+        properties.deathEffect = NULL;
+        properties.deathEffectConditions = 0x00;
+
+        pool.add(owner, properties);
+    }
+}
+
+void benchmark(const int count, const int ticks, const int maxWorkers)
+{
+    std::cout<<count<<" particles, "<<ticks<<" ticks:"<<std::endl;
+
+    Particle *owner = new Particle(NULL);
+    owner->moveTo(400.0f, 300.0f);
+
+    std::vector<Particle*> targets;
+    for (int i = 0; i < TARGET_COUNT; i++)
+    {
+        Particle *target = new Particle(NULL);
+        target->moveTo(100.0f + 600.0f * (i % 4) / 3, 150.0f + 300.0f * (i / 4));
+        targets.push_back(target);
+    }
+
+    double single = 0.0;
+    int singleSurvivors = 0;
+    for (int workers = 1; workers <= maxWorkers; workers++)
+    {
+        JobSystem jobs(workers);
+        ParticlePool *pool = new ParticlePool(&jobs);
+        spawn(*pool, owner, targets, count);
+
+        // The pool seeds its jobs from the particle random generator, which
+        // every run starts from the same point
+        Particle::random.setSeed(2);
+
+        const double start = now();
+        for (int tick = 0; tick < ticks; tick++)
+            pool->update();
+        const double elapsed = (now() - start) / ticks;
+        const int survivors = pool->getCount();
+
+        pool->remove(owner);
+        delete pool;
+
+        if (workers == 1)
+        {
+            single = elapsed;
+            singleSurvivors = survivors;
+        }
+
+        std::cout<<"    "<<workers<<" worker"<<(workers > 1 ? "s: " : ":  ")
+                 <<elapsed<<" us per tick"
+                 <<" (x"<<(elapsed > 0.0 ? single / elapsed : 1.0)<<"), "
+                 <<survivors<<" left"
+                 <<(survivors != singleSurvivors ? " results differ!" : "")
+                 <<std::endl;
+    }
+
+    delete_all(targets);
+    delete owner;
+}
+
+} // namespace
+
+/**
+ * Measures how the update of the particle pool scales with the number of
+ * workers of the job system.
+ */
+int main(int argc, char *argv[])
+{
+    int ticks = 1000;
+    int maxWorkers = JobSystem::getProcessorCount();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:w:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                ticks = atoi(optarg);
+                break;
+            case 'w':
+                maxWorkers = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (ticks <= 0 || maxWorkers <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    const int counts[] = { 3000, 5000, 10000, 20000 };
+    for (int i = 0; i < 4; i++)
+        benchmark(counts[i], ticks, maxWorkers);
+
+    return 0;
+}
@@ -19,6 +19,7 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <cstdlib>
 #include <getopt.h>
 #include <iostream>
 #include <unistd.h>
@@ -29,6 +30,7 @@
 
 #include "core/utils/dtor.h"
 #include "core/utils/gettext.h"
+#include "core/utils/profiler.h"
 #include "core/utils/stringutils.h"
 
 #include "eathena/statemanager.h"
@@ -49,9 +51,13 @@ static void printHelp()
               << std::endl
               << "  -D --default\t\t: " << _("Bypass the login process with "
                  "default settings") << std::endl
+              << "  -F --frames\t\t: " << _("Quit after drawing this many "
+                 "frames") << std::endl
               << "  -h --help\t\t: " << _("Display this help") << std::endl
               << "  -H --updatehost\t: " << _("Use this update host")
               << std::endl
+              << "  -N --headless\t\t: " << _("Run without a display, counting "
+                 "what would be drawn") << std::endl
               << "  -p --playername\t: " << _("Login with this player")
               << std::endl
               << "  -P --password\t\t: " << _("Login with this password")
@@ -101,12 +107,14 @@ static void printVersion()
 
 static void parseOptions(int argc, char *argv[])
 {
-    const char *optstring = "hvud:U:P:Dp:C:H:O";
+    const char *optstring = "hvud:U:P:Dp:C:H:ONF:";
 
     const struct option long_options[] = {
         { "configfile", required_argument, 0, 'C' },
         { "data",       required_argument, 0, 'd' },
         { "default",    no_argument,       0, 'D' },
+        { "frames",     required_argument, 0, 'F' },
+        { "headless",   no_argument,       0, 'N' },
         { "playername", required_argument, 0, 'p' },
         { "password",   required_argument, 0, 'P' },
         { "help",       no_argument,       0, 'h' },
@@ -137,6 +145,9 @@ static void parseOptions(int argc, char *argv[])
             case 'D':
                 options.chooseDefault = true;
                 break;
+            case 'F':
+                options.frames = atoi(optarg);
+                break;
             default: // Unknown option
             case 'h':
                 options.printHelp = true;
@@ -144,6 +155,9 @@ static void parseOptions(int argc, char *argv[])
             case 'H':
                 options.updateHost = optarg;
                 break;
+            case 'N':
+                options.headless = true;
+                break;
             case 'p':
                 options.playername = optarg;
                 break;
@@ -192,8 +206,14 @@ int main(int argc, char *argv[])
         engine = new Engine(argv[0]);
         stateManager = new StateManager();
 
-        while (stateManager && !stateManager->isExiting())
+        int frames = 0;
+
+        while (stateManager && !stateManager->isExiting() &&
+               (options.frames <= 0 || frames++ < options.frames))
+        {
             stateManager->logic();
+            Profiler::endFrame();
+        }
 
         destroy(stateManager);
         destroy(engine);
@@ -38,7 +38,9 @@ struct Options
         skipUpdate(false),
         chooseDefault(false),
         noOpenGL(false),
-        promptForGraphicsMode(false)
+        headless(false),
+        promptForGraphicsMode(false),
+        frames(0)
     {};
 
     bool printHelp;
@@ -46,7 +48,9 @@ struct Options
     bool skipUpdate;
     bool chooseDefault;
     bool noOpenGL;
+    bool headless;          /**< Draw to a NullGraphics, without a display */
     bool promptForGraphicsMode;
+    int frames;             /**< Quit after this many frames, if positive */
     std::string username;
     std::string password;
     std::string playername;
@@ -0,0 +1,403 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <physfs.h>
+#include <SDL.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <libxml/parser.h>
+
+#include "options.h"
+
+#include "bindings/guichan/null/nullgraphics.h"
+
+#include "core/configuration.h"
+#include "core/log.h"
+#include "core/resourcemanager.h"
+
+#include "core/image/particle/particle.h"
+
+#include "core/map/map.h"
+
+#include "core/utils/dtor.h"
+#include "core/utils/jobsystem.h"
+#include "core/utils/stringutils.h"
+
+class Engine;
+class StateManager;
+
+Engine *engine = NULL;
+Options options;
+StateManager *stateManager = NULL;
+
+namespace
+{
+
+/**
+ * Number of allocations made through operator new since the last reset. Only
+ * counted while a benchmark is running, so that loading doesn't show up.
+ */
+long allocations = 0;
+bool countAllocations = false;
+
+/**
+ * Effects used when no effect files are given and the data directory has no
+ * particle effects. They don't use any images, so they only measure the
+ * simulation.
+ */
+struct SyntheticEffect
+{
+    const char *name;
+    const char *xml;
+};
+
+const SyntheticEffect syntheticEffects[] = {
+    { "fountain.particle.xml",
+      "<effect><particle><emitter>"
+      "<property name=\"output\" value=\"8\"/>"
+      "<property name=\"horizontal-angle\" min=\"0\" max=\"360\"/>"
+      "<property name=\"vertical-angle\" min=\"60\" max=\"90\"/>"
+      "<property name=\"power\" min=\"2\" max=\"4\"/>"
+      "<property name=\"gravity\" value=\"0.1\"/>"
+      "<property name=\"bounce\" value=\"0.5\"/>"
+      "<property name=\"lifetime\" value=\"200\"/>"
+      "</emitter></particle></effect>" },
+    { "swarm.particle.xml",
+      "<effect><particle><emitter>"
+      "<property name=\"output\" value=\"4\"/>"
+      "<property name=\"horizontal-angle\" min=\"0\" max=\"360\"/>"
+      "<property name=\"power\" min=\"1\" max=\"2\"/>"
+      "<property name=\"randomness\" value=\"10\"/>"
+      "<property name=\"acceleration\" value=\"0.05\"/>"
+      "<property name=\"die-distance\" value=\"4\"/>"
+      "<property name=\"momentum\" value=\"0.95\"/>"
+      "<property name=\"lifetime\" value=\"300\"/>"
+      "<property name=\"fade-out\" value=\"50\"/>"
+      "</emitter></particle></effect>" },
+    { "sparks.particle.xml",
+      "<effect><particle><emitter>"
+      "<property name=\"output\" value=\"1\"/>"
+      "<property name=\"output-pause\" value=\"4\"/>"
+      "<property name=\"horizontal-angle\" min=\"0\" max=\"360\"/>"
+      "<property name=\"vertical-angle\" min=\"30\" max=\"60\"/>"
+      "<property name=\"power\" min=\"3\" max=\"5\"/>"
+      "<property name=\"gravity\" value=\"0.2\"/>"
+      "<property name=\"lifetime\" value=\"60\"/>"
+      "<emitter>"
+      "<property name=\"output\" value=\"2\"/>"
+      "<property name=\"horizontal-angle\" min=\"0\" max=\"360\"/>"
+      "<property name=\"power\" min=\"0.5\" max=\"1\"/>"
+      "<property name=\"gravity\" value=\"0.05\"/>"
+      "<property name=\"lifetime\" value=\"30\"/>"
+      "</emitter>"
+      "</emitter></particle></effect>" }
+};
+
+const int syntheticEffectCount =
+    sizeof(syntheticEffects) / sizeof(syntheticEffects[0]);
+
+void printUsage()
+{
+    std::cerr<<"Usage: particlebench [-d dataPath] [-e effects] [-s seed] "
+               "[-t ticks] [effectFile...]"<<std::endl
+             <<"    -d directory to load game data from (default: data)"<<std::endl
+             <<"    -e number of instances of each effect (default 20)"<<std::endl
+             <<"    -s seed of the particle random generator (default 1)"<<std::endl
+             <<"    -t number of ticks to simulate per effect (default 1000)"<<std::endl
+             <<std::endl
+             <<"Effect files are looked up in the data directory. Without any, "
+               "all effects in"<<std::endl
+             <<"graphics/particles are measured, or a synthetic set when "
+               "there are none."<<std::endl;
+}
+
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/**
+ * Writes the synthetic effects to a temporary directory and adds it to the
+ * search path. Returns the names of the effect files, and the directory in
+ * tempDir.
+ */
+std::vector<std::string> writeSyntheticEffects(std::string &tempDir)
+{
+    std::vector<std::string> files;
+
+    char dir[] = "/tmp/particlebench.XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        std::cerr<<"Could not create a directory for the synthetic effects"
+                 <<std::endl;
+        return files;
+    }
+    tempDir = dir;
+
+    for (int i = 0; i < syntheticEffectCount; i++)
+    {
+        const std::string path = std::string(dir) + "/" +
+                                 syntheticEffects[i].name;
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+            continue;
+        fputs(syntheticEffects[i].xml, file);
+        fclose(file);
+        files.push_back(syntheticEffects[i].name);
+    }
+
+    ResourceManager::getInstance()->addToSearchPath(dir, false);
+
+    return files;
+}
+
+/**
+ * Removes the directory written by writeSyntheticEffects, along with the
+ * effect files in it.
+ */
+void removeSyntheticEffects(const std::string &dir,
+                            const std::vector<std::string> &files)
+{
+    PHYSFS_removeFromSearchPath(dir.c_str());
+
+    for (unsigned int i = 0; i < files.size(); i++)
+        unlink((dir + "/" + files[i]).c_str());
+
+    rmdir(dir.c_str());
+}
+
+/**
+ * Lists the particle effects which come with the game data.
+ */
+std::vector<std::string> findEffects()
+{
+    std::vector<std::string> files;
+    const std::string dir = "graphics/particles/";
+    char **list = PHYSFS_enumerateFiles(dir.c_str());
+
+    for (char **i = list; *i; i++)
+    {
+        const std::string name = *i;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".xml")
+            files.push_back(dir + name);
+    }
+
+    PHYSFS_freeList(list);
+    return files;
+}
+
+/**
+ * Spawns a number of instances of the effect, spread over the screen, and
+ * simulates the given number of ticks, drawing the map after each one.
+ */
+void benchmark(const std::string &file, Map *map, int instances, int ticks)
+{
+    NullGraphics *nullGraphics = static_cast<NullGraphics*>(graphics);
+
+    double start = now();
+    Particle *first = particleEngine->addEffect(file, 0, 0);
+    const double loadTime = now() - start;
+
+    if (!first)
+    {
+        std::cerr<<file<<": could not be loaded"<<std::endl;
+        return;
+    }
+
+    first->moveBy(Vector(rand() % graphics->getWidth(),
+                         rand() % graphics->getHeight(), 0.0f));
+    for (int i = 1; i < instances; i++)
+    {
+        particleEngine->addEffect(file, rand() % graphics->getWidth(),
+                                  rand() % graphics->getHeight());
+    }
+
+    int peak = 0;
+    allocations = 0;
+    nullGraphics->resetCounters();
+    countAllocations = true;
+
+    start = now();
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        particleEngine->update();
+        if (Particle::particleCount > peak)
+            peak = Particle::particleCount;
+        map->draw(graphics, 0, 0);
+    }
+    const double elapsed = now() - start;
+
+    countAllocations = false;
+    particleEngine->clear();
+
+    std::cout<<file<<": loaded in "<<loadTime / 1000.0<<" ms"<<std::endl
+             <<"    "<<ticks / (elapsed / 1000000.0)<<" ticks/s, "
+             <<elapsed / ticks<<" us per tick"<<std::endl
+             <<"    peak "<<peak<<" particles, "
+             <<nullGraphics->getCounters().images / ticks<<" images drawn per tick"
+             <<std::endl
+             <<"    "<<allocations<<" allocations, "
+             <<(double) allocations / ticks<<" per tick"<<std::endl;
+}
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    if (countAllocations)
+        allocations++;
+
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw ()
+{
+    free(p);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void *p) throw ()
+{
+    operator delete(p);
+}
+
+/**
+ * Runs the particle engine without a game or a window, for measuring how the
+ * particle effects perform.
+ */
+int main(int argc, char *argv[])
+{
+    std::string dataPath = "data";
+    int instances = 20;
+    int seed = 1;
+    int ticks = 1000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:e:s:t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                dataPath = optarg;
+                break;
+            case 'e':
+                instances = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            case 't':
+                ticks = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (instances <= 0 || ticks <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    // The null graphics still needs a video surface for loading images, which
+    // the dummy driver provides without opening a window
+    putenv((char*) "SDL_VIDEODRIVER=dummy");
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        std::cerr<<"Could not initialize SDL: "<<SDL_GetError()<<std::endl;
+        return -1;
+    }
+
+    PHYSFS_init(argv[0]);
+    xmlInitParser();
+
+    logger = new Logger();
+    logger->setLogFile("particlebench.log");
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    resman->setWriteDir(PHYSFS_getBaseDir());
+    resman->addToSearchPath(dataPath, true);
+
+    graphics = new NullGraphics();
+    graphics->setVideoMode(800, 600, 0, false, false);
+    graphics->_beginDraw();
+
+    // The fringe layer is the one drawing the particles
+    Map *map = new Map(25, 19, 32, 32);
+    map->addLayer(new MapLayer(0, 0, 25, 19, 32, 32, true));
+
+    config.setValue("particleSeed", (float) seed);
+    particleEngine = new Particle(NULL);
+    particleEngine->setupEngine();
+    particleEngine->setMap(map);
+    srand(seed);
+
+    std::vector<std::string> files;
+    for (int i = optind; i < argc; i++)
+        files.push_back(argv[i]);
+
+    if (files.empty())
+        files = findEffects();
+
+    std::string tempDir;
+    if (files.empty())
+        files = writeSyntheticEffects(tempDir);
+
+    for (unsigned int i = 0; i < files.size(); i++)
+        benchmark(files[i], map, instances, ticks);
+
+    destroy(particleEngine);
+    destroy(map);
+    graphics->_endDraw();
+    destroy(graphics);
+    ResourceManager::deleteInstance();
+    JobSystem::deleteInstance();
+    destroy(logger);
+
+    if (!tempDir.empty())
+        removeSyntheticEffects(tempDir, files);
+
+    xmlCleanupParser();
+    PHYSFS_deinit();
+    SDL_Quit();
+
+    return 0;
+}
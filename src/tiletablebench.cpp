@@ -0,0 +1,198 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <physfs.h>
+#include <SDL.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <libxml/parser.h>
+
+#include "options.h"
+
+#include "bindings/guichan/null/nullgraphics.h"
+
+#include "core/log.h"
+#include "core/resourcemanager.h"
+
+#include "core/map/compiledmap.h"
+#include "core/map/map.h"
+#include "core/map/mapreader.h"
+
+#include "core/utils/dtor.h"
+#include "core/utils/jobsystem.h"
+
+class Engine;
+class StateManager;
+
+Engine *engine = NULL;
+Options options;
+StateManager *stateManager = NULL;
+
+namespace
+{
+
+void printUsage()
+{
+    std::cerr<<"Usage: tiletablebench [-d dataPath] [-r rounds] mapFile..."<<std::endl
+             <<"    -d directory to load game data from (default: data)"<<std::endl
+             <<"    -r number of times each map is created (default 20)"<<std::endl
+             <<std::endl
+             <<"Map files are looked up in the data directory, for example "
+               "maps/new_1-1.tmx.gz"<<std::endl;
+}
+
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/**
+ * Reads the map file the way the map loader does, without the compiled map
+ * cache, and creates the map from it the given number of times.
+ */
+void benchmark(const std::string &file, int rounds)
+{
+    MapReader::Settings settings;
+    settings.useCache = false;
+
+    CompiledMap compiled;
+    bool compiledNow;
+    uint32_t checksum;
+
+    double start = now();
+    if (!MapReader::readMap(file, settings, compiled, compiledNow, checksum))
+    {
+        std::cerr<<file<<": could not be read"<<std::endl;
+        return;
+    }
+    const double readTime = now() - start;
+
+    // The first map loads the tileset images, the others find them in the
+    // resource manager, so they mostly measure setting the tiles
+    start = now();
+    Map *map = compiled.createMap();
+    const double firstTime = now() - start;
+
+    const int width = map->getWidth();
+    const int height = map->getHeight();
+    Map *previous = map;
+
+    start = now();
+    for (int i = 0; i < rounds; i++)
+    {
+        map = compiled.createMap();
+
+        // Keeping the previous map alive keeps its tilesets from being
+        // released and loaded again
+        destroy(previous);
+        previous = map;
+    }
+    const double createTime = (now() - start) / rounds;
+
+    destroy(previous);
+
+    std::cout<<file<<": "<<width<<"x"<<height<<" tiles, "
+             <<compiled.getTilesets().size()<<" tilesets"<<std::endl
+             <<"    read in "<<readTime / 1000.0<<" ms"<<std::endl
+             <<"    first created in "<<firstTime / 1000.0
+             <<" ms, loading the tilesets"<<std::endl
+             <<"    created in "<<createTime / 1000.0<<" ms afterwards"
+             <<std::endl;
+}
+
+} // namespace
+
+/**
+ * Reads and creates maps without a game or a window, for measuring how long
+ * creating them from their compiled form takes.
+ */
+int main(int argc, char *argv[])
+{
+    std::string dataPath = "data";
+    int rounds = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                dataPath = optarg;
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (rounds <= 0 || optind == argc)
+    {
+        printUsage();
+        return -1;
+    }
+
+    // Tileset images are converted for the video surface, which the dummy
+    // driver provides without opening a window
+    putenv((char*) "SDL_VIDEODRIVER=dummy");
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        std::cerr<<"Could not initialize SDL: "<<SDL_GetError()<<std::endl;
+        return -1;
+    }
+
+    PHYSFS_init(argv[0]);
+    xmlInitParser();
+
+    logger = new Logger();
+    logger->setLogFile("tiletablebench.log");
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    resman->setWriteDir(PHYSFS_getBaseDir());
+    resman->addToSearchPath(dataPath, true);
+
+    graphics = new NullGraphics();
+    graphics->setVideoMode(800, 600, 0, false, false);
+
+    for (int i = optind; i < argc; i++)
+        benchmark(argv[i], rounds);
+
+    destroy(graphics);
+    ResourceManager::deleteInstance();
+    JobSystem::deleteInstance();
+    destroy(logger);
+
+    xmlCleanupParser();
+    PHYSFS_deinit();
+    SDL_Quit();
+
+    return 0;
+}
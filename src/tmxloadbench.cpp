@@ -0,0 +1,253 @@
+/*
+ *  Aethyra
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This file is part of Aethyra.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <libxml/parser.h>
+
+#include "options.h"
+
+#include "core/log.h"
+
+#include "core/map/layerdecoder.h"
+
+#include "core/utils/dtor.h"
+#include "core/utils/jobsystem.h"
+
+class Engine;
+class StateManager;
+
+Engine *engine = NULL;
+Options options;
+StateManager *stateManager = NULL;
+
+namespace
+{
+
+/**
+ * The base64 encoded data of a layer, as found in the map file.
+ */
+struct Layer
+{
+    const char *text;
+    bool compressed;
+    unsigned int length;    /**< Size of the decoded layer in bytes */
+};
+
+void printUsage()
+{
+    std::cerr<<"Usage: tmxloadbench [-r rounds] [-t threads] mapFile..."
+             <<std::endl
+             <<"    -r number of times each map is decoded (default 20)"
+             <<std::endl
+             <<"    -t highest number of workers to try (default: number of "
+               "processors)"<<std::endl;
+}
+
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/**
+ * Collects the base64 encoded layers of the map, the way the map reader
+ * hands them to the layer decoder.
+ */
+void findLayers(xmlNodePtr root, std::vector<Layer> &layers)
+{
+    for (xmlNodePtr layer = root->children; layer; layer = layer->next)
+    {
+        if (!xmlStrEqual(layer->name, BAD_CAST "layer"))
+            continue;
+
+        xmlChar *width = xmlGetProp(layer, BAD_CAST "width");
+        xmlChar *height = xmlGetProp(layer, BAD_CAST "height");
+        const int tiles = (width && height) ?
+            atoi((char*) width) * atoi((char*) height) : 0;
+        xmlFree(width);
+        xmlFree(height);
+
+        for (xmlNodePtr data = layer->children; data; data = data->next)
+        {
+            if (!xmlStrEqual(data->name, BAD_CAST "data"))
+                continue;
+
+            xmlChar *encoding = xmlGetProp(data, BAD_CAST "encoding");
+            xmlChar *compression = xmlGetProp(data, BAD_CAST "compression");
+
+            if (encoding && xmlStrEqual(encoding, BAD_CAST "base64") &&
+                data->children && data->children->content && tiles > 0)
+            {
+                Layer found;
+                found.text = (const char*) data->children->content;
+                found.compressed = compression &&
+                    xmlStrEqual(compression, BAD_CAST "gzip");
+                found.length = tiles * 4;
+                layers.push_back(found);
+            }
+
+            xmlFree(encoding);
+            xmlFree(compression);
+            break;
+        }
+    }
+}
+
+/**
+ * Decodes all layers once with the layer decoder of the game. Returns the
+ * number of bytes decoded.
+ */
+int decode(const std::vector<Layer> &layers)
+{
+    LayerDecoder decoder;
+
+    for (unsigned int i = 0; i < layers.size(); i++)
+    {
+        decoder.add(layers[i].text, layers[i].compressed,
+                    layers[i].length);
+    }
+
+    decoder.decode();
+
+    int decoded = 0;
+    for (unsigned int i = 0; i < layers.size(); i++)
+    {
+        int length;
+        if (decoder.getData(i, length))
+            decoded += length;
+    }
+
+    return decoded;
+}
+
+void benchmark(const std::string &mapFile, const int rounds,
+               const int maxWorkers)
+{
+    double start = now();
+    xmlDocPtr doc = xmlReadFile(mapFile.c_str(), NULL, 0);
+    const double parseTime = now() - start;
+
+    xmlNodePtr root = doc ? xmlDocGetRootElement(doc) : NULL;
+    if (!root || !xmlStrEqual(root->name, BAD_CAST "map"))
+    {
+        std::cerr<<mapFile<<": not a map file"<<std::endl;
+        if (doc)
+            xmlFreeDoc(doc);
+        return;
+    }
+
+    std::vector<Layer> layers;
+    findLayers(root, layers);
+
+    unsigned int expected = 0;
+    for (unsigned int i = 0; i < layers.size(); i++)
+        expected += layers[i].length;
+
+    std::cout<<mapFile<<": "<<layers.size()<<" base64 layers, "
+             <<expected / 4<<" tiles, parsed in "<<parseTime / 1000.0
+             <<" ms"<<std::endl;
+
+    double single = 0.0;
+    for (int workers = 1; workers <= maxWorkers; workers++)
+    {
+        // The decoder runs on the shared job system, like in the game
+        JobSystem::deleteInstance();
+        JobSystem::createInstance(workers);
+
+        int decoded = 0;
+        start = now();
+        for (int i = 0; i < rounds; i++)
+            decoded = decode(layers);
+        const double elapsed = (now() - start) / rounds;
+
+        if (workers == 1)
+            single = elapsed;
+
+        std::cout<<"    "<<workers<<" worker"<<(workers > 1 ? "s: " : ":  ")
+                 <<elapsed / 1000.0<<" ms per load"
+                 <<" (x"<<(elapsed > 0.0 ? single / elapsed : 1.0)<<")"
+                 <<((unsigned int) decoded != expected ?
+                    " some layers could not be decoded!" : "")<<std::endl;
+    }
+
+    xmlFreeDoc(doc);
+}
+
+} // namespace
+
+/**
+ * Measures how long the layer decoder of the game takes to decode the layers
+ * of maps, and how that scales with the number of workers of the job system.
+ */
+int main(int argc, char *argv[])
+{
+    int rounds = 20;
+    int maxWorkers = JobSystem::getProcessorCount();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 't':
+                maxWorkers = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (optind >= argc || rounds <= 0 || maxWorkers <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    xmlInitParser();
+
+    // The decoder logs the layers it fails to decompress
+    logger = new Logger();
+    logger->setLogFile("tmxloadbench.log");
+
+    for (int i = optind; i < argc; i++)
+        benchmark(argv[i], rounds, maxWorkers);
+
+    JobSystem::deleteInstance();
+    destroy(logger);
+
+    xmlCleanupParser();
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ *  AlphaBench
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <SDL.h>
+
+/* Same as in the Image class. */
+#define ALPHA_LEVELS 32
+
+void printUsage()
+{
+    std::cerr<<"Usage: alphabench [-f frames] [-p period]"<<std::endl
+             <<"    -f number of frames drawn per run (default 1000)"<<std::endl
+             <<"    -p frames it takes to fade out and in again (default 60)"<<std::endl
+             <<std::endl
+             <<"Compares fading images by rewriting their pixels with fading them by drawing"<<std::endl
+             <<"copies made for a number of alpha levels"<<std::endl
+             <<"See readme.txt for full documentation"<<std::endl;
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/* An image with an alpha channel, with what both ways of fading need. */
+struct FadingImage
+{
+    SDL_Surface* surface;
+    std::vector<Uint8> storedAlpha;
+    std::vector<SDL_Surface*> variants;
+    float alpha;
+    int x, y;
+};
+
+static SDL_Surface* createSurface(int w, int h)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    return SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA, w, h, 32,
+                                0xff000000, 0x00ff0000, 0x0000ff00, 0x000000ff);
+#else
+    return SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA, w, h, 32,
+                                0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+#endif
+}
+
+/* Makes an image with a soft edge, like the cursor, text and skin images
+ * have.
+ */
+static FadingImage createImage(int w, int h, int x, int y)
+{
+    FadingImage image;
+    image.surface = createSurface(w, h);
+    image.storedAlpha.resize(w * h);
+    image.variants.resize(ALPHA_LEVELS - 1, NULL);
+    image.alpha = 1.0f;
+    image.x = x;
+    image.y = y;
+
+    Uint32* pixels = (Uint32*) image.surface->pixels;
+    for (int i = 0; i < w * h; i++)
+    {
+        const int px = i % w;
+        const int py = i / w;
+        const Uint8 a = (px == 0 || py == 0 || px == w - 1 || py == h - 1) ?
+                        128 : (px * py) % 3 ? 255 : 0;
+        pixels[i] = SDL_MapRGBA(image.surface->format, px & 255, py & 255,
+                                (px + py) & 255, a);
+        image.storedAlpha[i] = a;
+    }
+
+    return image;
+}
+
+/* Sets the alpha the way Image::setAlpha used to: every pixel is rewritten
+ * from the alpha it was loaded with.
+ */
+static void setAlphaOld(FadingImage& image, float alpha)
+{
+    if (image.alpha == alpha)
+        return;
+
+    image.alpha = alpha;
+    SDL_Surface* surface = image.surface;
+
+    for (int i = 0; i < surface->w * surface->h; i++)
+    {
+        Uint8 r, g, b, a;
+        SDL_GetRGBA(((Uint32*) surface->pixels)[i], surface->format,
+                    &r, &g, &b, &a);
+
+        a = (Uint8) (image.storedAlpha[i] * alpha);
+
+        ((Uint32*) surface->pixels)[i] = SDL_MapRGBA(surface->format,
+                                                     r, g, b, a);
+    }
+}
+
+/* Returns the surface to draw the way Image::getVariant does: a copy with the
+ * alpha channel scaled to the nearest level, made the first time it's used.
+ */
+static SDL_Surface* getVariant(FadingImage& image, float alpha, int& created)
+{
+    const int level = (int) (alpha * (ALPHA_LEVELS - 1) + 0.5f);
+    if (level >= ALPHA_LEVELS - 1)
+        return image.surface;
+
+    if (!image.variants[level])
+    {
+        SDL_Surface* variant = SDL_ConvertSurface(image.surface,
+                                                  image.surface->format,
+                                                  image.surface->flags);
+        const SDL_PixelFormat* format = variant->format;
+
+        for (int y = 0; y < variant->h; y++)
+        {
+            Uint32* pixel = (Uint32*) ((Uint8*) variant->pixels +
+                                       y * variant->pitch);
+
+            for (Uint32* end = pixel + variant->w; pixel != end; ++pixel)
+            {
+                const Uint32 a = (*pixel & format->Amask) >> format->Ashift;
+                *pixel = (*pixel & ~format->Amask) |
+                         ((a * level / (ALPHA_LEVELS - 1)) << format->Ashift);
+            }
+        }
+
+        image.variants[level] = variant;
+        created++;
+    }
+
+    return image.variants[level];
+}
+
+static void blit(SDL_Surface* surface, SDL_Surface* screen, int x, int y)
+{
+    SDL_Rect dstRect;
+    dstRect.x = x;
+    dstRect.y = y;
+    SDL_BlitSurface(surface, NULL, screen, &dstRect);
+}
+
+/* Alpha going from 1 down to 0 and back up again. */
+static float fade(int frame, int period)
+{
+    const float phase = (float) (frame % period) / period;
+    return phase < 0.5f ? 1.0f - phase * 2.0f : phase * 2.0f - 1.0f;
+}
+
+/* The images faded in the game: a window skin of nine images, the mouse
+ * cursor and a few lines of text.
+ */
+static std::vector<FadingImage> createImages()
+{
+    std::vector<FadingImage> images;
+    const int size[] = { 16, 224, 16 };
+    int y = 100;
+    for (int row = 0; row < 3; row++)
+    {
+        int x = 100;
+        for (int column = 0; column < 3; column++)
+        {
+            images.push_back(createImage(size[column], size[row], x, y));
+            x += size[column];
+        }
+        y += size[row];
+    }
+
+    images.push_back(createImage(40, 40, 500, 300));
+    for (int i = 0; i < 5; i++)
+        images.push_back(createImage(300, 16, 400, 100 + i * 20));
+
+    return images;
+}
+
+static void freeImages(std::vector<FadingImage>& images)
+{
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        SDL_FreeSurface(images[i].surface);
+        for (size_t v = 0; v < images[i].variants.size(); v++)
+            if (images[i].variants[v])
+                SDL_FreeSurface(images[i].variants[v]);
+    }
+}
+
+int main(int argc, char * argv[] )
+{
+    int frames = 1000;
+    int period = 60;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:p:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            case 'p':
+                period = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (frames <= 0 || period <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    SDL_Surface* screen = SDL_CreateRGBSurface(SDL_SWSURFACE, 800, 600, 32,
+                                               0xff0000, 0x00ff00, 0x0000ff, 0);
+
+    std::vector<FadingImage> images = createImages();
+    long pixels = 0;
+    for (size_t i = 0; i < images.size(); i++)
+        pixels += images[i].surface->w * images[i].surface->h;
+
+    std::cout<<images.size()<<" images of "<<pixels<<" pixels in total, "
+             <<frames<<" frames, fading every "<<period<<" frames:"<<std::endl;
+
+    // Drawing without fading, to tell the cost of fading from that of blitting
+    double start = now();
+    for (int frame = 0; frame < frames; frame++)
+        for (size_t i = 0; i < images.size(); i++)
+            blit(images[i].surface, screen, images[i].x, images[i].y);
+    const double drawTime = (now() - start) / frames;
+
+    start = now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        const float alpha = fade(frame, period);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            setAlphaOld(images[i], alpha);
+            blit(images[i].surface, screen, images[i].x, images[i].y);
+        }
+    }
+    const double oldTime = (now() - start) / frames;
+    freeImages(images);
+
+    images = createImages();
+    int created = 0;
+
+    start = now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        const float alpha = fade(frame, period);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            SDL_Surface* surface = getVariant(images[i], alpha, created);
+            blit(surface, screen, images[i].x, images[i].y);
+        }
+    }
+    const double newTime = (now() - start) / frames;
+    freeImages(images);
+
+    std::cout<<"    without fading:   "<<drawTime<<" us per frame"<<std::endl
+             <<"    rewriting pixels: "<<oldTime<<" us per frame"<<std::endl
+             <<"    alpha copies:     "<<newTime<<" us per frame (x"
+             <<(newTime > 0.0 ? oldTime / newTime : 1.0)<<"), "
+             <<created<<" copies made"<<std::endl;
+
+    SDL_FreeSurface(screen);
+}
@@ -0,0 +1,214 @@
+/*
+ *  Base64Bench
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../../src/core/utils/base64.h"
+
+void printUsage()
+{
+    std::cerr<<"Usage: base64bench [-r rounds] [-s size] [mapFile...]"<<std::endl
+             <<"    -r number of times each payload is decoded (default 200)"<<std::endl
+             <<"    -s layer size in tiles of the generated payload (default 200)"<<std::endl
+             <<std::endl
+             <<"Compares the old and the new base64 decoder on map layer data"<<std::endl
+             <<"See readme.txt for full documentation"<<std::endl;
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/* Decodes the way the map reader used to: copy the text without whitespace,
+ * then decode it into a newly allocated buffer.
+ */
+static int decodeOld(const std::string& text)
+{
+    unsigned char* charData = new unsigned char[text.size() + 1];
+    unsigned char* charIndex = charData;
+
+    for (const char* c = text.c_str(); *c; c++)
+    {
+        if (*c != ' ' && *c != '\t' && *c != '\n')
+            *charIndex++ = *c;
+    }
+    *charIndex = '\0';
+
+    int binLen;
+    unsigned char* binData =
+        php3_base64_decode(charData, strlen((char*) charData), &binLen);
+
+    delete[] charData;
+    free(binData);
+    return binLen;
+}
+
+/* Decodes the way the map reader does now, straight into a buffer. */
+static int decodeNew(const std::string& text, std::vector<unsigned char>& buffer)
+{
+    return base64_decode_into((const unsigned char*) text.data(), text.size(),
+                              &buffer[0], buffer.size());
+}
+
+/* Makes a layer payload like Tiled writes it for an uncompressed layer: one
+ * line of base64 with the indentation around it.
+ */
+static std::string generatePayload(int size)
+{
+    std::vector<unsigned char> gids(size * size * 4);
+    for (int i = 0; i < size * size; i++)
+    {
+        const int gid = rand() % 400;
+        gids[i * 4] = gid & 0xff;
+        gids[i * 4 + 1] = gid >> 8;
+    }
+
+    int length;
+    unsigned char* encoded = php3_base64_encode(&gids[0], gids.size(), &length);
+    std::string text = "\n   " + std::string((char*) encoded, length) + "\n  ";
+    free(encoded);
+
+    return text;
+}
+
+/* Collects the contents of all base64 encoded data elements in the file. */
+static void readPayloads(const std::string& mapFile,
+                         std::vector<std::string>& payloads)
+{
+    std::ifstream file(mapFile.c_str());
+    std::stringstream contents;
+    contents<<file.rdbuf();
+    const std::string map = contents.str();
+
+    std::string::size_type pos = 0;
+    while ((pos = map.find("<data", pos)) != std::string::npos)
+    {
+        const std::string::size_type tagEnd = map.find('>', pos);
+        const std::string::size_type dataEnd = map.find("</data>", pos);
+        if (tagEnd == std::string::npos || dataEnd == std::string::npos)
+            break;
+
+        if (map.substr(pos, tagEnd - pos).find("base64") != std::string::npos)
+            payloads.push_back(map.substr(tagEnd + 1, dataEnd - tagEnd - 1));
+
+        pos = dataEnd;
+    }
+}
+
+static void benchmark(const std::string& name,
+                      const std::vector<std::string>& payloads, int rounds)
+{
+    long long characters = 0;
+    size_t largest = 0;
+    for (size_t i = 0; i < payloads.size(); i++)
+    {
+        characters += payloads[i].size();
+        if (payloads[i].size() > largest)
+            largest = payloads[i].size();
+    }
+
+    std::vector<unsigned char> buffer(largest / 4 * 3 + 3);
+    long long oldBytes = 0;
+    long long newBytes = 0;
+
+    double start = now();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < payloads.size(); i++)
+            oldBytes += decodeOld(payloads[i]);
+    const double oldTime = now() - start;
+
+    start = now();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < payloads.size(); i++)
+            newBytes += decodeNew(payloads[i], buffer);
+    const double newTime = now() - start;
+
+    if (oldBytes != newBytes)
+        std::cerr<<name<<": decoders disagree about the decoded size!"<<std::endl;
+
+    const double megabytes = (double) characters * rounds / (1024 * 1024);
+    std::cout<<name<<": "<<payloads.size()<<" layers, "<<characters<<" characters"<<std::endl
+             <<"    old: "<<oldTime / 1000.0 / rounds<<" ms per map, "
+             <<megabytes / (oldTime / 1000000.0)<<" MB/s"<<std::endl
+             <<"    new: "<<newTime / 1000.0 / rounds<<" ms per map, "
+             <<megabytes / (newTime / 1000000.0)<<" MB/s"<<std::endl;
+}
+
+int main(int argc, char * argv[] )
+{
+    int rounds = 200;
+    int size = 200;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 's':
+                size = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (rounds <= 0 || size <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    if (optind == argc)
+    {
+        std::vector<std::string> payloads;
+        for (int i = 0; i < 4; i++)
+            payloads.push_back(generatePayload(size));
+
+        std::ostringstream name;
+        name<<"generated "<<size<<"x"<<size;
+        benchmark(name.str(), payloads, rounds);
+    }
+
+    for (int i = optind; i < argc; i++)
+    {
+        std::vector<std::string> payloads;
+        readPayloads(argv[i], payloads);
+
+        if (payloads.empty())
+            std::cerr<<argv[i]<<": no base64 encoded layers"<<std::endl;
+        else
+            benchmark(argv[i], payloads, rounds);
+    }
+}
@@ -0,0 +1,222 @@
+/*
+ *  BeingGridBench
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../../src/core/map/beinggrid.h"
+
+/* The grid only stores pointers, so a stand-in with a position is all the
+ * benchmark needs.
+ */
+class Being
+{
+    public:
+        int mX, mY;
+};
+
+class TileFinder
+{
+    public:
+        bool operator() (const Being* being) const
+        {
+            return being->mX == x && being->mY == y;
+        }
+
+        int x, y;
+};
+
+class AreaFinder
+{
+    public:
+        bool operator() (const Being* being) const
+        {
+            return being->mX >= minX && being->mX <= maxX &&
+                   being->mY >= minY && being->mY <= maxY;
+        }
+
+        int minX, minY, maxX, maxY;
+};
+
+void printUsage()
+{
+    std::cerr<<"Usage: beinggridbench [-q queries] [-w width] [-h height]"<<std::endl
+             <<"    -q number of lookups per run (default 100000)"<<std::endl
+             <<"    -w -h map size in tiles (default 200x200)"<<std::endl
+             <<std::endl
+             <<"Compares being lookups on a linear list and on the being grid"<<std::endl
+             <<"See readme.txt for full documentation"<<std::endl;
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+static void benchmark(int beingCount, int queries, int width, int height)
+{
+    std::vector<Being> beings(beingCount);
+    std::list<Being*> list;
+    BeingGrid grid(width, height);
+
+    for (int i = 0; i < beingCount; i++)
+    {
+        beings[i].mX = rand() % width;
+        beings[i].mY = rand() % height;
+        list.push_back(&beings[i]);
+        grid.add(&beings[i], beings[i].mX, beings[i].mY);
+    }
+
+    std::vector<int> xs(queries), ys(queries);
+    for (int i = 0; i < queries; i++)
+    {
+        xs[i] = rand() % width;
+        ys[i] = rand() % height;
+    }
+
+    TileFinder tileFinder;
+    AreaFinder areaFinder;
+    int found = 0;
+
+    // Tile lookups, as done by Map::occupied and findBeing(x, y)
+    double start = now();
+    for (int i = 0; i < queries; i++)
+    {
+        tileFinder.x = xs[i];
+        tileFinder.y = ys[i];
+        for (std::list<Being*>::iterator b = list.begin(); b != list.end(); ++b)
+        {
+            if (tileFinder(*b))
+            {
+                found++;
+                break;
+            }
+        }
+    }
+    const double listTile = (now() - start) * 1000.0 / queries;
+
+    start = now();
+    for (int i = 0; i < queries; i++)
+    {
+        tileFinder.x = xs[i];
+        tileFinder.y = ys[i];
+        if (grid.find(xs[i], ys[i], xs[i], ys[i], tileFinder))
+            found--;
+    }
+    const double gridTile = (now() - start) * 1000.0 / queries;
+
+    // Area lookups, as done by findBeingByPixel
+    start = now();
+    for (int i = 0; i < queries; i++)
+    {
+        areaFinder.minX = xs[i] - 3;
+        areaFinder.minY = ys[i] - 3;
+        areaFinder.maxX = xs[i] + 2;
+        areaFinder.maxY = ys[i] + 3;
+        for (std::list<Being*>::iterator b = list.begin(); b != list.end(); ++b)
+        {
+            if (areaFinder(*b))
+            {
+                found++;
+                break;
+            }
+        }
+    }
+    const double listArea = (now() - start) * 1000.0 / queries;
+
+    start = now();
+    for (int i = 0; i < queries; i++)
+    {
+        areaFinder.minX = xs[i] - 3;
+        areaFinder.minY = ys[i] - 3;
+        areaFinder.maxX = xs[i] + 2;
+        areaFinder.maxY = ys[i] + 3;
+        if (grid.find(areaFinder.minX, areaFinder.minY,
+                      areaFinder.maxX, areaFinder.maxY, areaFinder))
+            found--;
+    }
+    const double gridArea = (now() - start) * 1000.0 / queries;
+
+    // Keeping the grid up to date while beings walk around
+    start = now();
+    for (int i = 0; i < queries; i++)
+    {
+        Being& being = beings[i % beingCount];
+        const int x = std::min(std::max(being.mX + rand() % 3 - 1, 0), width - 1);
+        const int y = std::min(std::max(being.mY + rand() % 3 - 1, 0), height - 1);
+        grid.move(&being, being.mX, being.mY, x, y);
+        being.mX = x;
+        being.mY = y;
+    }
+    const double gridMove = (now() - start) * 1000.0 / queries;
+
+    if (found != 0)
+        std::cerr<<"Warning: list and grid disagree"<<std::endl;
+
+    std::cout<<beingCount<<" beings:"<<std::endl
+             <<"    tile lookup: "<<listTile<<" ns list, "<<gridTile<<" ns grid"<<std::endl
+             <<"    area lookup: "<<listArea<<" ns list, "<<gridArea<<" ns grid"<<std::endl
+             <<"    grid update: "<<gridMove<<" ns per step"<<std::endl;
+}
+
+int main(int argc, char * argv[] )
+{
+    int queries = 100000;
+    int width = 200;
+    int height = 200;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "q:w:h:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'q':
+                queries = atoi(optarg);
+                break;
+            case 'w':
+                width = atoi(optarg);
+                break;
+            case 'h':
+                height = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (queries <= 0 || width <= 0 || height <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    const int counts[] = { 10, 100, 500, 1000, 2000 };
+    for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        srand(1);
+        benchmark(counts[i], queries, width, height);
+    }
+}
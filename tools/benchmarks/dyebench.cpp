@@ -0,0 +1,404 @@
+/*
+ *  DyeBench
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <vector>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../../src/core/image/dyetable.h"
+
+void printUsage()
+{
+    std::cerr<<"Usage: dyebench [-p players] [-r rounds] [-s size]"<<std::endl
+             <<"    -p number of players on screen (default 60)"<<std::endl
+             <<"    -r number of times every dyed image is made (default 5)"<<std::endl
+             <<"    -s width and height of the sprite sheets (default 384)"<<std::endl
+             <<std::endl
+             <<"Compares recoloring sprite sheets a pixel at a time with recoloring them"<<std::endl
+             <<"through a lookup table"<<std::endl
+             <<"See readme.txt for full documentation"<<std::endl;
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+struct Color
+{
+    int r, g, b;
+};
+
+/* The palette the way DyePalette used to interpolate it. */
+struct Palette
+{
+    std::vector<Color*> colors;
+
+    void getColor(const int intensity, Color* color) const
+    {
+        if (intensity == 0)
+        {
+            color->r = 0;
+            color->g = 0;
+            color->b = 0;
+            return;
+        }
+
+        const int last = colors.size();
+
+        if (last == 0)
+            return;
+
+        const int i = intensity * last / 255;
+        const int t = intensity * last % 255;
+
+        const int j = t != 0 ? i : i - 1;
+
+        const int r2 = colors[j]->r, g2 = colors[j]->g, b2 = colors[j]->b;
+
+        if (t == 0)
+        {
+            color->r = r2;
+            color->g = g2;
+            color->b = b2;
+            return;
+        }
+
+        int r1 = 0, g1 = 0, b1 = 0;
+        if (i > 0)
+        {
+            r1 = colors[i - 1]->r;
+            g1 = colors[i - 1]->g;
+            b1 = colors[i - 1]->b;
+        }
+
+        color->r = ((255 - t) * r1 + t * r2) / 255;
+        color->g = ((255 - t) * g1 + t * g2) / 255;
+        color->b = ((255 - t) * b1 + t * b2) / 255;
+    }
+};
+
+/* A dye with one palette per channel combination, 0 meaning none. */
+struct Dye
+{
+    const Palette* palettes[7];
+};
+
+/* Recolors a pixel the way Dye::update used to, including the color that
+ * was allocated for every pixel.
+ */
+static void updateOld(const Dye& dye, Color* color)
+{
+    const int cmax = std::max(color->r, std::max(color->g, color->b));
+    if (cmax == 0)
+        return;
+
+    const int cmin = std::min(color->r, std::min(color->g, color->b));
+    const int intensity = color->r + color->g + color->b;
+
+    if (cmin != cmax && (cmin != 0 || (intensity != cmax && intensity != 2 * cmax)))
+        return;
+
+    const int i = (color->r != 0) | ((color->g != 0) << 1) | ((color->b != 0) << 2);
+
+    if (dye.palettes[i - 1])
+        dye.palettes[i - 1]->getColor(cmax, color);
+}
+
+static void dyeOld(const Dye& dye, uint32_t* pixels, int count)
+{
+    for (uint32_t* end = pixels + count; pixels != end; ++pixels)
+    {
+        const int alpha = *pixels & 255;
+        if (!alpha)
+            continue;
+        Color* v = new Color();
+        v->r = (*pixels >> 24) & 255;
+        v->g = (*pixels >> 16) & 255;
+        v->b = (*pixels >> 8) & 255;
+        updateOld(dye, v);
+        *pixels = (v->r << 24) | (v->g << 16) | (v->b << 8) | alpha;
+        delete v;
+    }
+}
+
+/* Builds the table the way Dye does now. */
+static void buildTable(const Dye& dye, DyeTable& table)
+{
+    for (int i = 0; i < 7; i++)
+    {
+        if (!dye.palettes[i])
+            continue;
+
+        const int channels = i + 1;
+        for (int value = 0; value < 256; value++)
+        {
+            Color color;
+            color.r = channels & DyeTable::RED ? value : 0;
+            color.g = channels & DyeTable::GREEN ? value : 0;
+            color.b = channels & DyeTable::BLUE ? value : 0;
+            dye.palettes[i]->getColor(value, &color);
+            table.setColor(channels, value, color.r, color.g, color.b);
+        }
+    }
+}
+
+static Palette* createPalette()
+{
+    Palette* palette = new Palette;
+    for (int i = 0; i < 3; i++)
+    {
+        Color* color = new Color;
+        color->r = rand() % 256;
+        color->g = rand() % 256;
+        color->b = rand() % 256;
+        palette->colors.push_back(color);
+    }
+    return palette;
+}
+
+/* Makes a sprite sheet of 64x64 frames, each with a figure in the middle.
+ * The figure is shaded with the given dyeable channels, except for an
+ * outline and some details which aren't pure and stay as they are.
+ */
+static std::vector<uint32_t> createSheet(int size, int channels)
+{
+    std::vector<uint32_t> sheet(size * size, 0);
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            const int fx = x % 64 - 32;
+            const int fy = y % 64 - 32;
+            const int distance = fx * fx / 2 + fy * fy;
+
+            if (distance > 500)
+                continue;
+
+            uint32_t pixel;
+            if (distance > 430 || rand() % 4 == 0)
+            {
+                // Outline and details
+                pixel = (40 + rand() % 60) << 24 | (30 + rand() % 40) << 16 |
+                        (20 + rand() % 30) << 8;
+            }
+            else
+            {
+                const uint32_t value = 255 - distance * 200 / 500;
+                pixel = (channels & DyeTable::RED ? value << 24 : 0) |
+                        (channels & DyeTable::GREEN ? value << 16 : 0) |
+                        (channels & DyeTable::BLUE ? value << 8 : 0);
+            }
+            sheet[y * size + x] = pixel | 255;
+        }
+    }
+
+    return sheet;
+}
+
+/* One image as the resource manager loads it: a sprite sheet with a dye. */
+struct DyedImage
+{
+    int sheet;
+    int dye;
+
+    bool operator<(const DyedImage& other) const
+    {
+        return sheet != other.sheet ? sheet < other.sheet : dye < other.dye;
+    }
+};
+
+static uint32_t checksum(const std::vector<uint32_t>& pixels)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < pixels.size(); i++)
+        sum = sum * 31 + pixels[i];
+    return sum;
+}
+
+int main(int argc, char * argv[] )
+{
+    int players = 60;
+    int rounds = 5;
+    int size = 384;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:r:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                players = atoi(optarg);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 's':
+                size = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if (players <= 0 || rounds <= 0 || size < 64)
+    {
+        printUsage();
+        return -1;
+    }
+
+    // Hair is dyed through gray, clothes through red and yellow shading
+    const int hairStyles = 12, hairColors = 10;
+    const int clothes = 20, clothColors = 8;
+
+    std::vector<std::vector<uint32_t> > sheets;
+    for (int i = 0; i < hairStyles; i++)
+        sheets.push_back(createSheet(size, DyeTable::RED | DyeTable::GREEN |
+                                           DyeTable::BLUE));
+    for (int i = 0; i < clothes * 2; i++)
+        sheets.push_back(createSheet(size, i % 2 ? DyeTable::RED :
+                                           DyeTable::RED | DyeTable::GREEN));
+
+    std::vector<Palette*> palettes;
+    std::vector<Dye> dyes;
+    for (int i = 0; i < hairColors + clothColors; i++)
+    {
+        Dye dye;
+        for (int c = 0; c < 7; c++)
+            dye.palettes[c] = NULL;
+
+        if (i < hairColors)
+        {
+            palettes.push_back(createPalette());
+            dye.palettes[6] = palettes.back();
+        }
+        else
+        {
+            palettes.push_back(createPalette());
+            dye.palettes[0] = palettes.back();
+            palettes.push_back(createPalette());
+            dye.palettes[2] = palettes.back();
+        }
+        dyes.push_back(dye);
+    }
+
+    // Every player wears a hair style, a top and a bottom with their own
+    // colors. Images that several players share are only made once.
+    std::set<DyedImage> images;
+    for (int i = 0; i < players; i++)
+    {
+        DyedImage hair = { rand() % hairStyles, rand() % hairColors };
+        DyedImage top = { hairStyles + (rand() % clothes) * 2,
+                          hairColors + rand() % clothColors };
+        DyedImage bottom = { hairStyles + (rand() % clothes) * 2 + 1,
+                             hairColors + rand() % clothColors };
+        images.insert(hair);
+        images.insert(top);
+        images.insert(bottom);
+    }
+
+    const double megapixels = (double) images.size() * size * size / 1000000.0;
+    std::cout<<players<<" players wearing "<<images.size()<<" dyed images of "
+             <<size<<"x"<<size<<" pixels ("<<megapixels<<" megapixels)"<<std::endl;
+
+    std::vector<uint32_t> pixels(size * size);
+    uint32_t oldSum = 0, newSum = 0, tableSum = 0;
+
+    double start = now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (std::set<DyedImage>::const_iterator i = images.begin();
+             i != images.end(); ++i)
+        {
+            pixels = sheets[i->sheet];
+            dyeOld(dyes[i->dye], &pixels[0], pixels.size());
+            oldSum += checksum(pixels);
+        }
+    }
+    const double oldTime = (now() - start) / rounds;
+
+    start = now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (std::set<DyedImage>::const_iterator i = images.begin();
+             i != images.end(); ++i)
+        {
+            DyeTable table;
+            buildTable(dyes[i->dye], table);
+            pixels = sheets[i->sheet];
+            for (size_t p = 0; p < pixels.size(); p++)
+                pixels[p] = table.dye(pixels[p]);
+            tableSum += checksum(pixels);
+        }
+    }
+    const double tableTime = (now() - start) / rounds;
+
+    start = now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (std::set<DyedImage>::const_iterator i = images.begin();
+             i != images.end(); ++i)
+        {
+            DyeTable table;
+            buildTable(dyes[i->dye], table);
+            pixels = sheets[i->sheet];
+            table.apply(&pixels[0], pixels.size());
+            newSum += checksum(pixels);
+        }
+    }
+    const double newTime = (now() - start) / rounds;
+
+    start = now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (size_t i = 0; i < dyes.size(); i++)
+        {
+            DyeTable table;
+            buildTable(dyes[i], table);
+        }
+    }
+    const double buildTime = (now() - start) / rounds / dyes.size();
+
+    if (oldSum != newSum || oldSum != tableSum)
+        std::cerr<<"The recolored images differ!"<<std::endl;
+
+    std::cout<<"    old:         "<<oldTime / 1000.0<<" ms, "
+             <<megapixels / (oldTime / 1000000.0)<<" megapixels/s"<<std::endl
+             <<"    table:       "<<tableTime / 1000.0<<" ms, "
+             <<megapixels / (tableTime / 1000000.0)<<" megapixels/s"<<std::endl
+             <<"    table apply: "<<newTime / 1000.0<<" ms, "
+             <<megapixels / (newTime / 1000000.0)<<" megapixels/s"<<std::endl
+             <<"    building a table takes "<<buildTime<<" us"<<std::endl;
+
+    for (size_t i = 0; i < palettes.size(); i++)
+    {
+        for (size_t c = 0; c < palettes[i]->colors.size(); c++)
+            delete palettes[i]->colors[c];
+        delete palettes[i];
+    }
+}
@@ -140,7 +140,8 @@ Map::Map(std::string filename):
                     {
                         unsigned char *inflated;
                         unsigned int inflatedSize =
-                            inflateMemory(binData, binLen, inflated);
+                            inflateMemory(binData, binLen, inflated,
+                                          mWidth * mHeight * 4);
                         free(binData);
                         binData = inflated;
                         binLen = inflatedSize;
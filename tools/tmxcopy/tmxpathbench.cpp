@@ -0,0 +1,192 @@
+/*
+ *  TMXPathBench
+ *  Copyright (C) 2010  Aethyra Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "map.hpp"
+
+#include "../../src/core/map/pathcache.h"
+#include "../../src/core/map/pathfinder.h"
+
+void printUsage()
+{
+    std::cerr<<"Usage: tmxpathbench [-H] [-q queries] [-s seed] mapFile..."<<std::endl
+             <<"    -H use the hierarchical path cache, like the game does"<<std::endl
+             <<"    -q number of path queries per map (default 1000)"<<std::endl
+             <<"    -s seed for picking the start and destination tiles"<<std::endl
+             <<std::endl
+             <<"Runs the game's path finder between random walkable tiles"<<std::endl
+             <<"See readme.txt for full documentation"<<std::endl;
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/* Fills the path finder from the map's collision layer, the same way the
+ * game does: empty tiles and the first tile of a tileset are walkable.
+ * Returns false when the map has no collision layer.
+ */
+static bool readCollision(Map* map, PathFinder& pathFinder)
+{
+    for (size_t i = 0; i < map->getNumberOfLayers(); i++)
+    {
+        Layer* layer = map->getLayer(i);
+        std::string name = layer->getName();
+        for (std::string::iterator c = name.begin(); c != name.end(); c++)
+            *c = tolower(*c);
+
+        if (name.substr(0, 9) != "collision")
+            continue;
+
+        for (int y = 0; y < map->getHeight(); y++)
+        {
+            for (int x = 0; x < map->getWidth(); x++)
+            {
+                Tile& tile = layer->getTile(x, y, map->getWidth());
+                pathFinder.setWalkable(x, y, tile.empty() || tile.index == 0);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static void benchmark(const std::string& mapFile, int queries,
+                      bool hierarchical)
+{
+    Map* map = new Map(mapFile);
+    const int width = map->getWidth();
+    const int height = map->getHeight();
+    PathFinder pathFinder(width, height);
+
+    if (!readCollision(map, pathFinder))
+    {
+        std::cerr<<mapFile<<": no collision layer, treating all tiles as walkable"<<std::endl;
+    }
+    delete map;
+
+    PathCache* pathCache = NULL;
+    if (hierarchical)
+    {
+        const double start = now();
+        pathCache = new PathCache(&pathFinder);
+        pathCache->update();
+        std::cout<<mapFile<<": path cache built in "<<now() - start<<" us"<<std::endl;
+    }
+
+    long long expanded = 0;
+    long long pathLength = 0;
+    int found = 0;
+    double worst = 0.0;
+    double total = 0.0;
+
+    for (int i = 0; i < queries; i++)
+    {
+        int startX, startY, destX, destY;
+        int tries = 0;
+        do
+        {
+            startX = rand() % width;
+            startY = rand() % height;
+            destX = rand() % width;
+            destY = rand() % height;
+        } while ((!pathFinder.isWalkable(startX, startY) ||
+                  !pathFinder.isWalkable(destX, destY)) && ++tries < 1000);
+
+        const double start = now();
+        Path path = pathCache ?
+            pathCache->findPath(startX, startY, destX, destY) :
+            pathFinder.findPath(startX, startY, destX, destY);
+        const double elapsed = now() - start;
+
+        total += elapsed;
+        if (elapsed > worst)
+            worst = elapsed;
+        expanded += pathFinder.getExpandedNodes();
+        if (!path.empty())
+        {
+            found++;
+            pathLength += path.size();
+        }
+    }
+
+    std::cout<<mapFile<<" ("<<width<<"x"<<height<<"): "
+             <<queries<<" queries, "<<found<<" paths found"<<std::endl
+             <<"    "<<(double) expanded / queries<<" nodes expanded per query, "
+             <<(found ? (double) pathLength / found : 0.0)<<" tiles per path"<<std::endl
+             <<"    "<<total / queries<<" us per query, "
+             <<worst<<" us worst case"<<std::endl;
+
+    delete pathCache;
+}
+
+int main(int argc, char * argv[] )
+{
+    int queries = 1000;
+    unsigned int seed = 1;
+    bool hierarchical = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "Hq:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'H':
+                hierarchical = true;
+                break;
+            case 'q':
+                queries = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            case '?':
+                std::cerr<<"Unrecognized option"<<std::endl;
+                printUsage();
+                return -1;
+        }
+    }
+
+    if ((argc-optind) < 1 || queries <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    try
+    {
+        for (int i = optind; i < argc; i++)
+        {
+            srand(seed);
+            benchmark(argv[i], queries, hierarchical);
+        }
+    }
+    catch (int)
+    {
+        return -1;
+    }
+}
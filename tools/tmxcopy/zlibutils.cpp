@@ -5,19 +5,19 @@
 #include <zlib.h>
 
 /**
- * Inflates either zlib or gzip deflated memory. The inflated memory is
- * expected to be freed by the caller.
+ * Inflates the given data into out, which holds outLength bytes. When grow is
+ * set, out is reallocated whenever it is full, otherwise inflating stops when
+ * it is full and Z_BUF_ERROR is returned. On return, outLength holds the
+ * number of bytes inflated.
  */
-int
-inflateMemory(unsigned char *in, unsigned int inLength,
-              unsigned char *&out, unsigned int &outLength)
+static int
+inflateBuffer(unsigned char *in, unsigned int inLength,
+              unsigned char *&out, unsigned int &outLength, bool grow)
 {
-    int bufferSize = 256 * 1024;
+    unsigned int bufferSize = outLength;
     int ret;
     z_stream strm;
 
-    out = (unsigned char*) malloc(bufferSize);
-
     strm.zalloc = Z_NULL;
     strm.zfree = Z_NULL;
     strm.opaque = Z_NULL;
@@ -29,76 +29,91 @@ inflateMemory(unsigned char *in, unsigned int inLength,
     ret = inflateInit2(&strm, 15 + 32);
 
     if (ret != Z_OK)
+    {
+        outLength = 0;
         return ret;
+    }
 
-    do
+    for (;;)
     {
-        if (strm.next_out == NULL)
-        {
-            inflateEnd(&strm);
-            return Z_MEM_ERROR;
-        }
-
         ret = inflate(&strm, Z_NO_FLUSH);
         assert(ret != Z_STREAM_ERROR);
 
-        switch (ret) {
-            case Z_NEED_DICT:
-                ret = Z_DATA_ERROR;
-            case Z_DATA_ERROR:
-            case Z_MEM_ERROR:
-                (void) inflateEnd(&strm);
-                return ret;
+        if (ret == Z_STREAM_END)
+            break;
+
+        if (ret == Z_NEED_DICT)
+            ret = Z_DATA_ERROR;
+
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            break;
+
+        // Output space left means the input ended before the stream did
+        if (strm.avail_out > 0)
+        {
+            ret = Z_DATA_ERROR;
+            break;
         }
 
-        if (ret != Z_STREAM_END)
+        if (!grow)
         {
-            out = (unsigned char*) realloc(out, bufferSize * 2);
+            ret = Z_BUF_ERROR;
+            break;
+        }
 
-            if (out == NULL)
-            {
-                inflateEnd(&strm);
-                return Z_MEM_ERROR;
-            }
+        unsigned char *larger = (unsigned char*) realloc(out, bufferSize * 2);
 
-            strm.next_out = out + bufferSize;
-            strm.avail_out = bufferSize;
-            bufferSize *= 2;
+        if (larger == NULL)
+        {
+            ret = Z_MEM_ERROR;
+            break;
         }
+
+        out = larger;
+        strm.next_out = out + bufferSize;
+        strm.avail_out = bufferSize;
+        bufferSize *= 2;
     }
-    while (ret != Z_STREAM_END);
-    assert(strm.avail_in == 0);
 
     outLength = bufferSize - strm.avail_out;
     (void) inflateEnd(&strm);
-    return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+    return ret == Z_STREAM_END ? Z_OK : ret;
+}
+
+static void
+reportError(int ret)
+{
+    if (ret == Z_MEM_ERROR)
+    {
+        std::cerr<<"Error: Out of memory while decompressing map data!";
+    }
+    else if (ret == Z_VERSION_ERROR)
+    {
+        std::cerr<<"Error: Incompatible zlib version!";
+    }
+    else if (ret == Z_DATA_ERROR)
+    {
+        std::cerr<<"Error: Incorrect zlib compressed data!";
+    }
+    else
+    {
+        std::cerr<<"Error: Unknown error while decompressing map data!";
+    }
 }
 
 int
 inflateMemory(unsigned char *in, unsigned int inLength,
-              unsigned char *&out)
+              unsigned char *&out, unsigned int expectedLength)
 {
-    unsigned int outLength = 0;
-    int ret = inflateMemory(in, inLength, out, outLength);
+    unsigned int outLength = expectedLength > 0 ? expectedLength : 256 * 1024;
+    out = (unsigned char*) malloc(outLength);
+
+    int ret = out ? inflateBuffer(in, inLength, out, outLength, true)
+                  : Z_MEM_ERROR;
 
-    if (ret != Z_OK || out == NULL)
+    if (ret != Z_OK)
     {
-        if (ret == Z_MEM_ERROR)
-        {
-            std::cerr<<"Error: Out of memory while decompressing map data!";
-        }
-        else if (ret == Z_VERSION_ERROR)
-        {
-            std::cerr<<"Error: Incompatible zlib version!";
-        }
-        else if (ret == Z_DATA_ERROR)
-        {
-            std::cerr<<"Error: Incorrect zlib compressed data!";
-        }
-        else
-        {
-            std::cerr<<"Error: Unknown error while decompressing map data!";
-        }
+        reportError(ret);
 
         free(out);
         out = NULL;
@@ -108,6 +123,22 @@ inflateMemory(unsigned char *in, unsigned int inLength,
     return outLength;
 }
 
+int
+inflateMemoryInto(unsigned char *in, unsigned int inLength,
+                  unsigned char *out, unsigned int outLength)
+{
+    int ret = inflateBuffer(in, inLength, out, outLength, false);
+
+    // A full buffer isn't an error, the rest of the data is just ignored
+    if (ret != Z_OK && ret != Z_BUF_ERROR)
+    {
+        reportError(ret);
+        return 0;
+    }
+
+    return outLength;
+}
+
 /*
 int
 compressMemory(unsigned char *in, unsigned int inLength,
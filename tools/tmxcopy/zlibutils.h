@@ -1,10 +1,21 @@
+/**
+ * Inflates either zlib or gzip deflated memory. The inflated memory is
+ * expected to be freed by the caller. When the inflated size is known,
+ * passing it as expectedLength allocates a buffer of that size up front.
+ * Returns the number of bytes inflated.
+ */
 int
 inflateMemory(unsigned char *in, unsigned int inLength,
-              unsigned char *&out, unsigned int &outLength);
+              unsigned char *&out, unsigned int expectedLength = 0);
 
+/**
+ * Inflates either zlib or gzip deflated memory into a buffer provided by the
+ * caller. Data which doesn't fit in the buffer is ignored. Returns the number
+ * of bytes inflated, or 0 when the data couldn't be inflated.
+ */
 int
-inflateMemory(unsigned char *in, unsigned int inLength,
-              unsigned char *&out);
+inflateMemoryInto(unsigned char *in, unsigned int inLength,
+                  unsigned char *out, unsigned int outLength);
 
 int
 compressMemory(unsigned char *in, unsigned int inLength,